@@ -0,0 +1,89 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3ACCUMULATOR_H_
+#define MYTHEN3ACCUMULATOR_H_
+
+#include <stdint.h>
+#include <vector>
+#include "lima/Timestamp.h"
+
+namespace lima {
+namespace Mythen3 {
+
+const int AccTableFrames = 1 << 16;	// accumulated frames whose sub-frame record is kept
+
+/*
+ * Accumulation of consecutive sub-frames into the frame published to
+ * Lima, for short exposures at a low number of bits. The first sub-frame
+ * is read out into the frame buffer itself, the next ones into a scratch
+ * buffer and added to it. A sub-frame with a channel at the saturation
+ * threshold or above is flagged. Bad channels read as -2 are left out of
+ * the sums and of the saturation check and keep the value of their first
+ * sub-frame. The record of an accumulated frame (sub-
+ * frames, saturated sub-frames, times) is kept for the whole acquisition,
+ * or its last AccTableFrames frames when it is continuous or longer. Not
+ * thread safe: the camera serialises the configuration and the reads with
+ * the acquisition.
+ */
+class Mythen3Accumulator {
+public:
+	struct Record {
+		int nbSubFrames;					// sub-frames summed so far
+		int nbSaturated;					// sub-frames with a saturated channel
+		double start;						// readout start of the first sub-frame (s since the start)
+		double end;							// readout end of the last sub-frame (s since the start)
+	};
+
+	Mythen3Accumulator();
+
+	void setNbSubFrames(int nbSubFrames);
+	int getNbSubFrames() const;
+
+	void startAcq(int nbFrames, int width, uint32_t threshold, Timestamp start,
+			const std::vector<int>& badChannels);
+	uint32_t* getSubFrameBuffer();
+	void addSubFrame(long long frameNb, int subFrame, uint32_t* frame, const uint32_t* subFrameData);
+	int getNbRows() const;
+	const Record& getRecord(long long frameNb) const;
+	const uint8_t* getSaturated(long long frameNb) const;
+
+	static bool add(uint32_t* frame, const uint32_t* subFrame, int width, uint32_t threshold);
+	static bool saturated(const uint32_t* frame, int width, uint32_t threshold);
+
+private:
+	int m_nb_sub_frames;
+	int m_width;						// channels per frame
+	uint32_t m_threshold;				// saturation count of a sub-frame
+	Timestamp m_start;					// acquisition start
+	int m_nb_rows;						// frames held by the tables
+	std::vector<Record> m_records;		// by frame modulo m_nb_rows
+	std::vector<uint8_t> m_saturated;	// m_nb_sub_frames flags per frame, same rows
+	std::vector<uint32_t> m_sub_frame;	// scratch buffer of the sub-frames after the first
+	std::vector<int> m_bad;				// bad channels of the acquisition
+	std::vector<uint32_t> m_bad_counts;	// their counts in the first sub-frame
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3ACCUMULATOR_H_
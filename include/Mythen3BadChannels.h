@@ -0,0 +1,64 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3BADCHANNELS_H_
+#define MYTHEN3BADCHANNELS_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+/*
+ * Masking of the bad channels for the reductions of each frame (ROI sums,
+ * rebinning, peak search, channel binning). With the bad channel
+ * interpolation off the detector reads a bad channel as -2, that is
+ * 0xFFFFFFFE once taken as a count, which would swamp any sum and pass any
+ * threshold. The reductions are then given a copy of the frame in which
+ * each bad channel holds the average of its nearest good neighbours in its
+ * module, as the detector computes it with the interpolation on. The frame
+ * published to Lima is left as read out. Not thread safe: the camera
+ * serialises the configuration with the acquisition.
+ */
+class Mythen3BadChannels {
+public:
+	Mythen3BadChannels();
+
+	void setBadChannels(const std::vector<int>& channels);
+	const std::vector<int>& getBadChannels() const;
+
+	void startAcq(int width, int moduleChannels);
+	const uint32_t* mask(const uint32_t* frame);
+
+private:
+	std::vector<int> m_channels;		// bad channels, in increasing order
+	std::vector<int> m_masked;			// bad channels of the acquisition
+	std::vector<int> m_left;			// nearest good channel below each one, -1 if none
+	std::vector<int> m_right;			// nearest good channel above each one, -1 if none
+	std::vector<uint32_t> m_frame;		// masked copy of the last frame
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3BADCHANNELS_H_
@@ -25,13 +25,24 @@
 
 #include <map>
 #include <vector>
+#include <limits.h>
 #include "lima/Debug.h"
 #include "lima/Constants.h"
 #include "lima/HwMaxImageSizeCallback.h"
 #include "lima/HwBufferMgr.h"
 #include "lima/ThreadUtils.h"
+#include "lima/Timestamp.h"
 #include "processlib/Data.h"
+#include "Mythen3Accumulator.h"
+#include "Mythen3BadChannels.h"
+#include "Mythen3ChannelBinning.h"
+#include "Mythen3ChannelStats.h"
 #include "Mythen3Net.h"
+#include "Mythen3PeakSearch.h"
+#include "Mythen3Metrics.h"
+#include "Mythen3Profiler.h"
+#include "Mythen3Rebin.h"
+#include "Mythen3Roi.h"
 
 namespace lima {
 namespace Mythen3 {
@@ -39,6 +50,14 @@ namespace Mythen3 {
 const int XPixelSize = 50; // um
 const int YPixelSize = 8000; // um
 const int PixelsPerModule = 1280;
+const int MaxCmdLength = 64; // longest command string sent to the socket server
+const int ContinuousHwFrames = INT_MAX; // frames programmed for an unbounded acquisition
+const int MaxAcqFrames = INT_MAX; // frames of an acquisition, Lima numbers them with an int
+const int MaxBatchCmds = 16; // commands sent in one pipelined exchange
+const double ReadoutTimeoutMargin = 2.0; // wait for a frame beyond its period before the detector is lost (s)
+const uint32_t BadChannelCount = 0xFFFFFFFE; // count (-2) of a bad channel, interpolation off
+const uint32_t FailedReadoutCount = 0xFFFFFFFF; // count (-1) of every channel of a failed readout
+const int FrameChunkSize = 64; // default frames per chunk of Camera::FrameReader
 
 class BufferCtrlObj;
 
@@ -95,6 +114,7 @@ public:
 	void getNbFrames(int& nb_frames);
 
 	bool isAcqRunning() const;
+	bool isAcqFailed() const;
 
 ///////////////////////////////
 // -- mythen3 specific functions
@@ -121,6 +141,65 @@ public:
 		Cr,  ///< kthreshEnergy(8.74,17.48)
 		Ag,  ///< kthreshEnergy(11.08,22.16)
 	};
+	enum ChannelHealth {
+		CONSISTENT,  ///< behaves as flagged in the bad channel map
+		DEAD,        ///< not flagged bad, never counts while its module does
+		HOT,         ///< not flagged bad, counts far above its module
+		NOISY,       ///< not flagged bad, varies far more than its counts
+		RECOVERED,   ///< flagged bad, behaves as a good channel
+	};
+	/// acquisition configuration applied or read back in one exchange
+	struct AcqConfig {
+		Nbits nbits;               ///< number of bits readout
+		long long time;            ///< exposure time in units of 100ns
+		int frames;                ///< number of frames, 0 for continuous
+		long long delayBefore;     ///< delay before frame in units of 100ns
+		long long delayAfter;      ///< delay after frame in units of 100ns
+		int gates;                 ///< number of gates per frame
+		Switch triggered;          ///< trigger mode
+		Switch continuousTrigger;  ///< continuous trigger mode
+		Switch gateMode;           ///< gated measurement mode
+	};
+	/// exchanges of one socket server command since the last reset
+	struct CmdStatistics {
+		std::string name;          ///< command name
+		long long count;           ///< number of replies
+		long long bytes;           ///< reply bytes received
+		long long errors;          ///< error replies
+		long long failures;        ///< exchanges without a reply
+		double p50;                ///< median reply latency (s)
+		double p99;                ///< 99th percentile reply latency (s)
+		double max;                ///< maximum reply latency (s)
+		std::vector<int> errorCodes;   ///< status codes of the error replies
+		std::vector<int> errorCounts;  ///< number of error replies for each code
+	};
+	/// hardware counters of one acquisition stage per frame, -1 if not available
+	struct StageProfile {
+		std::string stage;         ///< readout, decode or publish
+		long long frames;          ///< frames through the stage
+		double instructions;       ///< instructions per frame
+		double cycles;             ///< CPU cycles per frame
+		double cacheMisses;        ///< cache misses per frame
+		double branchMisses;       ///< branch misses per frame
+	};
+	/// record of a frame accumulated from sub-frames
+	struct AccFrameInfo {
+		int subFrames;             ///< sub-frames summed
+		int saturatedSubFrames;    ///< sub-frames with a channel at the cutoff
+		double start;              ///< readout start of the first sub-frame (s since the start)
+		double end;                ///< readout end of the last sub-frame (s since the start)
+	};
+	/// iterates over the acquired frames in chunks viewed in the buffer ring
+	class FrameReader {
+	public:
+		FrameReader(Camera& cam, int first = 0, int chunk_frames = FrameChunkSize);
+		bool next(Data& chunk);
+		int getNextFrameNb() const;
+	private:
+		Camera& m_cam;
+		int m_next;                ///< first frame of the next chunk
+		int m_chunk_frames;        ///< most frames per chunk
+	};
 
 	void getAssemblyDate(string& date);
 	void getBadChannels(Data& badChannels);
@@ -188,7 +267,66 @@ public:
 	void logStop();
 	void logRead();
 	void readFrame(Data& mythenData, int frame_nb);
+	void readFrames(Data& mythenData, int first, int max_frames);
 	void readData(Data& mythenData);
+	void setScanMode(Switch enable);
+	void getScanMode(Switch& enable);
+	void getStartLatency(double& latency);
+	void setAcqConfig(const AcqConfig& config);
+	void getAcqConfig(AcqConfig& config);
+	void setCmdPipelining(Switch enable);
+	void getCmdPipelining(Switch& enable);
+	void setAutoReconnect(Switch enable);
+	void getAutoReconnect(Switch& enable);
+	void getNbReconnects(int& nbReconnects);
+	void startRecording(const std::string& fileName);
+	void stopRecording();
+	void setReplaySpeed(double speed);
+	void setRecvBufferSize(int size);
+	void getRecvBufferSize(int& size);
+	void setQuickAck(Switch enable);
+	void getQuickAck(Switch& enable);
+	void setBusyPoll(int usecs);
+	void getBusyPoll(int& usecs);
+	void getReadsPerFrame(double& reads);
+	void setIoUring(Switch enable);
+	void getIoUring(Switch& enable);
+	void getStatistics(std::vector<CmdStatistics>& stats);
+	void resetStatistics();
+	void getMetrics(std::string& text);
+	void startMetricsExport(const std::string& target, double period = MetricsExportPeriod);
+	void stopMetricsExport();
+	void setProfiling(Switch enable);
+	void getProfiling(Switch& enable);
+	void getProfile(std::vector<StageProfile>& profile);
+	void setSimulationSpeed(double speed);
+	void getSimulationSpeed(double& speed);
+	void setRois(const std::vector<int>& first, const std::vector<int>& last);
+	void getRois(std::vector<int>& first, std::vector<int>& last);
+	void readRoiSums(Data& sums, int first, int max_frames);
+	void setAccumulation(int nb_sub_frames);
+	void getAccumulation(int& nb_sub_frames);
+	void getAccFrameInfo(int frame_nb, AccFrameInfo& info, std::vector<int>& saturated);
+	void setAngularCalibration(const std::vector<double>& centre, const std::vector<double>& conversion,
+			const std::vector<double>& offset);
+	void getAngularCalibration(std::vector<double>& centre, std::vector<double>& conversion,
+			std::vector<double>& offset);
+	void setRebinning(double start, double end, double bin_size);
+	void getRebinning(double& start, double& end, double& bin_size);
+	void getRebinAngles(std::vector<double>& angles);
+	void readRebinned(Data& patterns, int first, int max_frames);
+	void setPeakSearch(int threshold, int min_width);
+	void getPeakSearch(int& threshold, int& min_width);
+	void readPeaks(Data& peaks, int first, int max_frames);
+	void setChannelBinning(int factor);
+	void getChannelBinning(int& factor);
+	void readBinnedFrames(Data& frames, int first, int max_frames);
+	void setChannelStats(Switch enable);
+	void getChannelStats(Switch& enable);
+	void setChannelStatsWindow(int frames);
+	void getChannelStatsWindow(int& frames);
+	void readChannelStats(Data& stats, int& nb_frames);
+	void checkChannels(std::vector<int>& health);
 
 
 private:
@@ -201,19 +339,38 @@ private:
 	bool m_wait_flag;
 	bool m_quit;
 	int m_image_width;
-	int m_acq_frame_nb; // nos of frames acquired
-	int m_nb_frames; // nos of frame to acquire
-	double m_exp_time;
+	long long m_acq_frame_nb; // nos of frames acquired (up to MaxAcqFrames)
+	int m_nb_frames; // nos of frame to acquire (0 = continuous)
+	int m_nb_buffers; // size of the frame buffer ring
 	TrigMode m_trigger_mode;
 	ImageType m_image_type;
 	mutable Cond m_cond;
 	bool m_use_raw_readout;
 	Nbits m_nbits;
+	bool m_nbits_cached;
 	int m_logSize;
+	bool m_scan_mode;
+	bool m_start_pending;
+	Timestamp m_start_timestamp;
+	double m_start_latency; // startAcq to first frame (s)
+	bool m_acq_use_raw;
+	int m_acq_width;
+	int m_acq_size;
+	double m_acq_read_timeout; // frame readout timeout (s), 0 = none
+	bool m_cmd_pipelining;
+	bool m_auto_reconnect;
+	int m_nb_reconnects;
+	bool m_acq_failed; // last acquisition aborted by an error
+	double m_reads_per_frame; // recv() calls per frame of the last acquisition
+	long long m_readout_reads; // recv() calls of the frames read out so far
+	Mutex m_recover_mutex;
 
 	class AcqThread;
+	class Simulator;
+	class FrameView;
 
 	AcqThread *m_acq_thread;
+	Simulator *m_simulator; // socket server emulated when simulated
 
 	// Buffer control object
 	SoftBufferCtrlObj m_bufferCtrlObj;
@@ -227,12 +384,74 @@ public:
 		SENSORTHICKNESS, SYSTEMNUM, VERSION, RESET, DELAFTER, FRAMES, NBITS, STATUS, TIME, READOUT, READOUTRAW,
 		START, STOP, ENERGY, ENERGYMAX, ENERGYMIN, KTHRESH, KTHRESHMAX, KTHRESHMIN, KTHRESHENERGY, SETTINGS,
 		BADCHANNELINTERPOLATION, FLATFIELDCORRECTION, CUTOFF, FLATFIELD, RATECORRECTION, TAU, CONTTRIGEN, DELBEF,
-		GATEEN, GATES, CONTTRIG, GATE, INPOL, OUTPOL, TRIG, TRIGEN, LOGSTART, LOGSTOP, LOGREAD, TESTPATTERN};
+		GATEEN, GATES, CONTTRIG, GATE, INPOL, OUTPOL, TRIG, TRIGEN, LOGSTART, LOGSTOP, LOGREAD, TESTPATTERN, NB_SERVER_CMDS};
 #if __GNUC_MINOR__ < 4
 private:
 #endif
 
-	string findCmd(Action action, ServerCmd cmd);
+	// One command of a batch, see sendBatch()
+	struct BatchCmd {
+		Action action;
+		ServerCmd cmd;
+		char cmdBuf[MaxCmdLength];
+		uint8_t value[sizeof(long long)]; // binary SET argument (simulation)
+		int valueLen;
+		uint8_t* reply;
+		int len;
+		int rc;
+	};
+
+	// Synchronisation parameters reconciled at prepareAcq(), see applySyncConfig()
+	enum SyncParam {SYNC_CONTTRIG, SYNC_TRIGGERED, SYNC_GATEMODE, SYNC_GATES, SYNC_DELBEF, SYNC_DELAFTER,
+		SYNC_TIME, SYNC_FRAMES, NB_SYNC_PARAMS};
+	long long m_sync_desired[NB_SYNC_PARAMS]; // values requested by the synchronisation control
+	long long m_sync_current[NB_SYNC_PARAMS]; // values last written to or read from the detector
+	unsigned int m_sync_pending; // one bit per parameter with a desired value to apply
+	unsigned int m_sync_known; // one bit per parameter with a valid current value
+
+	// Last SET of each command since the last reset, replayed after a reconnection
+	char m_config_snapshot[NB_SERVER_CMDS][MaxCmdLength];
+	unsigned long m_config_seq[NB_SERVER_CMDS]; // order of the SETs, 0 if not set
+	unsigned long m_config_count;
+
+	Mythen3Statistics m_cmd_stats; // exchanges by ServerCmd
+	Mythen3Metrics m_metrics; // acquisition pipeline health
+	Mythen3Roi m_roi; // sums over channel ranges of each frame
+	Mythen3Accumulator m_accumulator; // sub-frames summed per frame
+	Mythen3Rebin m_rebin; // 2θ patterns of each frame
+	Mythen3PeakSearch m_peak_search; // peaks of each frame
+	Mythen3ChannelBinning m_channel_binning; // reduced resolution copy of each frame
+	Mythen3ChannelStats m_channel_stats; // running statistics of each channel
+	Mythen3BadChannels m_bad_channels; // bad channels masked out of the reductions
+	bool m_bad_channels_known; // m_bad_channels read since the last reset
+	Mutex m_stats_mutex; // protects m_channel_stats, updated at each frame
+	int m_cutoff; // saturation count of the detector, -1 until read
+	uint32_t m_acc_threshold; // saturation count of a sub-frame of the acquisition
+	std::vector<int> m_frame_pins; // views held on each buffer of the ring (grows only)
+	std::vector<FrameView*> m_frame_views; // views still pointing into the ring
+	Mythen3MetricsExporter* m_metrics_exporter; // 0 if not exporting
+	Mutex m_metrics_mutex; // protects m_metrics_exporter
+	bool m_profiling; // hardware counters around the acquisition stages
+	Mythen3Profiler::Result m_profile; // counters of the last profiled acquisition
+
+	int exchange(Action action, ServerCmd cmd, const char* cmdBuf, uint8_t* buff, int len);
+	void recordSet(ServerCmd cmd, const char* cmdBuf);
+	void clearConfigSnapshot();
+	void recover();
+	void replayConfig();
+	void setSyncParam(SyncParam param, long long value);
+	bool getCachedSyncParam(SyncParam param, long long& value) const;
+	bool getKnownSyncParam(SyncParam param, long long& value) const;
+	double readoutTimeout();
+	void syncUpdated(SyncParam param, long long value, bool written);
+	void syncUpdated(const AcqConfig& config, bool written);
+	void applySyncConfig();
+
+	int formatCmd(char* cmdBuf, Action action, ServerCmd cmd);
+	template<typename T> int appendArg(char* cmdBuf, int n, const T& value);
+	template<typename T> void batchSet(BatchCmd* batch, int& nb, ServerCmd cmd, T value);
+	template<typename T> void batchGet(BatchCmd* batch, int& nb, ServerCmd cmd, T& value);
+	void sendBatch(BatchCmd* batch, int nb);
 	template<typename T> void checkReply(T rc);
 	template<typename T> void requestSet(ServerCmd cmd, T value);
 	template<typename T> void requestSet(ServerCmd cmd, T value1, T value2);
@@ -249,9 +468,16 @@ private:
 	void readout(uint32_t* data, int len);
 	void readoutRaw(uint32_t* data, int len);
 	void decodeRaw(Nbits nbits, uint32_t* rawData, int image_width);
+	int getRingIndex(long long frame_nb) const;
+	long long getOldestFrameNb() const;
+	uint32_t accThreshold();
+	void updateBadChannels();
+	bool releaseFrames(FrameView* view);
+	void detachFrames(int index);
 
 	static std::map<int, std::string> serverStatusMap;
-	static std::map<ServerCmd, std::string> serverCmdMap;
+	static const char* const serverCmdNames[];
+	static const ServerCmd syncSetCmds[];
 };
 
 std::ostream& operator <<(std::ostream& os, Camera::Polarity const &polarity);
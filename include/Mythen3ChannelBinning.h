@@ -0,0 +1,69 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3CHANNELBINNING_H_
+#define MYTHEN3CHANNELBINNING_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const int MaxChannelBinning = 64;	// channels summed per binned channel
+
+/*
+ * Reduced resolution copy of each decoded frame, for the consumers that
+ * cannot take the full frames: groups of factor consecutive channels are
+ * summed into one, saturating at the largest 32 bit count. The binned
+ * frames are kept in their own ring of rows, by frame modulo the number of
+ * rows, alongside the full frames of the Lima buffer ring. Not thread
+ * safe: the camera serialises the configuration and the reads with the
+ * acquisition.
+ */
+class Mythen3ChannelBinning {
+public:
+	Mythen3ChannelBinning();
+
+	void setFactor(int factor);
+	int getFactor() const;
+	bool isEnabled() const;
+
+	void startAcq(int nbRows, int width);
+	void compute(long long frameNb, const uint32_t* frame);
+	int getNbRows() const;
+	int getWidth() const;
+	const uint32_t* getRow(long long frameNb) const;
+
+	static void bin(const uint32_t* frame, int width, int factor, uint32_t* binned);
+
+private:
+	int m_factor;						// channels per binned channel, 1 if disabled
+	int m_width;						// binned channels per frame
+	int m_nb_rows;						// binned frames held by the ring
+	std::vector<uint32_t> m_frames;		// m_nb_rows rows of m_width channels
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3CHANNELBINNING_H_
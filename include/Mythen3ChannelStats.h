@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3CHANNELSTATS_H_
+#define MYTHEN3CHANNELSTATS_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const int StatsBlocks = 8;				// blocks of frames of a sliding window
+const int StatsChunk = 256;				// channels updated by one fixed length loop
+const double HotChannelFactor = 10;		// mean over the module median of a hot channel
+const double NoisyChannelFactor = 10;	// variance over the mean of a noisy channel
+
+/*
+ * Running mean, variance, minimum and maximum of the counts of each
+ * channel, over the whole acquisition or over a sliding window. The frames
+ * are accumulated into blocks with Welford updates; every channel sees the
+ * same number of frames, so an update is the same arithmetic across the
+ * channels. The channels are stored by chunks of StatsChunk whose fields
+ * cannot overlap, so the compiler vectorises the fixed length loops over a
+ * chunk without runtime checks. A window of W frames is kept as
+ * the StatsBlocks last complete blocks of W / StatsBlocks frames and the
+ * block in progress, merged when read (Chan et al.), so it slides by whole
+ * blocks. Not thread safe: the camera serialises the updates and the reads.
+ */
+class Mythen3ChannelStats {
+public:
+	Mythen3ChannelStats();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	void setWindow(int window);
+	int getWindow() const;
+
+	void startAcq(int width);
+	void compute(const uint32_t* frame);
+	int getWidth() const;
+	long long getNbFrames() const;
+	void get(double* mean, double* variance, double* min, double* max) const;
+
+private:
+	struct Chunk {
+		double mean[StatsChunk];			// running mean of each channel
+		double m2[StatsChunk];				// sum of squared deviations of each channel
+		double min[StatsChunk];
+		double max[StatsChunk];
+	};
+	struct Block {
+		long long nbFrames;					// frames of the block
+		std::vector<Chunk> chunks;
+	};
+
+	static void start(Chunk& chunk, const uint32_t* frame);
+	static void update(Chunk& chunk, const uint32_t* frame, double inv, double keep);
+
+	bool m_enabled;
+	int m_window;						// frames of the sliding window, 0 for the whole acquisition
+	int m_width;						// channels per frame
+	long long m_block_frames;			// frames per block, 0 if unbounded
+	int m_current;						// block in progress
+	std::vector<Block> m_blocks;		// ring of blocks
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3CHANNELSTATS_H_
@@ -0,0 +1,106 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3COMPOSITE_H_
+#define MYTHEN3COMPOSITE_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+#include "Mythen3Camera.h"
+
+namespace lima {
+namespace Mythen3 {
+
+/*
+ * Several Mythen3 systems driven as one logical detector. Each system keeps
+ * its own Camera, socket and acquisition thread, so the systems are read out
+ * concurrently. The configuration is sent to all the systems in parallel by
+ * one worker thread per system, and the frame of a trigger is the frames of
+ * the systems stitched in the order of the hostnames. A hostname may end
+ * with :port to override the common port.
+ *
+ * Frame numbers are checked across the systems: a frame is available once
+ * every system has acquired it, and checkFrames() reports a system that
+ * aborted, fell out of step by more than the ring size or ended with a
+ * different number of frames than the others.
+ */
+class Mythen3Composite {
+DEB_CLASS_NAMESPC(DebModCamera, "Mythen3Composite", "Mythen3");
+
+public:
+	Mythen3Composite(const std::vector<std::string>& hostnames, int tcpPort, bool simulate=false);
+	~Mythen3Composite();
+
+	int getNbSystems() const;
+	Camera& getCamera(int system);
+
+	void reset();
+	void prepareAcq();
+	void startAcq();
+	void stopAcq();
+	bool isAcqRunning();
+	int getNbAcquiredFrames();
+	void checkFrames();
+
+	void setTrigMode(TrigMode mode);
+	void setExpTime(double exp_time);
+	void setLatTime(double lat_time);
+	void setNbFrames(int nb_frames);
+	void setNbits(Camera::Nbits nbits);
+	void setUseRawReadout(Camera::Switch enable);
+	void setNbBuffers(int nb_buffers);
+
+	void getWidth(int& width);
+	void readFrame(Data& data, int frame_nb);
+
+private:
+	enum Op {
+		OP_RESET, OP_PREPARE, OP_TRIG_MODE, OP_EXP_TIME, OP_LAT_TIME,
+		OP_NB_FRAMES, OP_NBITS, OP_USE_RAW, OP_NB_BUFFERS
+	};
+
+	class SystemThread;
+	friend class SystemThread;
+
+	void runAll(Op op, double value = 0);
+	void runOp(int system, Op op, double value);
+
+	std::vector<std::string> m_hostnames;
+	std::vector<Camera*> m_cameras;
+	std::vector<SystemThread*> m_threads;
+	std::vector<int> m_widths;				// frame width of each system
+	std::vector<std::string> m_errors;		// failure of each system in the last operation
+	int m_nb_buffers;
+	Cond m_cond;							// guards the operation below
+	Op m_op;
+	double m_value;
+	long long m_op_nb;						// operations posted so far
+	int m_pending;							// systems still running the operation
+	bool m_quit;
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3COMPOSITE_H_
@@ -0,0 +1,90 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3GENERATOR_H_
+#define MYTHEN3GENERATOR_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const uint64_t GeneratorSeed = 0x4d7974686e33ULL; // default seed of the synthetic frames
+const float GeneratorBackground = 40.0f;	// default mean background counts
+const int GeneratorPeakSpacing = 160;		// default channels between peaks
+const float GeneratorDeadFraction = 0.002f;	// default fraction of dead channels
+const float GeneratorHotFraction = 0.001f;	// default fraction of hot channels
+const float HotChannelCounts = 1.0e6f;		// mean counts of a hot channel
+const float PoissonNormalMin = 16.0f;		// smallest mean drawn from the normal approximation
+const int NormalTableSize = 4096;			// normal deviates tabulated, a power of 2
+
+/*
+ * Synthetic 1D diffraction patterns: Gaussian peaks on a decreasing
+ * background with dead and hot channels. Each frame draws Poisson counts
+ * around the mean pattern, reproducibly for a given seed and frame number.
+ * Means of PoissonNormalMin or more are drawn from the normal approximation
+ * in a branch-free loop over all the channels: the deviates are tabulated
+ * quantiles indexed by 12 bits of a counter hash, so that one hash serves 4
+ * channels. The few lower means, dead channels included, are drawn exactly
+ * by inversion afterwards. Not thread safe.
+ */
+class Mythen3Generator {
+public:
+	Mythen3Generator(int nbChannels, uint64_t seed = GeneratorSeed);
+
+	void setBackground(float level);
+	void clearPeaks();
+	void addPeak(float position, float fwhm, float height);
+	void setBadChannels(float deadFraction, float hotFraction);
+	void getMean(std::vector<float>& mean);
+	int getNbChannels() const;
+
+	void generate(uint32_t* counts, int nbChannels, long long frameNb);
+
+private:
+	struct Peak {
+		float position;						// channel of the maximum
+		float fwhm;							// full width at half maximum (channels)
+		float height;						// counts at the maximum
+	};
+
+	void update();
+
+	int m_nb_channels;
+	uint64_t m_seed;
+	float m_background;
+	float m_dead_fraction;
+	float m_hot_fraction;
+	std::vector<Peak> m_peaks;
+	bool m_updated;							// the tables below match the pattern
+	std::vector<float> m_mean;				// mean counts per channel
+	std::vector<float> m_sigma;				// square root of the mean
+	std::vector<int> m_low;					// channels below PoissonNormalMin
+	std::vector<float> m_low_exp;			// exp(-mean) of these channels
+	float m_normal[NormalTableSize];		// standard normal quantiles
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3GENERATOR_H_
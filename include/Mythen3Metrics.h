@@ -0,0 +1,116 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3METRICS_H_
+#define MYTHEN3METRICS_H_
+
+#include <atomic>
+#include <string>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+
+namespace lima {
+namespace Mythen3 {
+
+const double MetricsExportPeriod = 1.0; // default period of the metrics export (s)
+const char MetricsSocketPrefix[] = "unix:"; // export target prefix selecting a Unix socket
+const int MetricsSocketBacklog = 4; // pending connections to the metrics socket
+
+/*
+ * Health metrics of the acquisition pipeline: frames and bytes read out,
+ * readout and decode time, buffer ring occupancy and overruns. Updated
+ * without locks by the acquisition thread; formatText() renders them in the
+ * Prometheus text format together with the frame and byte rates since its
+ * previous call.
+ *
+ * The ring occupancy and the overruns refer to the frames read back with
+ * Camera::readFrame() and Camera::readData(): a frame is overrun when the
+ * ring wraps over it before it was read. Frames consumed through the Lima
+ * control layer are not seen here, so nothing is counted before the first
+ * read of an acquisition. The frame views still held when the ring wraps
+ * over them are copied out of the ring and counted as view copies.
+ */
+class Mythen3Metrics {
+public:
+	Mythen3Metrics();
+
+	void startAcq(int ringSize);
+	void frameAcquired(long long frameNb, int bytes, long long readoutNs, long long decodeNs);
+	void framesRead(long long lastFrameNb);
+	void viewDetached();
+	void formatText(std::string& text);
+
+	static long long now();
+
+private:
+	std::atomic<long long> m_acquisitions;
+	std::atomic<long long> m_frames;
+	std::atomic<long long> m_bytes;
+	std::atomic<long long> m_readout_ns;
+	std::atomic<long long> m_decode_ns;
+	std::atomic<long long> m_decoded_frames;
+	std::atomic<long long> m_overruns;
+	std::atomic<long long> m_view_copies;	// frame views copied out of the ring
+	std::atomic<long long> m_acq_frames;		// frames of the current acquisition
+	std::atomic<long long> m_last_read;		// last frame read back, -1 if none
+	std::atomic<int> m_ring_size;
+
+	Mutex m_rate_mutex;						// the rate state of formatText()
+	long long m_rate_time;
+	long long m_rate_frames;
+	long long m_rate_bytes;
+};
+
+/*
+ * Export the metrics in the Prometheus text format, either by writing them
+ * every period to a file, replaced atomically for the node exporter textfile
+ * collector, or by serving them on a Unix socket ("unix:" prefix): each
+ * connection gets an HTTP/1.0 response with the current metrics.
+ */
+class Mythen3MetricsExporter {
+DEB_CLASS_NAMESPC(DebModCamera, "Mythen3MetricsExporter", "Mythen3");
+
+public:
+	Mythen3MetricsExporter(Mythen3Metrics& metrics, const std::string& target, double period);
+	~Mythen3MetricsExporter();
+
+private:
+	class ExportThread;
+	friend class ExportThread;
+
+	void run();
+	void writeFile();
+	void serve(int client);
+
+	Mythen3Metrics& m_metrics;
+	std::string m_target;
+	std::string m_socket_path;				// empty when writing a file
+	double m_period;
+	int m_listen;							// listening Unix socket, -1 if none
+	int m_stop_pipe[2];						// wakes up the export thread to quit
+	ExportThread* m_thread;
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3METRICS_H_
@@ -24,13 +24,26 @@
 #define MYTHEN3NET_H_
 
 #include <netinet/in.h>
+#include <stdio.h>
+#include <vector>
 #include "lima/Debug.h"
+#include "Mythen3Uring.h"
+#include "Mythen3Statistics.h"
 
 using namespace std;
 
 namespace lima {
 namespace Mythen3 {
 
+const int PipelineBufSize = 1024; // commands coalesced in one write when pipelining
+const int MaxReconnectRetries = 6; // connection attempts after the first one in reconnect()
+const double ReconnectDelay = 0.1; // first delay between connection attempts (s), doubled after each
+const int KeepAliveIdle = 2; // idle time before the first keepalive probe (s)
+const int KeepAliveInterval = 1; // time between keepalive probes (s)
+const int KeepAliveCount = 3; // unanswered probes before the connection is lost
+const int UserTimeout = 5000; // unacknowledged data before the connection is lost (ms)
+const char ReplayPrefix[] = "replay:"; // hostname prefix selecting a recorded traffic file
+
 class Mythen3Net {
 DEB_CLASS_NAMESPC(DebModCamera, "Mythen3Net", "Mythen3");
 
@@ -38,13 +51,73 @@ public:
 	Mythen3Net();
 	~Mythen3Net();
 
-	void sendCmd(string cmd, uint8_t* value, int len);
+	// One command of a batch and the buffer receiving its reply
+	struct Request {
+		const char* cmd;				// null terminated command
+		uint8_t* reply;					// reply buffer
+		int len;						// expected reply length
+		int slot;						// statistics slot, -1 for none
+	};
+
+	int sendCmd(const char* cmd, uint8_t* value, int len, int slot = -1, bool data = false);
+	void sendCmds(Request* requests, int nbRequests);
 	void connectToServer (const string hostname, int port);
 	void disconnectFromServer();
+	void reconnect();
+	bool isConnected() const;
+	void startRecording(const string& fileName);
+	void stopRecording();
+	void openReplay(const string& fileName);
+	void setReplaySpeed(double speed);
+	void setRecvBufferSize(int size);
+	int getRecvBufferSize() const;
+	void setQuickAck(bool enable);
+	bool getQuickAck() const;
+	void setBusyPoll(int usecs);
+	int getBusyPoll() const;
+	void setReadTimeout(double timeout);
+	double getReadTimeout() const;
+	bool setIoUring(bool enable);
+	bool getIoUring() const;
+	void registerBuffers(void* const* buffers, int nbBuffers, int size);
+	void unregisterBuffers();
+	void setPipelining(bool enable);
+	bool getPipelining() const;
+	void setStatistics(Mythen3Statistics* stats);
 
 private:
+	void writeCmd(const char* cmd, int len);
+	int readReply(uint8_t* buffer, int len);
+	void readBytes(uint8_t* buffer, int len);
+	int uringExchange(const char* cmd, uint8_t* buffer, int len);
+	void connectionLost();
+	void countReply(int slot, const uint8_t* reply, int len, long long latency);
+	void countFailure(int slot);
+	bool setBusyPollOption(int usecs);
+	bool setReadTimeoutOption(double timeout);
+	bool setKeepAliveOptions();
+	void record(const char* cmd, const uint8_t* reply, int len, long long sendTime, long long endTime);
+	void replayCmd(const char* cmd, uint8_t* buffer, int len);
+
 	mutable Cond m_cond;
 	bool m_connected;					// true if connected
+	bool m_pipelining;					// write a whole batch before reading the replies
+	string m_hostname;					// server of the last connection
+	int m_port;							// port of the last connection
+	int m_rcvbuf;						// SO_RCVBUF, 0 = system default
+	bool m_quick_ack;					// TCP_QUICKACK before each reply
+	int m_busy_poll;					// SO_BUSY_POLL (us), 0 = disabled
+	double m_read_timeout;				// SO_RCVTIMEO (s), 0 = none
+	Mythen3Uring m_uring;				// io_uring transport, if enabled
+	Mythen3Statistics* m_stats;			// exchange counters, 0 if none
+	int m_cmd_reads;					// recv() calls for the last command
+	FILE* m_record_file;				// traffic recording, 0 if not recording
+	long long m_record_start;			// recording start (ns)
+	bool m_replaying;					// commands answered from a recording
+	double m_replay_speed;				// replay time scale, 0 = no delay
+	std::vector<char> m_replay_data;	// the recording
+	std::vector<size_t> m_replay_index;	// offset of each record
+	size_t m_replay_pos;				// next record to match
 	int m_sock;							// socket for commands */
 	struct sockaddr_in m_remote_addr;	// address of remote server */
 };
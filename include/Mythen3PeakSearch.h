@@ -0,0 +1,80 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3PEAKSEARCH_H_
+#define MYTHEN3PEAKSEARCH_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const int MaxPeaks = 64;	// peaks kept per frame, the first ones in channel order
+
+/*
+ * Peak search in each decoded frame: a peak is a run of at least minWidth
+ * consecutive channels at or above the threshold. Its position is the
+ * centroid of the counts above the threshold, its height the highest
+ * count and its area the sum of its counts. The frame is scanned once,
+ * eight channels at a time while they stay below the threshold. The peaks
+ * are kept in a ring of rows, by frame modulo the number of rows. Not
+ * thread safe: the camera serialises the configuration and the reads with
+ * the acquisition.
+ */
+class Mythen3PeakSearch {
+public:
+	struct Peak {
+		double position;					// centroid (channels)
+		double height;						// highest count
+		double area;						// sum of the counts
+		int width;							// channels
+	};
+
+	Mythen3PeakSearch();
+
+	void setThreshold(uint32_t threshold, int minWidth);
+	void getThreshold(uint32_t& threshold, int& minWidth) const;
+	bool isEnabled() const;
+
+	void startAcq(int nbRows, int width);
+	void compute(long long frameNb, const uint32_t* frame);
+	int getNbRows() const;
+	int getNbPeaks(long long frameNb) const;
+	const Peak* getPeaks(long long frameNb) const;
+
+	static int search(const uint32_t* frame, int width, uint32_t threshold, int minWidth,
+			Peak* peaks, int maxPeaks);
+
+private:
+	uint32_t m_threshold;				// lowest count of a peak channel, 0 if disabled
+	int m_min_width;					// fewest channels of a peak
+	int m_width;						// channels per frame
+	int m_nb_rows;						// frames held by the ring
+	std::vector<int> m_nb_peaks;		// peaks of each row
+	std::vector<Peak> m_peaks;			// MaxPeaks peaks per row
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3PEAKSEARCH_H_
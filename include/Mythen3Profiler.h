@@ -0,0 +1,84 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3PROFILER_H_
+#define MYTHEN3PROFILER_H_
+
+#include <stdint.h>
+#include "lima/Debug.h"
+
+namespace lima {
+namespace Mythen3 {
+
+// Stages of the acquisition loop
+enum ProfileStage {PROFILE_READOUT, PROFILE_DECODE, PROFILE_REDUCE, PROFILE_PUBLISH, NB_PROFILE_STAGES};
+// Hardware counters read at each stage boundary
+enum ProfileCounter {PROFILE_INSTRUCTIONS, PROFILE_CYCLES, PROFILE_CACHE_MISSES, PROFILE_BRANCH_MISSES,
+	NB_PROFILE_COUNTERS};
+
+/*
+ * Hardware performance counters (perf_event_open) of the calling thread,
+ * accumulated by stage of the acquisition loop. Only user space is counted,
+ * which perf_event_paranoid up to 2 allows without privileges: the time the
+ * readout spends in the kernel is not seen. A counter the CPU or the
+ * virtual machine does not provide is left out. Not thread safe: open(),
+ * sample() and stage() must be called from the profiled thread.
+ */
+class Mythen3Profiler {
+DEB_CLASS_NAMESPC(DebModCamera, "Mythen3Profiler", "Mythen3");
+
+public:
+	// Counts accumulated since the last reset()
+	struct Result {
+		long long frames[NB_PROFILE_STAGES];		// frames through each stage
+		unsigned long long counts[NB_PROFILE_STAGES][NB_PROFILE_COUNTERS];
+		bool available[NB_PROFILE_COUNTERS];		// counter opened
+	};
+
+	Mythen3Profiler();
+	~Mythen3Profiler();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+	void reset();
+	void sample();
+	void stage(ProfileStage stage);
+	void getResult(Result& result) const;
+
+	static const char* stageName(ProfileStage stage);
+
+private:
+	bool read(uint64_t* values);
+
+	int m_fds[NB_PROFILE_COUNTERS];			// -1 for a counter not available
+	int m_leader;							// group leader, -1 if not open
+	int m_nb_counters;						// counters in the group
+	int m_index[NB_PROFILE_COUNTERS];		// position in the group read
+	uint64_t m_last[NB_PROFILE_COUNTERS];	// values at the last sample
+	Result m_result;
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3PROFILER_H_
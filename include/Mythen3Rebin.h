@@ -0,0 +1,91 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3REBIN_H_
+#define MYTHEN3REBIN_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const int MaxRebinBins = 1 << 16;	// angular bins of a rebinned pattern
+
+/*
+ * Conversion of the channels to the 2θ scattering angle and rebinning of
+ * each frame onto a common angular grid, merging the modules. The angle of
+ * the position x (in channels) of a module is
+ *   2θ(x) = offset + atan((x - centre) * conversion)  (degrees)
+ * and the counts of a channel are spread over the bins its angular width
+ * overlaps, in proportion to the overlap. A bin holds the weighted counts
+ * divided by the channels covering it, so that the modules overlapping it
+ * are averaged. The weights, normalisation included, are precomputed once
+ * per acquisition into a sparse table holding the same number of bins for
+ * every channel, padded with null weights. The patterns are kept in a ring of rows, by
+ * frame modulo the number of rows. Not thread safe: the camera serialises
+ * the configuration and the reads with the acquisition.
+ */
+class Mythen3Rebin {
+public:
+	Mythen3Rebin();
+
+	void setCalibration(const std::vector<double>& centre, const std::vector<double>& conversion,
+			const std::vector<double>& offset);
+	void getCalibration(std::vector<double>& centre, std::vector<double>& conversion,
+			std::vector<double>& offset) const;
+	int getNbCalibratedModules() const;
+	void setBinning(double start, double end, double binSize);
+	void getBinning(double& start, double& end, double& binSize) const;
+	bool isEnabled() const;
+	int getNbBins() const;
+	void getAngles(std::vector<double>& angles) const;
+
+	void build(int width, int moduleChannels);
+	int getNbEntries() const;
+	void startAcq(int nbRows);
+	void compute(long long frameNb, const uint32_t* frame);
+	int getNbRows() const;
+	const float* getRow(long long frameNb) const;
+
+	static double twoTheta(double centre, double conversion, double offset, double x);
+
+private:
+	std::vector<double> m_centre;		// centre of each module (channels)
+	std::vector<double> m_conversion;	// conversion of each module (rad per channel)
+	std::vector<double> m_offset;		// offset of each module (degrees)
+	double m_start;						// lower edge of the first bin (degrees)
+	double m_bin_size;					// bin width (degrees), 0 if disabled
+	int m_nb_bins;
+	int m_width;						// channels of the table
+	int m_channel_bins;					// table entries per channel
+	std::vector<int> m_bin;				// bin of each table entry, by channel
+	std::vector<float> m_weight;		// normalised weight of each table entry
+	std::vector<float> m_sums;			// bins of the frame being rebinned, and a padding bin
+	int m_nb_rows;						// patterns held by the ring
+	std::vector<float> m_patterns;		// m_nb_rows rows of m_nb_bins bins
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3REBIN_H_
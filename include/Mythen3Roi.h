@@ -0,0 +1,69 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3ROI_H_
+#define MYTHEN3ROI_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace lima {
+namespace Mythen3 {
+
+const int MaxRois = 64;				// channel ranges summed per frame
+const int RoiTableFrames = 1 << 16;	// frames of sums kept in a continuous acquisition
+
+/*
+ * Counts of each frame summed over channel ranges (regions of interest),
+ * computed by the acquisition thread as soon as the frame is decoded. The
+ * channels are numbered across the modules. The sums of a frame make one
+ * row of a table which holds the whole acquisition, or its last
+ * RoiTableFrames frames when it is continuous or longer. Not thread safe:
+ * the camera serialises the configuration and the reads with the
+ * acquisition.
+ */
+class Mythen3Roi {
+public:
+	Mythen3Roi();
+
+	void setRois(const std::vector<int>& first, const std::vector<int>& last);
+	void getRois(std::vector<int>& first, std::vector<int>& last) const;
+	int getNbRois() const;
+
+	void startAcq(int nbFrames);
+	void compute(long long frameNb, const uint32_t* frame);
+	int getNbRows() const;
+	const int64_t* getRow(long long frameNb) const;
+
+	static int64_t sum(const uint32_t* counts, int nbChannels);
+
+private:
+	std::vector<int> m_first;			// first channel of each ROI
+	std::vector<int> m_last;			// last channel of each ROI, included
+	int m_nb_rows;						// frames held by the table
+	std::vector<int64_t> m_table;		// m_nb_rows rows of sums, by frame modulo m_nb_rows
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3ROI_H_
@@ -0,0 +1,111 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3SIMULATOR_H_
+#define MYTHEN3SIMULATOR_H_
+
+#include <string>
+#include <vector>
+#include "lima/Debug.h"
+#include "lima/ThreadUtils.h"
+#include "Mythen3Camera.h"
+#include "Mythen3Generator.h"
+
+namespace lima {
+namespace Mythen3 {
+
+const int SimulatedMaxModules = 6; // modules of the simulated system
+
+/*
+ * Socket server emulated by a Camera created with simulate = true. Each
+ * camera owns its simulator and the commands may come from any thread.
+ * Started acquisitions produce their frames at the pace set by the exposure
+ * time and the delays, scaled by the simulation speed: READOUT and
+ * READOUTRAW block until the next frame is due. The trigger and gate modes
+ * are not emulated, frames are paced as with the internal trigger.
+ * READOUTRAW packs 32 / nbits channels per word as the detector does.
+ * The counts are synthetic diffraction patterns with Poisson noise.
+ */
+class Camera::Simulator {
+DEB_CLASS_NAMESPC(DebModCamera, "Camera", "Simulator");
+
+public:
+	Simulator();
+
+	void exchange(Action action, ServerCmd cmd, uint8_t* recvBuf, int len);
+	void setSpeed(double speed);
+	double getSpeed();
+
+private:
+	void get(ServerCmd cmd, uint8_t* recvBuf);
+	void set(ServerCmd cmd, const uint8_t* value);
+	void command(ServerCmd cmd, uint8_t* recvBuf, int len);
+	int getStatus();
+	long long getFramesDue();
+	void waitForFrame();
+	void packRaw(const uint32_t* counts, uint32_t* raw, int nbWords);
+
+	Cond m_cond;							// guards the state, signals STOP
+	double m_speed;							// time scale, 0 = no delay
+	std::string m_assembly_date;
+	std::string m_version;
+	int m_command_id;
+	int m_modnum[SimulatedMaxModules];
+	int m_module;
+	int m_max_modules;
+	int m_nmodules;
+	int m_sensor_material;
+	int m_sensor_thickness;
+	int m_sys_num;
+	bool m_bad_channel_interpolation;
+	bool m_flatfield_correction;
+	bool m_rate_correction;
+	bool m_trigger_mode;
+	bool m_gate;
+	bool m_continuous_trigger;
+	float m_energy[SimulatedMaxModules];
+	float m_kthresh[SimulatedMaxModules];
+	float m_tau[SimulatedMaxModules];
+	float m_energy_max;
+	float m_energy_min;
+	float m_kthresh_max;
+	float m_kthresh_min;
+	int m_inpol;
+	int m_outpol;
+	int m_gates;
+	long long m_delafter;					// 100 ns units
+	long long m_delbef;						// 100 ns units
+	long long m_time;						// 100 ns units
+	int m_frames;
+	int m_nbits;
+	int m_cutoff;
+	bool m_running;							// acquisition started and not stopped
+	double m_start_time;					// time of the START command (s)
+	long long m_readouts;					// frames read out since START
+	Mythen3Generator m_generator;			// counts of frame m_readouts - 1
+	std::vector<uint32_t> m_counts;			// channel counts of the next raw frame
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3SIMULATOR_H_
@@ -0,0 +1,89 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3STATISTICS_H_
+#define MYTHEN3STATISTICS_H_
+
+#include <atomic>
+
+namespace lima {
+namespace Mythen3 {
+
+const int LatencySubBuckets = 4; // latency histogram buckets per power of 2
+const int NbLatencyBuckets = 41 * LatencySubBuckets; // latencies up to 2^42 ns
+const int NbStatusCodes = 33; // socket server status codes 0 to -32
+
+/*
+ * Counters of the exchanges with the socket server, one slot per command.
+ * The reply latencies are kept in a histogram with LatencySubBuckets
+ * buckets per power of 2 of the latency in ns, so that the percentiles are
+ * known within 25%. Updated without locks from any thread: the counters of a
+ * slot read while it is updated may be off by one exchange.
+ */
+class Mythen3Statistics {
+public:
+	// Counters of one slot
+	struct Summary {
+		long long count;					// exchanges
+		long long bytes;					// reply bytes received
+		long long errors;					// error replies
+		long long failures;					// exchanges without a reply
+		long long p50;						// median latency (ns)
+		long long p99;						// 99th percentile latency (ns)
+		long long max;						// maximum latency (ns)
+		long long errorCodes[NbStatusCodes];	// error replies by status code
+	};
+
+	Mythen3Statistics(int nbSlots);
+	~Mythen3Statistics();
+
+	void add(int slot, long long latency, int bytes, int status);
+	void addFailure(int slot);
+	void reset();
+	int getNbSlots() const;
+	void getSummary(int slot, Summary& summary) const;
+
+private:
+	struct Slot {
+		std::atomic<long long> count;
+		std::atomic<long long> bytes;
+		std::atomic<long long> failures;
+		std::atomic<long long> max;
+		std::atomic<long long> buckets[NbLatencyBuckets];
+		std::atomic<long long> errorCodes[NbStatusCodes];
+	};
+
+	static int bucketOf(long long latency);
+	static long long bucketLimit(int bucket);
+	static long long percentile(const long long* buckets, long long count, double fraction);
+
+	Mythen3Statistics(const Mythen3Statistics&);
+	Mythen3Statistics& operator=(const Mythen3Statistics&);
+
+	int m_nb_slots;
+	Slot* m_slots;
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3STATISTICS_H_
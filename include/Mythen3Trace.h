@@ -0,0 +1,47 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3TRACE_H
+#define MYTHEN3TRACE_H
+
+#include <iostream>
+#include "lima/Debug.h"
+
+/*
+ * Tracing of the per-frame readout path (readout, decode, sendCmd).
+ * It is compiled out unless MYTHEN3_HOT_PATH_TRACE is defined, so that
+ * frames do not pay for the debug objects. Functions using DEB_HOT_FUNCT()
+ * must use DEB_HOT_ERROR_FUNCT() in the block that throws: it declares the
+ * debug object only when DEB_HOT_FUNCT() did not, so that it never shadows
+ * the one of the function.
+ */
+#ifdef MYTHEN3_HOT_PATH_TRACE
+#define DEB_HOT_FUNCT()			DEB_MEMBER_FUNCT()
+#define DEB_HOT_TRACE()			DEB_TRACE()
+#define DEB_HOT_ERROR_FUNCT()
+#else
+#define DEB_HOT_FUNCT()
+#define DEB_HOT_TRACE()			while (false) std::cerr
+#define DEB_HOT_ERROR_FUNCT()	DEB_MEMBER_FUNCT()
+#endif
+
+#endif // MYTHEN3TRACE_H
@@ -0,0 +1,98 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3URING_H_
+#define MYTHEN3URING_H_
+
+#include <stdint.h>
+#include <vector>
+#include "lima/Debug.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace lima {
+namespace Mythen3 {
+
+const unsigned int UringDepth = 8; // submission queue entries of the readout ring
+
+/*
+ * io_uring transport for the command/reply exchanges of Mythen3Net. The
+ * command and the receive of its reply are queued as one linked chain and
+ * both completions are waited for together, so that a frame normally costs
+ * a single io_uring_enter() instead of a write() and a recv(). Replies
+ * landing in a registered buffer (the Lima frame ring during an acquisition)
+ * are read with READ_FIXED into the pre-mapped pages.
+ */
+class Mythen3Uring {
+DEB_CLASS_NAMESPC(DebModCamera, "Mythen3Uring", "Mythen3");
+
+public:
+	Mythen3Uring();
+	~Mythen3Uring();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+	bool registerBuffers(void* const* buffers, int nbBuffers, int size);
+	void unregisterBuffers();
+	int exchange(int sock, const char* cmd, int cmdLen, uint8_t* buffer, int len,
+			double timeout, int& nbCalls);
+
+private:
+	enum Tag {TAG_SEND, TAG_RECV, TAG_CANCEL, NB_TAGS};
+
+	int findBuffer(const uint8_t* buffer, int len);
+	struct io_uring_sqe* nextSqe(int opcode, int fd, const void* addr, int len, Tag tag);
+	void queueRecv(int sock, uint8_t* buffer, int len, int bufIndex);
+	void cancel(Tag tag);
+	int waitFor(Tag tag, long long deadline, int& nbCalls);
+	void drain(int& nbCalls);
+	void reap();
+
+	int m_fd;
+	void* m_sq_ptr;
+	size_t m_sq_size;
+	void* m_cq_ptr;
+	size_t m_cq_size;
+	struct io_uring_sqe* m_sqes;
+	size_t m_sqes_size;
+	unsigned int* m_sq_head;
+	unsigned int* m_sq_tail;
+	unsigned int* m_sq_mask;
+	unsigned int* m_sq_array;
+	unsigned int* m_cq_head;
+	unsigned int* m_cq_tail;
+	unsigned int* m_cq_mask;
+	struct io_uring_cqe* m_cqes;
+	unsigned int m_to_submit;			// queued entries not yet submitted
+	bool m_pending[NB_TAGS];			// operations in flight
+	int m_result[NB_TAGS];				// completion results
+	std::vector<uint8_t*> m_buffers;	// registered buffers
+	int m_buffer_size;
+	int m_last_buffer;					// last registered buffer used
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3URING_H_
@@ -0,0 +1,149 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3Accumulator.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+Mythen3Accumulator::Mythen3Accumulator() :
+		m_nb_sub_frames(1), m_width(0), m_threshold(0), m_nb_rows(0) {
+}
+
+/*
+ * Set the sub-frames summed per frame, validated by the caller. Taken into
+ * account at the next startAcq().
+ */
+void Mythen3Accumulator::setNbSubFrames(int nbSubFrames) {
+	m_nb_sub_frames = nbSubFrames;
+}
+
+int Mythen3Accumulator::getNbSubFrames() const {
+	return m_nb_sub_frames;
+}
+
+/*
+ * Size the tables for an acquisition of nbFrames accumulated frames, 0 if
+ * continuous, of width channels, badChannels of which are read as -2
+ */
+void Mythen3Accumulator::startAcq(int nbFrames, int width, uint32_t threshold, Timestamp start,
+		const vector<int>& badChannels) {
+	m_width = width;
+	m_threshold = threshold;
+	m_start = start;
+	m_bad.clear();
+	if (m_nb_sub_frames == 1) {
+		m_nb_rows = 0;
+		m_records.clear();
+		m_saturated.clear();
+		m_sub_frame.clear();
+		return;
+	}
+	for (size_t i = 0; i < badChannels.size(); i++)
+		if (badChannels[i] < width)
+			m_bad.push_back(badChannels[i]);
+	m_bad_counts.resize(m_bad.size());
+	m_nb_rows = (nbFrames > 0 && nbFrames < AccTableFrames) ? nbFrames : AccTableFrames;
+	m_records.resize(m_nb_rows);
+	m_saturated.resize(static_cast<size_t>(m_nb_rows) * m_nb_sub_frames);
+	m_sub_frame.resize(width);
+}
+
+/*
+ * Where to read out the sub-frames after the first
+ */
+uint32_t* Mythen3Accumulator::getSubFrameBuffer() {
+	return &m_sub_frame[0];
+}
+
+/*
+ * Account for sub-frame subFrame of frame frameNb: the first one is already
+ * in the frame buffer, the next ones are added to it
+ */
+void Mythen3Accumulator::addSubFrame(long long frameNb, int subFrame, uint32_t* frame,
+		const uint32_t* subFrameData) {
+	int row = static_cast<int>(frameNb % m_nb_rows);
+	Record& record = m_records[row];
+	int nbBad = m_bad.size();
+	bool isSaturated;
+	if (subFrame == 0) {
+		for (int i = 0; i < nbBad; i++) {
+			m_bad_counts[i] = frame[m_bad[i]];
+			frame[m_bad[i]] = 0;
+		}
+		isSaturated = saturated(frame, m_width, m_threshold);
+		record.nbSaturated = 0;
+	} else {
+		// subFrameData is the scratch buffer
+		for (int i = 0; i < nbBad; i++)
+			m_sub_frame[m_bad[i]] = 0;
+		isSaturated = add(frame, subFrameData, m_width, m_threshold);
+	}
+	if (subFrame == m_nb_sub_frames - 1) {
+		for (int i = 0; i < nbBad; i++)
+			frame[m_bad[i]] = m_bad_counts[i];
+	}
+	double now = Timestamp::now() - m_start;
+	if (subFrame == 0)
+		record.start = now;
+	record.end = now;
+	record.nbSubFrames = subFrame + 1;
+	record.nbSaturated += isSaturated;
+	m_saturated[static_cast<size_t>(row) * m_nb_sub_frames + subFrame] = isSaturated;
+}
+
+int Mythen3Accumulator::getNbRows() const {
+	return m_nb_rows;
+}
+
+const Mythen3Accumulator::Record& Mythen3Accumulator::getRecord(long long frameNb) const {
+	return m_records[frameNb % m_nb_rows];
+}
+
+/*
+ * The saturation flags of the sub-frames of frameNb, one byte each
+ */
+const uint8_t* Mythen3Accumulator::getSaturated(long long frameNb) const {
+	return &m_saturated[(frameNb % m_nb_rows) * m_nb_sub_frames];
+}
+
+/*
+ * Add subFrame to frame, returning whether a channel of subFrame reaches
+ * threshold. The comparison is folded into the loop without a branch so
+ * that the compiler vectorises both.
+ */
+bool Mythen3Accumulator::add(uint32_t* frame, const uint32_t* subFrame, int width, uint32_t threshold) {
+	uint32_t over = 0;
+	for (int i = 0; i < width; i++) {
+		frame[i] += subFrame[i];
+		over |= (subFrame[i] >= threshold);
+	}
+	return over != 0;
+}
+
+bool Mythen3Accumulator::saturated(const uint32_t* frame, int width, uint32_t threshold) {
+	uint32_t over = 0;
+	for (int i = 0; i < width; i++)
+		over |= (frame[i] >= threshold);
+	return over != 0;
+}
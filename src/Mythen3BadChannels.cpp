@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3BadChannels.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace lima::Mythen3;
+
+Mythen3BadChannels::Mythen3BadChannels() {
+}
+
+/*
+ * Set the bad channels, numbered across the modules; none when the
+ * detector interpolates them. Taken into account at the next startAcq().
+ */
+void Mythen3BadChannels::setBadChannels(const vector<int>& channels) {
+	m_channels = channels;
+	sort(m_channels.begin(), m_channels.end());
+	m_channels.erase(unique(m_channels.begin(), m_channels.end()), m_channels.end());
+}
+
+const vector<int>& Mythen3BadChannels::getBadChannels() const {
+	return m_channels;
+}
+
+/*
+ * Find the neighbours of the bad channels among width channels,
+ * moduleChannels per module
+ */
+void Mythen3BadChannels::startAcq(int width, int moduleChannels) {
+	m_masked.clear();
+	for (size_t i = 0; i < m_channels.size() && m_channels[i] < width; i++)
+		m_masked.push_back(m_channels[i]);
+	int nb = m_masked.size();
+	m_left.assign(nb, -1);
+	m_right.assign(nb, -1);
+	for (int i = 0; i < nb; i++) {
+		int c = m_masked[i];
+		int first = c - c % moduleChannels;
+		int last = first + moduleChannels - 1;
+		for (int j = i - 1, n = c - 1; n >= first; j--, n--) {
+			if (j < 0 || m_masked[j] != n) {
+				m_left[i] = n;
+				break;
+			}
+		}
+		for (int j = i + 1, n = c + 1; n <= last; j++, n++) {
+			if (j == nb || m_masked[j] != n) {
+				m_right[i] = n;
+				break;
+			}
+		}
+	}
+	m_frame.resize(nb ? width : 0);
+}
+
+/*
+ * The frame to reduce: frame itself without bad channels, otherwise its
+ * masked copy, valid until the next call
+ */
+const uint32_t* Mythen3BadChannels::mask(const uint32_t* frame) {
+	int nb = m_masked.size();
+	if (nb == 0)
+		return frame;
+	memcpy(&m_frame[0], frame, m_frame.size() * sizeof(uint32_t));
+	for (int i = 0; i < nb; i++) {
+		int left = m_left[i], right = m_right[i];
+		uint32_t counts = 0;
+		if (left >= 0 && right >= 0)
+			counts = static_cast<uint32_t>((static_cast<uint64_t>(frame[left]) + frame[right]) / 2);
+		else if (left >= 0)
+			counts = frame[left];
+		else if (right >= 0)
+			counts = frame[right];
+		m_frame[m_masked[i]] = counts;
+	}
+	return &m_frame[0];
+}
@@ -22,13 +22,17 @@
 
 #include <errno.h>
 #include <cmath>
+#include <cstdio>
 #include <pthread.h>
+#include <algorithm>
 #include <map>
 #include <limits.h>
 #include "lima/Exceptions.h"
 #include "lima/Debug.h"
 #include "lima/MiscUtils.h"
 #include "Mythen3Camera.h"
+#include "Mythen3Simulator.h"
+#include "Mythen3Trace.h"
 
 using namespace lima;
 using namespace lima::Mythen3;
@@ -47,18 +51,29 @@ protected:
 	virtual void threadFunction();
 
 private:
+	void registerFrameBuffers(StdBufferCbMgr& buffer_mgr);
+
 	Camera& m_cam;
+	Mythen3Profiler m_profiler;			// counters of this thread
 };
 
 Camera::Camera(std::string hostname, int tcpPort, bool simulate) :
 		m_hostname(hostname), m_tcpPort(tcpPort), m_simulated(simulate), m_acq_frame_nb(-1),
-		m_nb_frames(1), m_image_type(Bpp32), m_bufferCtrlObj() {
+		m_nb_frames(1), m_nb_buffers(1), m_image_type(Bpp32), m_nbits_cached(false),
+		m_scan_mode(false), m_start_pending(false), m_start_latency(-1), m_acq_read_timeout(0),
+		m_cmd_pipelining(false),
+		m_auto_reconnect(true), m_nb_reconnects(0), m_acq_failed(false), m_reads_per_frame(0), m_readout_reads(0),
+		m_simulator(0), m_bufferCtrlObj(),
+		m_sync_pending(0), m_sync_known(0), m_config_count(0), m_cmd_stats(NB_SERVER_CMDS),
+		m_bad_channels_known(false), m_cutoff(-1), m_acc_threshold(0), m_metrics_exporter(0), m_profiling(false) {
+	for (int cmd = 0; cmd < NB_SERVER_CMDS; cmd++)
+		m_config_seq[cmd] = 0;
+	memset(&m_profile, 0, sizeof(m_profile));
 	DEB_CONSTRUCTOR();
 
-	DebParams::setModuleFlags(DebParams::AllFlags);
-	DebParams::setTypeFlags(DebParams::AllFlags);
-	DebParams::setFormatFlags(DebParams::AllFlags);
 	m_use_raw_readout = false;
+	if (m_simulated)
+		m_simulator = new Simulator();
 	m_acq_thread = new AcqThread(*this);
 	m_acq_thread->start();
 	if (!m_simulated) {
@@ -68,17 +83,28 @@ Camera::Camera(std::string hostname, int tcpPort, bool simulate) :
 
 Camera::~Camera() {
 	DEB_DESTRUCTOR();
+	delete m_metrics_exporter;
+	delete m_acq_thread;
+	// the views still held must outlive the buffer ring
+	detachFrames(-1);
 	if (!m_simulated) {
 		delete m_mythen;
 	}
-	delete m_acq_thread;
+	delete m_simulator;
 }
 
 void Camera::init() {
 	DEB_MEMBER_FUNCT();
 	m_mythen = new Mythen3Net();
-	DEB_TRACE() << "Mythen3 connecting to " << DEB_VAR2(m_hostname, m_tcpPort);
-	m_mythen->connectToServer(m_hostname, m_tcpPort);
+	m_mythen->setStatistics(&m_cmd_stats);
+	int prefixLength = sizeof(ReplayPrefix) - 1;
+	if (m_hostname.compare(0, prefixLength, ReplayPrefix) == 0) {
+		DEB_TRACE() << "Mythen3 replaying " << m_hostname.substr(prefixLength);
+		m_mythen->openReplay(m_hostname.substr(prefixLength));
+	} else {
+		DEB_TRACE() << "Mythen3 connecting to " << DEB_VAR2(m_hostname, m_tcpPort);
+		m_mythen->connectToServer(m_hostname, m_tcpPort);
+	}
 	resetMythen();
 }
 
@@ -89,17 +115,65 @@ void Camera::reset() {
 	m_image_type = Bpp32;
 }
 
+/**
+ * Arm the next acquisition: the synchronisation parameters changed since
+ * the last acquisition are sent to the detector and everything the
+ * acquisition thread needs is computed here so that startAcq() only has to
+ * send the start command. In scan mode the cached number of bits is trusted
+ * and no network request is made.
+ */
 void Camera::prepareAcq() {
 	DEB_MEMBER_FUNCT();
-	getNbits(m_nbits);
+	applySyncConfig();
+	if (!m_scan_mode || !m_nbits_cached) {
+		getNbits(m_nbits);
+	}
+	double read_timeout = readoutTimeout();
+	uint32_t acc_threshold = accThreshold();
+	bool masking = m_roi.getNbRois() > 0 || m_rebin.isEnabled() || m_peak_search.isEnabled()
+			|| m_channel_binning.isEnabled() || m_accumulator.getNbSubFrames() > 1;
+	if (masking && (!m_scan_mode || !m_bad_channels_known))
+		updateBadChannels();
+	detachFrames(-1);
+	AutoMutex aLock(m_cond.mutex());
+	m_acc_threshold = acc_threshold;
+	m_acq_read_timeout = read_timeout;
+	m_acq_use_raw = (m_nbits == Camera::BPP24) ? false : m_use_raw_readout;
+	m_acq_width = m_image_width;
+	m_acq_size = m_acq_width / (CHAR_BIT * sizeof(int) / m_nbits);
+	DEB_TRACE() << DEB_VAR4(m_nbits, m_acq_use_raw, m_acq_width, m_acq_size);
+	std::vector<int> roiFirst, roiLast;
+	m_roi.getRois(roiFirst, roiLast);
+	for (size_t r = 0; r < roiLast.size(); r++) {
+		if (roiLast[r] >= m_acq_width) {
+			THROW_HW_ERROR(InvalidValue) << "ROI " << roiFirst[r] << " to " << roiLast[r]
+					<< " beyond the last channel " << m_acq_width - 1;
+		}
+	}
+	if (m_rebin.isEnabled()) {
+		int nbModules = m_acq_width / PixelsPerModule;
+		if (m_rebin.getNbCalibratedModules() < nbModules) {
+			THROW_HW_ERROR(InvalidValue) << "Rebinning needs the angular calibration of "
+					<< nbModules << " modules, " << m_rebin.getNbCalibratedModules() << " set";
+		}
+		m_rebin.build(m_acq_width, PixelsPerModule);
+		DEB_TRACE() << "rebinning table of " << m_rebin.getNbEntries() << " entries";
+	}
 }
 
+/**
+ * Start the armed acquisition. A start issued while the acquisition thread
+ * is still publishing the last frames of the previous acquisition is queued
+ * and picked up without waiting for the thread to go idle.
+ */
 void Camera::startAcq() {
 	DEB_MEMBER_FUNCT();
-	m_acq_frame_nb = 0; // Number of frames of data acquired;
-	StdBufferCbMgr& buffer_mgr = m_bufferCtrlObj.getBuffer();
-	buffer_mgr.setStartTimestamp(Timestamp::now());
 	AutoMutex aLock(m_cond.mutex());
+	m_start_timestamp = Timestamp::now();
+	m_start_latency = -1;
+	if (!m_thread_running)
+		m_acq_frame_nb = 0; // Number of frames of data acquired;
+	m_start_pending = true;
 	m_wait_flag = false;
 	m_quit = false;
 	m_cond.broadcast();
@@ -109,6 +183,7 @@ void Camera::stopAcq() {
 	DEB_MEMBER_FUNCT();
 	AutoMutex aLock(m_cond.mutex());
 	m_wait_flag = true;
+	m_start_pending = false;
 }
 
 void Camera::getStatus(Camera::Status& status) {
@@ -119,14 +194,13 @@ void Camera::getStatus(Camera::Status& status) {
 
 int Camera::getNbHwAcquiredFrames() {
 	DEB_MEMBER_FUNCT();
-	return m_acq_frame_nb;
+	return static_cast<int>(m_acq_frame_nb);
 }
 
 void Camera::AcqThread::threadFunction() {
 	DEB_MEMBER_FUNCT();
 	AutoMutex aLock(m_cam.m_cond.mutex());
 	StdBufferCbMgr& buffer_mgr = m_cam.m_bufferCtrlObj.getBuffer();
-	bool useRaw;
 
 	while (!m_cam.m_quit) {
 		while (m_cam.m_wait_flag && !m_cam.m_quit) {
@@ -139,33 +213,135 @@ void Camera::AcqThread::threadFunction() {
 			return;
 
 		DEB_TRACE() << "AcqThread Running" << DEB_VAR2(m_cam.m_wait_flag,m_cam.m_quit);
-		m_cam.start();
+		m_cam.m_start_pending = false;
+		m_cam.m_acq_frame_nb = 0;
+		m_cam.m_bufferCtrlObj.getNbBuffers(m_cam.m_nb_buffers);
+		buffer_mgr.setStartTimestamp(m_cam.m_start_timestamp);
+		m_cam.m_acq_failed = false;
+		try {
+			if (!m_cam.m_simulated) {
+				m_cam.m_mythen->setReadTimeout(m_cam.m_acq_read_timeout);
+				registerFrameBuffers(buffer_mgr);
+			}
+			m_cam.start();
+		} catch (Exception& e) {
+			DEB_ERROR() << "Acquisition start failed: " << e;
+			m_cam.m_acq_failed = true;
+			if (!m_cam.m_start_pending)
+				m_cam.m_wait_flag = true;
+			continue;
+		}
 		m_cam.m_thread_running = true;
 
 		m_cam.m_cond.broadcast();
 		Nbits nbits = m_cam.m_nbits;
-		useRaw = (nbits == Camera::BPP24) ? false : m_cam.m_use_raw_readout;
-		int width = m_cam.m_image_width;
-		int size = width / (CHAR_BIT * sizeof(int) / nbits);
-		DEB_TRACE() << DEB_VAR4(nbits, useRaw, width, size);
+		bool useRaw = m_cam.m_acq_use_raw;
+		int width = m_cam.m_acq_width;
+		int size = m_cam.m_acq_size;
+		DEB_TRACE() << DEB_VAR5(nbits, useRaw, width, size, m_cam.m_nb_buffers);
+		m_cam.m_reads_per_frame = 0;
+		m_cam.m_readout_reads = 0;
+		m_cam.m_metrics.startAcq(m_cam.m_nb_buffers);
+		m_cam.m_roi.startAcq(m_cam.m_nb_frames);
+		m_cam.m_rebin.startAcq(m_cam.m_nb_buffers);
+		m_cam.m_peak_search.startAcq(m_cam.m_nb_buffers, width);
+		m_cam.m_channel_binning.startAcq(m_cam.m_nb_buffers, width);
+		bool channelStats = m_cam.m_channel_stats.isEnabled();
+		{
+			AutoMutex statsLock(m_cam.m_stats_mutex);
+			m_cam.m_channel_stats.startAcq(width);
+		}
+		m_cam.m_bad_channels.startAcq(width, PixelsPerModule);
+		bool reducing = m_cam.m_roi.getNbRois() > 0 || m_cam.m_rebin.isEnabled()
+				|| m_cam.m_peak_search.isEnabled() || m_cam.m_channel_binning.isEnabled();
+		m_cam.m_accumulator.startAcq(m_cam.m_nb_frames, width, m_cam.m_acc_threshold, m_cam.m_start_timestamp,
+				m_cam.m_bad_channels.getBadChannels());
+		int subFrames = m_cam.m_accumulator.getNbSubFrames();
+		int frameBytes = (useRaw ? size : width) * sizeof(uint32_t);
+		bool profiling = m_cam.m_profiling;
 		aLock.unlock();
+		if (profiling && !m_profiler.isOpen())
+			profiling = m_profiler.open();
+		m_profiler.reset();
 
 		bool continueFlag = true;
+		bool failed = false;
 		while (continueFlag && (!m_cam.m_nb_frames || m_cam.m_acq_frame_nb < m_cam.m_nb_frames)) {
+			// a continuous acquisition ends where the Lima frame numbers (int) would wrap
+			if (m_cam.m_acq_frame_nb == MaxAcqFrames) {
+				DEB_WARNING() << "Acquisition stopped at the last Lima frame number " << MaxAcqFrames - 1;
+				try {
+					m_cam.stop();
+				} catch (Exception& e) {
+					DEB_WARNING() << "Detector not stopped: " << e;
+				}
+				break;
+			}
 
-			void* bptr = buffer_mgr.getFrameBufferPtr(m_cam.m_acq_frame_nb);
-			if (useRaw) {
-				m_cam.readoutRaw((uint32_t*) bptr, size);
-				m_cam.decodeRaw(nbits, (uint32_t*) bptr, width);
-			} else {
-				m_cam.readout((uint32_t*) bptr, width);
+			int index = m_cam.getRingIndex(m_cam.m_acq_frame_nb);
+			m_cam.detachFrames(index);
+			void* bptr = buffer_mgr.getFrameBufferPtr(index);
+			if (profiling)
+				m_profiler.sample();
+			long long readoutNs = 0, decodeNs = 0;
+			try {
+				for (int sub = 0; sub < subFrames; sub++) {
+					uint32_t* frame = sub ? m_cam.m_accumulator.getSubFrameBuffer() : (uint32_t*) bptr;
+					long long readoutStart = Mythen3Metrics::now();
+					if (useRaw) {
+						m_cam.readoutRaw(frame, size);
+						long long decodeStart = Mythen3Metrics::now();
+						if (profiling)
+							m_profiler.stage(PROFILE_READOUT);
+						m_cam.decodeRaw(nbits, frame, width);
+						long long decodeEnd = Mythen3Metrics::now();
+						if (profiling)
+							m_profiler.stage(PROFILE_DECODE);
+						readoutNs += decodeStart - readoutStart;
+						decodeNs += decodeEnd - decodeStart;
+					} else {
+						m_cam.readout(frame, width);
+						readoutNs += Mythen3Metrics::now() - readoutStart;
+						if (profiling)
+							m_profiler.stage(PROFILE_READOUT);
+					}
+					if (subFrames > 1) {
+						m_cam.m_accumulator.addSubFrame(m_cam.m_acq_frame_nb, sub, (uint32_t*) bptr, frame);
+						if (profiling)
+							m_profiler.stage(PROFILE_REDUCE);
+					}
+				}
+			} catch (Exception& e) {
+				// the frames of a lost connection cannot be recovered
+				DEB_ERROR() << "Acquisition aborted after " << m_cam.m_acq_frame_nb << " frames: " << e;
+				failed = true;
+				break;
+			}
+			// the statistics keep the -2 of the bad channels, see checkChannels()
+			const uint32_t* masked = reducing ? m_cam.m_bad_channels.mask((uint32_t*) bptr) : (uint32_t*) bptr;
+			m_cam.m_roi.compute(m_cam.m_acq_frame_nb, masked);
+			m_cam.m_rebin.compute(m_cam.m_acq_frame_nb, masked);
+			m_cam.m_peak_search.compute(m_cam.m_acq_frame_nb, masked);
+			m_cam.m_channel_binning.compute(m_cam.m_acq_frame_nb, masked);
+			if (channelStats) {
+				AutoMutex statsLock(m_cam.m_stats_mutex);
+				m_cam.m_channel_stats.compute((uint32_t*) bptr);
 			}
+			if (profiling)
+				m_profiler.stage(PROFILE_REDUCE);
+			if (m_cam.m_acq_frame_nb == 0) {
+				AutoMutex latencyLock(m_cam.m_cond.mutex());
+				m_cam.m_start_latency = Timestamp::now() - m_cam.m_start_timestamp;
+			}
+			m_cam.m_metrics.frameAcquired(m_cam.m_acq_frame_nb, frameBytes * subFrames, readoutNs, decodeNs);
 			HwFrameInfoType frame_info;
-			frame_info.acq_frame_nb = m_cam.m_acq_frame_nb;
+			frame_info.acq_frame_nb = static_cast<int>(m_cam.m_acq_frame_nb);
 			continueFlag = buffer_mgr.newFrameReady(frame_info);
-			DEB_TRACE() << "acqThread::threadFunction() newframe ready ";
+			if (profiling)
+				m_profiler.stage(PROFILE_PUBLISH);
+			DEB_HOT_TRACE() << "acqThread::threadFunction() newframe ready ";
 			++m_cam.m_acq_frame_nb;
-			DEB_TRACE() << "acquired " << m_cam.m_acq_frame_nb
+			DEB_HOT_TRACE() << "acquired " << m_cam.m_acq_frame_nb
 					<< " frames, required " << m_cam.m_nb_frames << " frames";
 			if (m_cam.m_wait_flag) {
 				m_cam.stop();
@@ -174,16 +350,48 @@ void Camera::AcqThread::threadFunction() {
 			}
 
 		}
+		try {
+			if (!m_cam.m_simulated) {
+				m_cam.m_mythen->setReadTimeout(0);
+				m_cam.m_mythen->unregisterBuffers();
+			}
+		} catch (Exception& e) {
+			DEB_WARNING() << "Readout timeout not cleared: " << e;
+		}
 		aLock.lock();
-		m_cam.m_wait_flag = true;
+		m_cam.m_acq_failed = failed;
+		if (m_cam.m_acq_frame_nb > 0)
+			m_cam.m_reads_per_frame = double(m_cam.m_readout_reads) / m_cam.m_acq_frame_nb;
+		if (profiling)
+			m_profiler.getResult(m_cam.m_profile);
+		if (!m_cam.m_start_pending)
+			m_cam.m_wait_flag = true;
 	}
 }
+
+/*
+ * Register the frame ring with the io_uring transport, if in use, so the
+ * frames are received without an intermediate copy.
+ */
+void Camera::AcqThread::registerFrameBuffers(StdBufferCbMgr& buffer_mgr) {
+	DEB_MEMBER_FUNCT();
+	if (!m_cam.m_mythen->getIoUring())
+		return;
+	FrameDim frame_dim;
+	buffer_mgr.getFrameDim(frame_dim);
+	std::vector<void*> buffers(m_cam.m_nb_buffers);
+	for (int i = 0; i < m_cam.m_nb_buffers; i++)
+		buffers[i] = buffer_mgr.getFrameBufferPtr(i);
+	m_cam.m_mythen->registerBuffers(&buffers[0], m_cam.m_nb_buffers, frame_dim.getMemSize());
+}
+
 extern int pthread_attr_setscope(pthread_attr_t *__attr, int __scope);
 
 Camera::AcqThread::AcqThread(Camera& cam) : m_cam(cam) {
 	AutoMutex aLock(m_cam.m_cond.mutex());
 	m_cam.m_wait_flag = true;
 	m_cam.m_quit = false;
+	m_cam.m_thread_running = false;
 	aLock.unlock();
 	pthread_attr_setscope(&m_thread_attr, PTHREAD_SCOPE_PROCESS);
 }
@@ -191,8 +399,10 @@ Camera::AcqThread::AcqThread(Camera& cam) : m_cam(cam) {
 Camera::AcqThread::~AcqThread() {
 	AutoMutex aLock(m_cam.m_cond.mutex());
 	m_cam.m_quit = true;
+	m_cam.m_wait_flag = true;
 	m_cam.m_cond.broadcast();
 	aLock.unlock();
+	join();
 }
 
 void Camera::getImageType(ImageType& type) {
@@ -238,26 +448,20 @@ void Camera::setTrigMode(TrigMode mode) {
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "Camera::setTrigMode() " << DEB_VAR1(mode);
 	m_trigger_mode = mode;
-	double exp_time;
-	getExpTime(exp_time);
 	if (m_trigger_mode == ExtGate) {
-		setGateMode(Camera::ON);
-		if (exp_time != 0) {
-			setExpTime(0);
-		}
+		setSyncParam(SYNC_GATEMODE, Camera::ON);
+		setSyncParam(SYNC_TIME, 0);
 	} else if (m_trigger_mode == ExtTrigMult) {
-		setContinuousTrigger(Camera::ON);
-		setTriggered(Camera::ON);
-		if (exp_time != 0) {
-			setExpTime(0);
-		}
+		setSyncParam(SYNC_CONTTRIG, Camera::ON);
+		setSyncParam(SYNC_TRIGGERED, Camera::ON);
+		setSyncParam(SYNC_TIME, 0);
 	} else if (m_trigger_mode == ExtTrigSingle) {
-		setContinuousTrigger(Camera::OFF);
-		setTriggered(Camera::ON);
+		setSyncParam(SYNC_CONTTRIG, Camera::OFF);
+		setSyncParam(SYNC_TRIGGERED, Camera::ON);
 	} else {
-		setContinuousTrigger(Camera::OFF);
-		setTriggered(Camera::OFF);
-		setGateMode(Camera::OFF);
+		setSyncParam(SYNC_CONTTRIG, Camera::OFF);
+		setSyncParam(SYNC_TRIGGERED, Camera::OFF);
+		setSyncParam(SYNC_GATEMODE, Camera::OFF);
 	}
 }
 
@@ -273,15 +477,16 @@ void Camera::getTrigMode(TrigMode& mode) {
 void Camera::getExpTime(double& exp_time) {
 	DEB_MEMBER_FUNCT();
 	long long time;
-	getTime(time);
+	if (!getCachedSyncParam(SYNC_TIME, time)) {
+		getTime(time);
+	}
 	exp_time = time / 10000000.0;
 }
 
 void Camera::setExpTime(double exp_time) {
 	DEB_MEMBER_FUNCT();
 	long long time = static_cast<long long>(exp_time * 10000000);
-	setTime(time);
-	m_exp_time = exp_time;
+	setSyncParam(SYNC_TIME, time);
 }
 
 void Camera::setLatTime(double lat_time) {
@@ -315,27 +520,53 @@ void Camera::getLatTimeRange(double& min_lat, double& max_lat) const {
 	DEB_RETURN() << DEB_VAR2(min_lat, max_lat);
 }
 
+/**
+ * Set the number of frames to acquire. A value of 0 selects continuous
+ * acquisition: the detector is programmed with the largest frame count and
+ * the frames are streamed through the buffer ring until stopAcq(), or until
+ * MaxAcqFrames frames since Lima numbers the frames with an int.
+ */
 void Camera::setNbFrames(int nb_frames) {
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "Camera::setNbFrames() " << DEB_VAR1(nb_frames);
-	if (m_nb_frames < 0) {
-		THROW_HW_ERROR(Error) << "Number of frames to acquire has not been set";
+	long long hw_frames = static_cast<long long>(nb_frames) * m_accumulator.getNbSubFrames();
+	if (nb_frames < 0 || hw_frames >= ContinuousHwFrames) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
 	}
-	setFrames(nb_frames);
+	setSyncParam(SYNC_FRAMES, nb_frames ? hw_frames : ContinuousHwFrames);
 	m_nb_frames = nb_frames;
 }
 
 void Camera::getNbFrames(int& nb_frames) {
 	DEB_MEMBER_FUNCT();
 	DEB_TRACE() << "Camera::getNbFrames";
-	getFrames(m_nb_frames);
+	long long frames;
+	if (!getCachedSyncParam(SYNC_FRAMES, frames)) {
+		int hw_frames;
+		getFrames(hw_frames);
+		frames = hw_frames;
+	}
+	m_nb_frames = (frames == ContinuousHwFrames) ? 0 : frames / m_accumulator.getNbSubFrames();
 	DEB_RETURN() << DEB_VAR1(m_nb_frames);
 	nb_frames = m_nb_frames;
 }
 
+/**
+ * Returns true from startAcq() until the acquisition thread has published
+ * the last frame, including while the start is still pending
+ */
 bool Camera::isAcqRunning() const {
 	AutoMutex aLock(m_cond.mutex());
-	return m_thread_running;
+	return m_thread_running || m_start_pending;
+}
+
+/**
+ * Returns true if the last acquisition was aborted by an error, for
+ * instance a connection lost while reading out the frames.
+ */
+bool Camera::isAcqFailed() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_acq_failed;
 }
 
 ///////////////////////////////
@@ -477,6 +708,7 @@ void Camera::getNbModules(int& nbModule) {
 void Camera::setNbModules(int nbModule) {
 	DEB_MEMBER_FUNCT();
 	requestSet(NMODULES, nbModule);
+	m_bad_channels_known = false;
 }
 
 /**
@@ -486,6 +718,7 @@ void Camera::setNbModules(int nbModule) {
 void Camera::getDelayAfterFrame(long long& time) {
 	DEB_MEMBER_FUNCT();
 	requestGet(DELAFTER, time);
+	syncUpdated(SYNC_DELAFTER, time, false);
 }
 /**
  * Sets the delay between two subsequent frames.
@@ -494,6 +727,7 @@ void Camera::getDelayAfterFrame(long long& time) {
 void Camera::setDelayAfterFrame(long long time) {
 	DEB_MEMBER_FUNCT();
 	requestSet(DELAFTER, time);
+	syncUpdated(SYNC_DELAFTER, time, true);
 }
 
 /**
@@ -503,6 +737,7 @@ void Camera::setDelayAfterFrame(long long time) {
 void Camera::getFrames(int& frames) {
 	DEB_MEMBER_FUNCT();
 	requestGet(FRAMES, frames);
+	syncUpdated(SYNC_FRAMES, frames, false);
 }
 
 /**
@@ -512,6 +747,7 @@ void Camera::getFrames(int& frames) {
 void Camera::setFrames(int frames) {
 	DEB_MEMBER_FUNCT();
 	requestSet(FRAMES, frames);
+	syncUpdated(SYNC_FRAMES, frames, true);
 }
 
 /**
@@ -523,6 +759,8 @@ void Camera::getNbits(Nbits& nbits) {
 	int bits;
 	requestGet(NBITS, bits);
 	nbits = static_cast<Nbits>(bits);
+	m_nbits = nbits;
+	m_nbits_cached = true;
 }
 
 /**
@@ -533,6 +771,8 @@ void Camera::getNbits(Nbits& nbits) {
 void Camera::setNbits(Nbits nbits) {
 	DEB_MEMBER_FUNCT();
 	requestSet(NBITS, static_cast<int>(nbits));
+	m_nbits = nbits;
+	m_nbits_cached = true;
 }
 
 /**
@@ -542,6 +782,7 @@ void Camera::setNbits(Nbits nbits) {
 void Camera::getTime(long long& time) {
 	DEB_MEMBER_FUNCT();
 	requestGet(TIME, time);
+	syncUpdated(SYNC_TIME, time, false);
 }
 
 /**
@@ -551,6 +792,7 @@ void Camera::getTime(long long& time) {
 void Camera::setTime(long long time) {
 	DEB_MEMBER_FUNCT();
 	requestSet(TIME, time);
+	syncUpdated(SYNC_TIME, time, true);
 }
 
 /**
@@ -698,6 +940,7 @@ void Camera::getBadChannelInterpolation(Switch& enable) {
 void Camera::setBadChannelInterpolation(Switch enable) {
 	DEB_MEMBER_FUNCT();
 	requestSet(BADCHANNELINTERPOLATION, enable);
+	m_bad_channels_known = false;
 }
 
 /**
@@ -801,6 +1044,7 @@ void Camera::setTau(float tau) {
 void Camera::getGates(int& gates) {
 	DEB_MEMBER_FUNCT();
 	requestGet(GATES, gates);
+	syncUpdated(SYNC_GATES, gates, false);
 }
 
 /*
@@ -810,6 +1054,7 @@ void Camera::getGates(int& gates) {
 void Camera::setGates(int gates) {
 	DEB_MEMBER_FUNCT();
 	requestSet(GATES, gates);
+	syncUpdated(SYNC_GATES, gates, true);
 }
 
 /**
@@ -819,6 +1064,7 @@ void Camera::setGates(int gates) {
 void Camera::getDelayBeforeFrame(long long& time) {
 	DEB_MEMBER_FUNCT();
 	requestGet(DELBEF, time);
+	syncUpdated(SYNC_DELBEF, time, false);
 }
 
 /**
@@ -829,6 +1075,7 @@ void Camera::getDelayBeforeFrame(long long& time) {
 void Camera::setDelayBeforeFrame(long long time) {
 	DEB_MEMBER_FUNCT();
 	requestSet(DELBEF, time);
+	syncUpdated(SYNC_DELBEF, time, true);
 }
 
 /**
@@ -840,6 +1087,7 @@ void Camera::getContinuousTrigger(Switch& enable) {
 	int trig;
 	requestGet(CONTTRIG, trig);
 	enable = static_cast<Switch>(trig);
+	syncUpdated(SYNC_CONTTRIG, trig, false);
 }
 
 /**
@@ -850,6 +1098,7 @@ void Camera::getContinuousTrigger(Switch& enable) {
 void Camera::setContinuousTrigger(Switch enable) {
 	DEB_MEMBER_FUNCT();
 	requestSet(CONTTRIGEN, enable);
+	syncUpdated(SYNC_CONTTRIG, enable, true);
 }
 
 /**
@@ -861,6 +1110,7 @@ void Camera::getGateMode(Switch& enable) {
 	int gate;
 	requestGet(GATE, gate);
 	enable = static_cast<Switch>(gate);
+	syncUpdated(SYNC_GATEMODE, gate, false);
 }
 
 /**
@@ -870,6 +1120,7 @@ void Camera::getGateMode(Switch& enable) {
 void Camera::setGateMode(Switch enable) {
 	DEB_MEMBER_FUNCT();
 	requestSet(GATEEN, enable);
+	syncUpdated(SYNC_GATEMODE, enable, true);
 }
 
 /**
@@ -881,6 +1132,7 @@ void Camera::getTriggered(Switch& enable) {
 	int trig;
 	requestGet(TRIG, trig);
 	enable = static_cast<Switch>(trig);
+	syncUpdated(SYNC_TRIGGERED, trig, false);
 }
 
 /**
@@ -891,6 +1143,7 @@ void Camera::getTriggered(Switch& enable) {
 void Camera::setTriggered(Switch enable) {
 	DEB_MEMBER_FUNCT();
 	requestSet(TRIGEN, enable);
+	syncUpdated(SYNC_TRIGGERED, enable, true);
 }
 
 /**
@@ -976,6 +1229,10 @@ void Camera::getTestPattern(Data& testData) {
 void Camera::resetMythen() {
 	DEB_MEMBER_FUNCT();
 	requestCmd(RESET);
+	clearConfigSnapshot();
+	m_sync_known = 0;
+	m_nbits_cached = false;
+	m_bad_channels_known = false;
 }
 
 /**
@@ -1025,263 +1282,1860 @@ void Camera::logRead() {
 	delete[] buff;
 }
 
+/*
+ * The buffers of the ring seen by a view. Until the view is released or the
+ * acquisition thread reuses one of its buffers, the data points into the
+ * ring; the frames are then copied to the heap and the data repointed.
+ */
+class Camera::FrameView : public Buffer::Callback {
+public:
+	FrameView(Camera& cam, Buffer* buffer, int index, int nb_frames, int frame_size) :
+			m_cam(cam), m_buffer(buffer), m_index(index), m_nb_frames(nb_frames),
+			m_frame_size(frame_size), m_detached(false) {
+	}
+	virtual void destroy(void* data) {
+		if (!m_cam.releaseFrames(this))
+			free(data);
+		delete this;
+	}
+
+	Camera& m_cam;
+	Buffer* m_buffer;
+	int m_index;
+	int m_nb_frames;
+	int m_frame_size;
+	bool m_detached; // frames copied out of the ring
+};
+
 /**
- * Returns the data of the specified frame in the buffer.
+ * Returns a view of the specified frame in the buffer ring, without a copy.
+ * Only the frames still held in the ring (the last nb_buffers acquired) are
+ * available. A view held when the acquisition thread is about to reuse its
+ * buffer, or when the next acquisition is prepared, is first copied out of
+ * the ring: release views early to keep reads free of copies. The address
+ * of the data moves with the copy, so it is not to be kept apart from the
+ * Data. Views must be released before the number of buffers or the frame
+ * dimensions change.
  * @param[out] mythenData the frame data
  * @param[in] frame_nb the number of the frame
  */
 void Camera::readFrame(Data& mythenData, int frame_nb) {
 	DEB_MEMBER_FUNCT();
-	HwFrameInfo frame_info;
-	if (frame_nb >= m_acq_frame_nb) {
-		THROW_HW_ERROR(Error) << "Frame not available yet";
-	} else {
-		StdBufferCbMgr& buffer_mgr = m_bufferCtrlObj.getBuffer();
-		buffer_mgr.getFrameInfo(frame_nb, frame_info);
-		Size size = frame_info.frame_dim.getSize();
-		int width = size.getWidth();
-
-		mythenData.type = Data::UINT32;
-		mythenData.dimensions.push_back(width);
-		mythenData.frameNumber = frame_nb;
-
-		Buffer *buffer = new Buffer(width * sizeof(Data::UINT32));
-		memcpy(buffer->data, frame_info.frame_ptr,
-				width * sizeof(Data::UINT32));
-		mythenData.setBuffer(buffer);
-		buffer->unref();
+	readFrames(mythenData, frame_nb, 1);
+	if (mythenData.dimensions[1] != 1) {
+		THROW_HW_ERROR(Error) << "Frame " << frame_nb << " not viewed";
 	}
+	mythenData.dimensions.pop_back();
 }
 
 /**
- * Returns all frames of data acquired.
- * @param[out] mythenData the frame data
+ * Returns a view of up to max_frames consecutive frames from first in the
+ * buffer ring, without a copy. The view stops at the last frame acquired
+ * and where the ring buffers are not contiguous, at the end of the ring at
+ * the latest. The views behave as those of readFrame().
+ * @param[out] mythenData the frames, of dimensions width x frames
+ * @param[in] first the number of the first frame
+ * @param[in] max_frames the most frames to view
  */
-void Camera::readData(Data& mythenData) {
+void Camera::readFrames(Data& mythenData, int first, int max_frames) {
 	DEB_MEMBER_FUNCT();
-	HwFrameInfo frame_info;
-
 	StdBufferCbMgr& buffer_mgr = m_bufferCtrlObj.getBuffer();
-	Size size = frame_info.frame_dim.getSize();
-	int width = size.getWidth();
-	Buffer *buffer = new Buffer(m_acq_frame_nb * width * sizeof(Data::UINT32));
+	FrameDim frame_dim;
+	m_bufferCtrlObj.getFrameDim(frame_dim);
+	int width = frame_dim.getSize().getWidth();
+	int frameSize = width * sizeof(Data::UINT32);
+
+	AutoMutex aLock(m_cond.mutex());
+	if (first >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (first < getOldestFrameNb()) {
+		THROW_HW_ERROR(Error) << "Frame " << first << " overwritten in the buffer ring";
+	}
+	int index = getRingIndex(first);
+	int nb_frames = static_cast<int>(min<long long>(max_frames, m_acq_frame_nb - first));
+	nb_frames = min(nb_frames, m_nb_buffers - index);
+	char* ptr = static_cast<char*>(buffer_mgr.getFrameBufferPtr(index));
+	for (int i = 1; i < nb_frames; i++) {
+		if (buffer_mgr.getFrameBufferPtr(index + i) != ptr + i * frameSize) {
+			nb_frames = i;
+			break;
+		}
+	}
+	Buffer* buffer = new Buffer();
+	buffer->owner = Buffer::MAPPED;
+	buffer->data = ptr;
+	FrameView* view = new FrameView(*this, buffer, index, nb_frames, frameSize);
+	buffer->callback = view;
+	if (static_cast<int>(m_frame_pins.size()) < m_nb_buffers)
+		m_frame_pins.resize(m_nb_buffers, 0);
+	for (int i = 0; i < nb_frames; i++)
+		m_frame_pins[index + i]++;
+	m_frame_views.push_back(view);
+	m_metrics.framesRead(first + nb_frames - 1);
+	aLock.unlock();
 
 	mythenData.type = Data::UINT32;
+	mythenData.dimensions.clear();
 	mythenData.dimensions.push_back(width);
-	mythenData.dimensions.push_back(m_acq_frame_nb);
-	mythenData.frameNumber = 1;
-
-	uint32_t* bptr = (uint32_t*) buffer->data;
-	for (int i = 0; i < m_acq_frame_nb; i++, bptr += width) {
-		buffer_mgr.getFrameInfo(i, frame_info);
-		memcpy(bptr, frame_info.frame_ptr, width * sizeof(Data::UINT32));
-	}
+	mythenData.dimensions.push_back(nb_frames);
+	mythenData.frameNumber = first;
 	mythenData.setBuffer(buffer);
 	buffer->unref();
 }
 
-///////////////////////
-// private methods
-///////////////////////
+/**
+ * Iterates over the acquired frames from first, each chunk a view of up to
+ * chunk_frames frames in the buffer ring.
+ * @param[in] cam the camera acquiring the frames
+ * @param[in] first the number of the first frame
+ * @param[in] chunk_frames the most frames per chunk
+ */
+Camera::FrameReader::FrameReader(Camera& cam, int first, int chunk_frames) :
+		m_cam(cam), m_next(first), m_chunk_frames(chunk_frames) {
+}
 
-/*
- * Returns the data of the oldest frame in the buffer (i.e. the frames are
- * returned in the same order as they were acquired. The Mythen can internally
- * buffer the last four acquired frames.  If the buffer is empty and there is
- * an ongoing measurement, the command returns the data after the measurement
- * has finished. If the readout fails all count are set to -1.
- * @param[out] data an array containing the frame data
- * @param[in] len the size of the array = [nbModules*npixels].
+/**
+ * Views the next chunk of the frames acquired so far. Releasing the
+ * previous chunk before asking for the next one lets the acquisition
+ * thread reuse its buffers.
+ * @param[out] chunk the frames, of dimensions width x frames
+ * @return false if no frame was acquired since the last chunk
  */
-void Camera::readout(uint32_t* data, int len) {
-	DEB_MEMBER_FUNCT();
-	requestCmd(READOUT, data, len);
+bool Camera::FrameReader::next(Data& chunk) {
+	chunk.releaseBuffer();
+	if (m_next >= m_cam.getNbHwAcquiredFrames())
+		return false;
+	m_cam.readFrames(chunk, m_next, m_chunk_frames);
+	m_next += chunk.dimensions[1];
+	return true;
+}
+
+/**
+ * @return the number of the first frame of the next chunk
+ */
+int Camera::FrameReader::getNextFrameNb() const {
+	return m_next;
 }
 
 /*
- * Returns the data of the oldest frame in the buffer in a raw compressed format.
- * The Mythen does not apply any correction to the data , thereby allowing for
- * maximal frame rates.
- * @param[out] data an array containing the raw data
- * @param[in] len the size of the array = [nbModules*nBits].
+ * Forget a view whose last reference was released. Returns false if its
+ * frames had been detached, the copy is then to be freed by the caller.
  */
-void Camera::readoutRaw(uint32_t* data, int len) {
-	DEB_MEMBER_FUNCT();
-	requestCmd(READOUTRAW, data, len);
+bool Camera::releaseFrames(FrameView* view) {
+	AutoMutex aLock(m_cond.mutex());
+	if (view->m_detached)
+		return false;
+	for (int i = 0; i < view->m_nb_frames; i++)
+		m_frame_pins[view->m_index + i]--;
+	m_frame_views.erase(find(m_frame_views.begin(), m_frame_views.end(), view));
+	return true;
 }
 
 /*
- * Decode the raw data buffer in-place.
- * @param[in] nbits number of bits read out
- * @param[in] width the image width = [nbModules*PixelsPerModule]
- * @param[out] buff packed data array in decoded array out
+ * Copy out of the ring the views held on the buffer at index, or on any
+ * buffer if index is negative, before the buffer is reused.
  */
-void Camera::decodeRaw(Nbits nbits, uint32_t* buff, int width) {
-	int chansPerPoint = CHAR_BIT * sizeof(int) / nbits;
-	uint32_t mask = 0xffffffff >> ((nbits * (chansPerPoint - 1)));
-	int size = width / chansPerPoint;
-	uint32_t *bptr = buff + width - 1;
-	uint32_t *iptr = buff + size - 1;
-	for (int j = size - 1; j >= 0; j--, iptr--) {
-		for (int i = chansPerPoint - 1; i >= 0; i--) {
-			uint32_t shift = nbits * i;
-			uint32_t shiftmask = mask << shift;
-			*bptr-- = ((*iptr & shiftmask) >> shift) & mask;
+void Camera::detachFrames(int index) {
+	AutoMutex aLock(m_cond.mutex());
+	if (index >= static_cast<int>(m_frame_pins.size()) || (index >= 0 && m_frame_pins[index] == 0))
+		return;
+	DEB_MEMBER_FUNCT();
+	for (size_t v = 0; v < m_frame_views.size();) {
+		FrameView* view = m_frame_views[v];
+		if (index >= 0 && (index < view->m_index || index >= view->m_index + view->m_nb_frames)) {
+			v++;
+			continue;
+		}
+		int size = view->m_nb_frames * view->m_frame_size;
+		void* copy = malloc(size);
+		if (!copy) {
+			THROW_HW_ERROR(Error) << "Cannot allocate the copy of a frame view";
 		}
+		memcpy(copy, view->m_buffer->data, size);
+		view->m_buffer->data = copy;
+		view->m_detached = true;
+		for (int i = 0; i < view->m_nb_frames; i++)
+			m_frame_pins[view->m_index + i]--;
+		m_frame_views[v] = m_frame_views.back();
+		m_frame_views.pop_back();
+		m_metrics.viewDetached();
 	}
 }
 
-template<typename T>
-void Camera::checkReply(T rc) {
+/**
+ * Returns all frames of data still held in the buffer ring. In continuous
+ * mode these are the last nb_buffers frames; frameNumber is the first one.
+ * The frames are copied into one buffer: use a FrameReader to walk a long
+ * acquisition without a copy.
+ * @param[out] mythenData the frame data
+ */
+void Camera::readData(Data& mythenData) {
 	DEB_MEMBER_FUNCT();
-	int irc = *((unsigned int *) &rc);
-	if (irc < 0) {
-		THROW_HW_ERROR(Error) << serverStatusMap[irc];
-	}
-}
+	FrameDim frame_dim;
+	m_bufferCtrlObj.getFrameDim(frame_dim);
+	int width = frame_dim.getSize().getWidth();
 
-string Camera::findCmd(Action action, ServerCmd cmd) {
-	DEB_MEMBER_FUNCT();
-	stringstream ss;
-	map<ServerCmd, std::string>::iterator it;
-	if ((it = serverCmdMap.find(cmd)) != serverCmdMap.end()) {
-		string cmdStr = it->second;
-		if (action == Camera::GET) {
-			ss << "-get " << cmdStr;
-		} else {
-			ss << "-" << cmdStr;
+	AutoMutex aLock(m_cond.mutex());
+	long long last = m_acq_frame_nb;
+	long long first = getOldestFrameNb();
+	aLock.unlock();
+	int nb_frames = static_cast<int>(last - first);
+	Buffer *buffer = new Buffer(nb_frames * width * sizeof(Data::UINT32));
+	uint32_t* bptr = (uint32_t*) buffer->data;
+	int copied = 0;
+	long long next = first;
+	Data chunk;
+	while (next < last) {
+		try {
+			readFrames(chunk, static_cast<int>(next), static_cast<int>(last - next));
+		} catch (Exception& e) {
+			// the frames overwritten before they were viewed are dropped
+			aLock.lock();
+			long long oldest = getOldestFrameNb();
+			aLock.unlock();
+			if (oldest <= next)
+				throw;
+			first = next = min(oldest, last);
+			copied = 0;
+			continue;
 		}
-	} else {
-		THROW_HW_ERROR(Error) << "Not a 'server cmd'  command";
+		int frames = chunk.dimensions[1];
+		memcpy(bptr + copied * width, chunk.data(), frames * width * sizeof(Data::UINT32));
+		copied += frames;
+		next += frames;
 	}
-	return ss.str();
+	chunk.releaseBuffer();
+
+	mythenData.frameNumber = static_cast<int>(first);
+	mythenData.type = Data::UINT32;
+	mythenData.dimensions.clear();
+	mythenData.dimensions.push_back(width);
+	mythenData.dimensions.push_back(copied);
+	mythenData.setBuffer(buffer);
+	buffer->unref();
 }
 
-void Camera::requestCmd(ServerCmd cmd) {
+/**
+ * Enable or disable the scan mode used for step scans with many short
+ * points. In scan mode the configuration cached by this object (number of
+ * bits, exposure time, number of frames) is trusted and read back without
+ * network requests. No other client must modify the detector configuration
+ * while scan mode is enabled.
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setScanMode(Switch enable) {
 	DEB_MEMBER_FUNCT();
-	sendCmd(Camera::CMD, cmd);
+	m_scan_mode = static_cast<bool>(enable);
 }
 
-template<typename T>
-void Camera::requestCmd(ServerCmd cmd, T* value, int len) {
+/**
+ * Returns whether the scan mode is enabled
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getScanMode(Switch& enable) {
 	DEB_MEMBER_FUNCT();
-	uint8_t* buff;
-	buff = reinterpret_cast<uint8_t*>(value);
-	sendCmd(Camera::CMD, cmd, buff, len * sizeof(T));
+	enable = static_cast<Switch>(m_scan_mode);
 }
 
-template<typename T>
-void Camera::requestSet(ServerCmd cmd, T value) {
+/**
+ * Returns the latency between startAcq() and the reception of the first
+ * frame of the last acquisition, or -1 if no frame was received yet.
+ * @param[out] latency the latency in seconds
+ */
+void Camera::getStartLatency(double& latency) {
 	DEB_MEMBER_FUNCT();
-	sendCmd(Camera::SET, cmd, value);
+	AutoMutex aLock(m_cond.mutex());
+	latency = m_start_latency;
 }
-template<typename T>
-void Camera::requestSet(ServerCmd cmd, T value1, T value2) {
+
+/**
+ * Apply a complete acquisition configuration. The settings are sent as one
+ * batch, see setCmdPipelining(). The frames are those of the detector, the
+ * sub-frames when accumulating.
+ * @param[in] config the {@see AcqConfig} to apply
+ */
+void Camera::setAcqConfig(const AcqConfig& config) {
 	DEB_MEMBER_FUNCT();
-	sendCmd(Camera::SET, cmd, value1, value2);
+	if (config.frames < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(config.frames);
+	}
+	BatchCmd batch[MaxBatchCmds];
+	int nb = 0;
+	batchSet(batch, nb, TRIGEN, static_cast<int>(config.triggered));
+	batchSet(batch, nb, CONTTRIGEN, static_cast<int>(config.continuousTrigger));
+	batchSet(batch, nb, GATEEN, static_cast<int>(config.gateMode));
+	batchSet(batch, nb, GATES, config.gates);
+	batchSet(batch, nb, DELBEF, config.delayBefore);
+	batchSet(batch, nb, DELAFTER, config.delayAfter);
+	batchSet(batch, nb, TIME, config.time);
+	batchSet(batch, nb, FRAMES, config.frames ? config.frames : ContinuousHwFrames);
+	batchSet(batch, nb, NBITS, static_cast<int>(config.nbits));
+	sendBatch(batch, nb);
+	syncUpdated(config, true);
+	m_nb_frames = config.frames / m_accumulator.getNbSubFrames();
+	m_nbits = config.nbits;
+	m_nbits_cached = true;
+}
+
+/**
+ * Read back the acquisition configuration in one batch, see setCmdPipelining().
+ * @param[out] config the current {@see AcqConfig}
+ */
+void Camera::getAcqConfig(AcqConfig& config) {
+	DEB_MEMBER_FUNCT();
+	BatchCmd batch[MaxBatchCmds];
+	int nb = 0;
+	int triggered, continuousTrigger, gateMode, nbits;
+	batchGet(batch, nb, TRIG, triggered);
+	batchGet(batch, nb, CONTTRIG, continuousTrigger);
+	batchGet(batch, nb, GATE, gateMode);
+	batchGet(batch, nb, GATES, config.gates);
+	batchGet(batch, nb, DELBEF, config.delayBefore);
+	batchGet(batch, nb, DELAFTER, config.delayAfter);
+	batchGet(batch, nb, TIME, config.time);
+	batchGet(batch, nb, FRAMES, config.frames);
+	batchGet(batch, nb, NBITS, nbits);
+	sendBatch(batch, nb);
+	config.triggered = static_cast<Switch>(triggered);
+	config.continuousTrigger = static_cast<Switch>(continuousTrigger);
+	config.gateMode = static_cast<Switch>(gateMode);
+	config.nbits = static_cast<Nbits>(nbits);
+	if (config.frames == ContinuousHwFrames)
+		config.frames = 0;
+	syncUpdated(config, false);
+	m_nb_frames = config.frames / m_accumulator.getNbSubFrames();
+	m_nbits = config.nbits;
+	m_nbits_cached = true;
+}
+
+/**
+ * Enable or disable command pipelining. When enabled, the commands of a
+ * batch (setAcqConfig(), getAcqConfig(), setTrigMode()) are written back to
+ * back and the replies collected afterwards, so that a batch costs one
+ * round trip instead of one per command. The socket protocol has no command
+ * delimiter and the MYTHEN socket server is not documented to separate
+ * several commands arriving in one segment, so pipelining must only be
+ * enabled with a server known to do so. Disabled by default and not exposed
+ * to Tango.
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setCmdPipelining(Switch enable) {
+	DEB_MEMBER_FUNCT();
+	m_cmd_pipelining = static_cast<bool>(enable);
+	if (!m_simulated) {
+		m_mythen->setPipelining(m_cmd_pipelining);
+	}
 }
 
-template<typename T>
-void Camera::requestGet(ServerCmd cmd, T& value) {
+/**
+ * Returns whether command pipelining is enabled
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getCmdPipelining(Switch& enable) {
 	DEB_MEMBER_FUNCT();
-	uint8_t* recvBuf;
-	recvBuf = reinterpret_cast<uint8_t*>(&value);
-	sendCmd(Camera::GET, cmd, recvBuf, sizeof(T));
+	enable = static_cast<Switch>(m_cmd_pipelining);
 }
 
-void Camera::requestGet(ServerCmd cmd, string& reply, int len) {
+/**
+ * Enable or disable the automatic reconnection. When enabled, a lost
+ * connection is re-established with an exponential backoff and the settings
+ * changed since the last reset are sent again. The acquisition running when
+ * the connection was lost fails, see isAcqFailed(). Enabled by default.
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setAutoReconnect(Switch enable) {
 	DEB_MEMBER_FUNCT();
-	uint8_t buff[64];
-	sendCmd(Camera::GET, cmd, buff, len);
-	stringstream os;
-	os << buff;
-	reply = os.str();
+	AutoMutex aLock(m_recover_mutex);
+	m_auto_reconnect = static_cast<bool>(enable);
 }
 
-template<typename T>
-void Camera::requestGet(ServerCmd cmd, T* value, int len) {
+/**
+ * Returns whether the automatic reconnection is enabled
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getAutoReconnect(Switch& enable) {
 	DEB_MEMBER_FUNCT();
-	uint8_t* buff;
-	buff = reinterpret_cast<uint8_t*>(value);
-	sendCmd(Camera::GET, cmd, buff, len * max(sizeof(uint32_t), sizeof(T)));
+	AutoMutex aLock(m_recover_mutex);
+	enable = static_cast<Switch>(m_auto_reconnect);
 }
 
-void Camera::sendCmd(Action action, ServerCmd cmd) {
+/**
+ * Record the traffic with the detector (commands, replies and timing) to
+ * a file until stopRecording(). A camera created with the hostname
+ * "replay:<fileName>" is fed from such a recording instead of a detector.
+ * @param[in] fileName the recording file
+ */
+void Camera::startRecording(const std::string& fileName) {
 	DEB_MEMBER_FUNCT();
-	int rc;
-	uint8_t *buff = reinterpret_cast<uint8_t*>(&rc);
 	if (m_simulated) {
-		simulate(action, cmd, buff, sizeof(int));
-	} else {
-		stringstream ss;
-		ss << findCmd(action, cmd);
-		buff = reinterpret_cast<uint8_t*>(&rc);
-		m_mythen->sendCmd(ss.str(), buff, sizeof(int));
-		checkReply(rc);
+		THROW_HW_ERROR(NotSupported) << "No traffic to record in simulation";
 	}
+	m_mythen->startRecording(fileName);
 }
 
-template<typename T>
-void Camera::sendCmd(Action action, ServerCmd cmd, T value) {
+/**
+ * Stop the traffic recording started by startRecording()
+ */
+void Camera::stopRecording() {
 	DEB_MEMBER_FUNCT();
-	int rc;
-	uint8_t *buff;
-	if (m_simulated) {
-		simulate(action, cmd, reinterpret_cast<uint8_t*>(&value), sizeof(T));
-	} else {
-		stringstream ss;
-		ss << findCmd(action, cmd) << " " << value;
-		buff = reinterpret_cast<uint8_t*>(&rc);
-		m_mythen->sendCmd(ss.str(), buff, sizeof(int));
-		checkReply(rc);
+	if (!m_simulated) {
+		m_mythen->stopRecording();
 	}
 }
 
-template<typename T>
-void Camera::sendCmd(Action action, ServerCmd cmd, T value1, T value2) {
+/**
+ * Set the speed of a camera fed from a recording: 1 reproduces the recorded
+ * reply delays, 2 halves them and 0 replies without delay.
+ * @param[in] speed the time scale
+ */
+void Camera::setReplaySpeed(double speed) {
 	DEB_MEMBER_FUNCT();
-	int rc;
-	uint8_t *buff;
+	DEB_PARAM() << DEB_VAR1(speed);
 	if (m_simulated) {
-		int size = sizeof(T);
-		uint8_t values[2*size];
-		memcpy(values, &value1, size);
-		memcpy((values+size), &value2, size);
-		simulate(action, cmd, values, size*2);
-	} else {
-		stringstream ss;
-		ss << findCmd(action, cmd) << " " << value1 << " " << value2;
-		buff = reinterpret_cast<uint8_t*>(&rc);
-		m_mythen->sendCmd(ss.str(), buff, sizeof(int));
-		checkReply(rc);
+		THROW_HW_ERROR(NotSupported) << "No replay in simulation";
 	}
+	m_mythen->setReplaySpeed(speed);
 }
 
-void Camera::sendCmd(Action action, ServerCmd cmd, uint8_t* buff, int len) {
+/**
+ * Set the socket receive buffer size (SO_RCVBUF), 0 for the system default.
+ * The connection to the detector is re-established to apply it, which is
+ * refused during an acquisition.
+ * @param[in] size the size in bytes
+ */
+void Camera::setRecvBufferSize(int size) {
 	DEB_MEMBER_FUNCT();
-	int rc;
-	if (m_simulated) {
-		simulate(action, cmd, buff, len);
-	} else {
-		stringstream ss;
-		ss << findCmd(action, cmd);
-		if (action == Camera::SET) {
-			ss << " " << buff;
-		}
-		m_mythen->sendCmd(ss.str(), buff, len);
-		rc = *((uint32_t *) buff);
-		checkReply(rc);
+	if (isAcqRunning()) {
+		THROW_HW_ERROR(Error) << "Cannot change the receive buffer size during an acquisition";
 	}
+	if (!m_simulated)
+		m_mythen->setRecvBufferSize(size);
 }
 
-#if __GNUC_MINOR__ < 4
-typedef pair<int, string> StatusPair;
-static const StatusPair serverStatusList[] = {
-    StatusPair(  0, "Success"),
-    StatusPair( -1, "Unknown command"),
-    StatusPair( -2, "Invalid argument"),
-    StatusPair( -3, "Unknown settings"),
-    StatusPair( -4, "Out of memory"),
+/**
+ * Returns the requested socket receive buffer size
+ * @param[out] size the size in bytes, 0 for the system default
+ */
+void Camera::getRecvBufferSize(int& size) {
+	DEB_MEMBER_FUNCT();
+	size = m_simulated ? 0 : m_mythen->getRecvBufferSize();
+}
+
+/**
+ * Acknowledge the replies at once (TCP_QUICKACK) rather than delaying the
+ * acknowledgements. Costs one system call per reply.
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setQuickAck(Switch enable) {
+	DEB_MEMBER_FUNCT();
+	if (!m_simulated)
+		m_mythen->setQuickAck(static_cast<bool>(enable));
+}
+
+/**
+ * Returns whether the replies are acknowledged at once
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getQuickAck(Switch& enable) {
+	DEB_MEMBER_FUNCT();
+	enable = static_cast<Switch>(!m_simulated && m_mythen->getQuickAck());
+}
+
+/**
+ * Busy poll the network device when reading (SO_BUSY_POLL), 0 to disable.
+ * Values above the system setting require CAP_NET_ADMIN.
+ * @param[in] usecs the busy poll time in us
+ */
+void Camera::setBusyPoll(int usecs) {
+	DEB_MEMBER_FUNCT();
+	if (!m_simulated)
+		m_mythen->setBusyPoll(usecs);
+}
+
+/**
+ * Returns the busy poll time
+ * @param[out] usecs the busy poll time in us, 0 if disabled
+ */
+void Camera::getBusyPoll(int& usecs) {
+	DEB_MEMBER_FUNCT();
+	usecs = m_simulated ? 0 : m_mythen->getBusyPoll();
+}
+
+/**
+ * Returns the average number of receive system calls per frame read out in
+ * the last acquisition, to tune the socket options above.
+ * @param[out] reads the number of recv() or io_uring_enter() calls per frame
+ */
+void Camera::getReadsPerFrame(double& reads) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	reads = m_reads_per_frame;
+}
+
+/**
+ * Exchange the commands with the detector over io_uring: the command, the
+ * reply status and the frame data are chained in a single submission, and
+ * the frames are received straight into the registered Lima buffers. Falls
+ * back to the socket calls when the kernel does not support it (Linux 5.18
+ * or later is needed).
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setIoUring(Switch enable) {
+	DEB_MEMBER_FUNCT();
+	if (isAcqRunning()) {
+		THROW_HW_ERROR(Error) << "Cannot change the transport during an acquisition";
+	}
+	if (!m_simulated)
+		m_mythen->setIoUring(static_cast<bool>(enable));
+}
+
+/**
+ * Returns whether io_uring is in use
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getIoUring(Switch& enable) {
+	DEB_MEMBER_FUNCT();
+	enable = static_cast<Switch>(!m_simulated && m_mythen->getIoUring());
+}
+
+/**
+ * Returns the counters of the exchanges with the socket server since the
+ * camera was created or resetStatistics(), for each command sent at least
+ * once. The latency of a command sent in a batch runs from the write of the
+ * batch. Error replies with an undocumented status code are only counted in
+ * errors.
+ * @param[out] stats the counters of each command
+ */
+void Camera::getStatistics(std::vector<CmdStatistics>& stats) {
+	DEB_MEMBER_FUNCT();
+	stats.clear();
+	for (int cmd = 0; cmd < NB_SERVER_CMDS; cmd++) {
+		Mythen3Statistics::Summary summary;
+		m_cmd_stats.getSummary(cmd, summary);
+		if (summary.count == 0 && summary.failures == 0)
+			continue;
+		CmdStatistics cmdStats;
+		cmdStats.name = serverCmdNames[cmd];
+		cmdStats.count = summary.count;
+		cmdStats.bytes = summary.bytes;
+		cmdStats.errors = summary.errors;
+		cmdStats.failures = summary.failures;
+		cmdStats.p50 = summary.p50 * 1e-9;
+		cmdStats.p99 = summary.p99 * 1e-9;
+		cmdStats.max = summary.max * 1e-9;
+		for (int code = 1; code < NbStatusCodes; code++) {
+			if (summary.errorCodes[code] > 0) {
+				cmdStats.errorCodes.push_back(-code);
+				cmdStats.errorCounts.push_back(static_cast<int>(summary.errorCodes[code]));
+			}
+		}
+		stats.push_back(cmdStats);
+	}
+}
+
+/**
+ * Clear the counters of getStatistics()
+ */
+void Camera::resetStatistics() {
+	DEB_MEMBER_FUNCT();
+	m_cmd_stats.reset();
+}
+
+/**
+ * Returns the acquisition pipeline metrics in the Prometheus text format,
+ * see Mythen3Metrics. The rates cover the time since the previous call or
+ * export.
+ * @param[out] text the metrics
+ */
+void Camera::getMetrics(std::string& text) {
+	DEB_MEMBER_FUNCT();
+	m_metrics.formatText(text);
+}
+
+/**
+ * Export the metrics of getMetrics() until stopMetricsExport(): written to
+ * the file target every period, or served on the Unix socket of a target
+ * starting with "unix:". No other service is needed, the node exporter can
+ * scrape either.
+ * @param[in] target the file name or "unix:" followed by the socket path
+ * @param[in] period the time between two writes of the file (s)
+ */
+void Camera::startMetricsExport(const std::string& target, double period) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(target, period);
+	AutoMutex aLock(m_metrics_mutex);
+	delete m_metrics_exporter;
+	m_metrics_exporter = 0;
+	m_metrics_exporter = new Mythen3MetricsExporter(m_metrics, target, period);
+}
+
+/**
+ * Stop the export started by startMetricsExport()
+ */
+void Camera::stopMetricsExport() {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_metrics_mutex);
+	delete m_metrics_exporter;
+	m_metrics_exporter = 0;
+}
+
+/**
+ * Count instructions, cycles, cache misses and branch misses of the
+ * acquisition thread around the readout, decode and publish stages of each
+ * frame, see Mythen3Profiler. Costs 3 or 4 system calls per frame; applies
+ * from the next acquisition.
+ * @param[in] enable {@see Switch}
+ */
+void Camera::setProfiling(Switch enable) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_profiling = static_cast<bool>(enable);
+}
+
+/**
+ * Returns whether the acquisitions are profiled
+ * @param[out] enable {@see Switch}
+ */
+void Camera::getProfiling(Switch& enable) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	enable = static_cast<Switch>(m_profiling);
+}
+
+/**
+ * Returns the hardware counters per frame of each stage of the last
+ * profiled acquisition, empty if the counters are not available. The
+ * decode stage only runs with the raw readout.
+ * @param[out] profile the counters of each stage
+ */
+void Camera::getProfile(std::vector<StageProfile>& profile) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	profile.clear();
+	for (int stage = 0; stage < NB_PROFILE_STAGES; stage++) {
+		long long frames = m_profile.frames[stage];
+		if (frames == 0)
+			continue;
+		double perFrame[NB_PROFILE_COUNTERS];
+		for (int c = 0; c < NB_PROFILE_COUNTERS; c++)
+			perFrame[c] = m_profile.available[c] ? double(m_profile.counts[stage][c]) / frames : -1;
+		StageProfile stageProfile;
+		stageProfile.stage = Mythen3Profiler::stageName(static_cast<ProfileStage>(stage));
+		stageProfile.frames = frames;
+		stageProfile.instructions = perFrame[PROFILE_INSTRUCTIONS];
+		stageProfile.cycles = perFrame[PROFILE_CYCLES];
+		stageProfile.cacheMisses = perFrame[PROFILE_CACHE_MISSES];
+		stageProfile.branchMisses = perFrame[PROFILE_BRANCH_MISSES];
+		profile.push_back(stageProfile);
+	}
+}
+
+/**
+ * Sets the pace of the frames of a simulated camera relative to the exposure
+ * time and delays: 1 is real time, 2 twice as fast and 0 without delay
+ * @param[in] speed the time scale of the simulated acquisition
+ */
+void Camera::setSimulationSpeed(double speed) {
+	DEB_MEMBER_FUNCT();
+	if (!m_simulated) {
+		THROW_HW_ERROR(NotSupported) << "Simulation speed of a real detector";
+	}
+	m_simulator->setSpeed(speed);
+}
+
+/**
+ * Returns the pace of the frames of a simulated camera, 1 = real time
+ * @param[out] speed the time scale of the simulated acquisition
+ */
+void Camera::getSimulationSpeed(double& speed) {
+	DEB_MEMBER_FUNCT();
+	if (!m_simulated) {
+		THROW_HW_ERROR(NotSupported) << "Simulation speed of a real detector";
+	}
+	speed = m_simulator->getSpeed();
+}
+
+/**
+ * Sets the channel ranges summed in each frame by the acquisition thread,
+ * from the next acquisition on. The channels are numbered across the
+ * modules. Empty vectors disable the sums.
+ * @param[in] first the first channel of each range
+ * @param[in] last the last channel of each range, included
+ */
+void Camera::setRois(const std::vector<int>& first, const std::vector<int>& last) {
+	DEB_MEMBER_FUNCT();
+	if (first.size() != last.size()) {
+		THROW_HW_ERROR(InvalidValue) << "As many first as last channels expected";
+	} else if (first.size() > static_cast<size_t>(MaxRois)) {
+		THROW_HW_ERROR(InvalidValue) << "At most " << MaxRois << " ROIs";
+	}
+	for (size_t r = 0; r < first.size(); r++) {
+		if (first[r] < 0 || first[r] > last[r]) {
+			THROW_HW_ERROR(InvalidValue) << "Invalid ROI " << first[r] << " to " << last[r];
+		}
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "ROIs cannot change during an acquisition";
+	}
+	m_roi.setRois(first, last);
+}
+
+/**
+ * Returns the channel ranges summed in each frame
+ * @param[out] first the first channel of each range
+ * @param[out] last the last channel of each range, included
+ */
+void Camera::getRois(std::vector<int>& first, std::vector<int>& last) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_roi.getRois(first, last);
+}
+
+/**
+ * Returns the ROI sums of up to max_frames consecutive frames from first.
+ * The sums of the whole acquisition are kept, of its last RoiTableFrames
+ * frames if it is continuous or longer.
+ * @param[out] sums the sums, of dimensions number of ROIs x frames
+ * @param[in] first the number of the first frame
+ * @param[in] max_frames the most frames returned
+ */
+void Camera::readRoiSums(Data& sums, int first, int max_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	int nbRois = m_roi.getNbRois();
+	int nbRows = m_roi.getNbRows();
+	long long oldest = m_acq_frame_nb - nbRows;
+	if (m_thread_running)
+		++oldest;
+	if (nbRois == 0 || nbRows == 0) {
+		THROW_HW_ERROR(Error) << "No ROI sums acquired";
+	} else if (first >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (first < oldest) {
+		THROW_HW_ERROR(Error) << "ROI sums of frame " << first << " overwritten";
+	}
+	int nb_frames = static_cast<int>(min<long long>(max_frames, m_acq_frame_nb - first));
+	Buffer *buffer = new Buffer(nb_frames * nbRois * sizeof(int64_t));
+	int64_t* row = (int64_t*) buffer->data;
+	for (int i = 0; i < nb_frames; i++, row += nbRois)
+		memcpy(row, m_roi.getRow(first + i), nbRois * sizeof(int64_t));
+	aLock.unlock();
+
+	sums.type = Data::INT64;
+	sums.dimensions.clear();
+	sums.dimensions.push_back(nbRois);
+	sums.dimensions.push_back(nb_frames);
+	sums.frameNumber = first;
+	sums.setBuffer(buffer);
+	buffer->unref();
+}
+
+/**
+ * Sets the number of sub-frames summed into each frame, from the next
+ * acquisition on; 1 disables the accumulation. The exposure time and the
+ * triggers are those of a sub-frame, the number of frames that of the
+ * summed frames. The sums are 32 bit: the number of sub-frames times their
+ * saturation count must fit.
+ * @param[in] nb_sub_frames the number of sub-frames per frame
+ */
+void Camera::setAccumulation(int nb_sub_frames) {
+	DEB_MEMBER_FUNCT();
+	if (nb_sub_frames < 1) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_sub_frames);
+	}
+	long long hw_frames = static_cast<long long>(m_nb_frames) * nb_sub_frames;
+	if (hw_frames >= ContinuousHwFrames) {
+		THROW_HW_ERROR(InvalidValue) << "Too many sub-frames for " << m_nb_frames << " frames";
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Accumulation cannot change during an acquisition";
+	}
+	m_accumulator.setNbSubFrames(nb_sub_frames);
+	aLock.unlock();
+	setSyncParam(SYNC_FRAMES, m_nb_frames ? hw_frames : ContinuousHwFrames);
+}
+
+/**
+ * Returns the number of sub-frames summed into each frame, 1 if not
+ * accumulating
+ * @param[out] nb_sub_frames the number of sub-frames per frame
+ */
+void Camera::getAccumulation(int& nb_sub_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	nb_sub_frames = m_accumulator.getNbSubFrames();
+}
+
+/**
+ * Returns the record of an accumulated frame: its sub-frames, which of them
+ * reached the saturation count and when they were read out. The records of
+ * the whole acquisition are kept, of its last AccTableFrames frames if it is
+ * continuous or longer.
+ * @param[in] frame_nb the number of the frame
+ * @param[out] info the {@see AccFrameInfo} of the frame
+ * @param[out] saturated 1 for each saturated sub-frame, 0 otherwise
+ */
+void Camera::getAccFrameInfo(int frame_nb, AccFrameInfo& info, std::vector<int>& saturated) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	int nbRows = m_accumulator.getNbRows();
+	long long oldest = m_acq_frame_nb - nbRows;
+	if (m_thread_running)
+		++oldest;
+	if (nbRows == 0) {
+		THROW_HW_ERROR(Error) << "No frame accumulated";
+	} else if (frame_nb >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (frame_nb < oldest) {
+		THROW_HW_ERROR(Error) << "Record of frame " << frame_nb << " overwritten";
+	}
+	const Mythen3Accumulator::Record& record = m_accumulator.getRecord(frame_nb);
+	info.subFrames = record.nbSubFrames;
+	info.saturatedSubFrames = record.nbSaturated;
+	info.start = record.start;
+	info.end = record.end;
+	const uint8_t* flags = m_accumulator.getSaturated(frame_nb);
+	saturated.assign(flags, flags + record.nbSubFrames);
+}
+
+/**
+ * Sets the angular calibration of each module, used by the rebinning from
+ * the next acquisition on. The angle of the position x (in channels) of a
+ * module is offset + atan((x - centre) * conversion), in degrees.
+ * @param[in] centre the channel of each module normal to the beam
+ * @param[in] conversion the channel pitch over the sample distance of each module (rad)
+ * @param[in] offset the angle of the centre of each module (degrees)
+ */
+void Camera::setAngularCalibration(const std::vector<double>& centre, const std::vector<double>& conversion,
+		const std::vector<double>& offset) {
+	DEB_MEMBER_FUNCT();
+	if (centre.size() != conversion.size() || centre.size() != offset.size()) {
+		THROW_HW_ERROR(InvalidValue) << "As many centres, conversions and offsets expected";
+	}
+	for (size_t m = 0; m < conversion.size(); m++) {
+		if (conversion[m] == 0) {
+			THROW_HW_ERROR(InvalidValue) << "Null conversion of module " << m;
+		}
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Angular calibration cannot change during an acquisition";
+	}
+	m_rebin.setCalibration(centre, conversion, offset);
+}
+
+/**
+ * Returns the angular calibration of each module
+ * @param[out] centre the channel of each module normal to the beam
+ * @param[out] conversion the channel pitch over the sample distance of each module (rad)
+ * @param[out] offset the angle of the centre of each module (degrees)
+ */
+void Camera::getAngularCalibration(std::vector<double>& centre, std::vector<double>& conversion,
+		std::vector<double>& offset) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_rebin.getCalibration(centre, conversion, offset);
+}
+
+/**
+ * Sets the 2θ grid onto which each frame is rebinned by the acquisition
+ * thread, from the next acquisition on. The modules are merged: a bin is
+ * the average of the channels covering it.
+ * @param[in] start the lower edge of the first bin (degrees)
+ * @param[in] end the upper edge of the last bin, rounded up to a whole bin (degrees)
+ * @param[in] bin_size the bin width (degrees), 0 disables the rebinning
+ */
+void Camera::setRebinning(double start, double end, double bin_size) {
+	DEB_MEMBER_FUNCT();
+	if (bin_size < 0 || (bin_size > 0 && end <= start)) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR3(start, end, bin_size);
+	} else if (bin_size > 0 && (end - start) / bin_size > MaxRebinBins) {
+		THROW_HW_ERROR(InvalidValue) << "At most " << MaxRebinBins << " bins";
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Rebinning cannot change during an acquisition";
+	}
+	m_rebin.setBinning(start, end, bin_size);
+}
+
+/**
+ * Returns the 2θ grid of the rebinning
+ * @param[out] start the lower edge of the first bin (degrees)
+ * @param[out] end the upper edge of the last bin (degrees)
+ * @param[out] bin_size the bin width (degrees), 0 if disabled
+ */
+void Camera::getRebinning(double& start, double& end, double& bin_size) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_rebin.getBinning(start, end, bin_size);
+}
+
+/**
+ * Returns the angle at the centre of each bin of the rebinned patterns
+ * @param[out] angles the 2θ of each bin (degrees)
+ */
+void Camera::getRebinAngles(std::vector<double>& angles) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_rebin.getAngles(angles);
+}
+
+/**
+ * Returns the rebinned patterns of up to max_frames consecutive frames from
+ * first. The patterns are kept as long as their frames in the buffer ring.
+ * @param[out] patterns the patterns, of dimensions bins x frames
+ * @param[in] first the number of the first frame
+ * @param[in] max_frames the most frames returned
+ */
+void Camera::readRebinned(Data& patterns, int first, int max_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	int nbBins = m_rebin.getNbBins();
+	int nbRows = m_rebin.getNbRows();
+	long long oldest = m_acq_frame_nb - nbRows;
+	if (m_thread_running)
+		++oldest;
+	if (nbBins == 0 || nbRows == 0) {
+		THROW_HW_ERROR(Error) << "No rebinned pattern acquired";
+	} else if (first >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (first < oldest) {
+		THROW_HW_ERROR(Error) << "Pattern of frame " << first << " overwritten";
+	}
+	int nb_frames = static_cast<int>(min<long long>(max_frames, m_acq_frame_nb - first));
+	Buffer *buffer = new Buffer(nb_frames * nbBins * sizeof(float));
+	float* row = (float*) buffer->data;
+	for (int i = 0; i < nb_frames; i++, row += nbBins)
+		memcpy(row, m_rebin.getRow(first + i), nbBins * sizeof(float));
+	aLock.unlock();
+
+	patterns.type = Data::FLOAT;
+	patterns.dimensions.clear();
+	patterns.dimensions.push_back(nbBins);
+	patterns.dimensions.push_back(nb_frames);
+	patterns.frameNumber = first;
+	patterns.setBuffer(buffer);
+	buffer->unref();
+}
+
+/**
+ * Sets the peak search run on each frame by the acquisition thread, from the
+ * next acquisition on. A peak is a run of at least min_width consecutive
+ * channels at or above threshold.
+ * @param[in] threshold the lowest count of a peak channel, 0 disables the search
+ * @param[in] min_width the fewest channels of a peak
+ */
+void Camera::setPeakSearch(int threshold, int min_width) {
+	DEB_MEMBER_FUNCT();
+	if (threshold < 0 || min_width < 1) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR2(threshold, min_width);
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Peak search cannot change during an acquisition";
+	}
+	m_peak_search.setThreshold(threshold, min_width);
+}
+
+/**
+ * Returns the peak search parameters
+ * @param[out] threshold the lowest count of a peak channel, 0 if disabled
+ * @param[out] min_width the fewest channels of a peak
+ */
+void Camera::getPeakSearch(int& threshold, int& min_width) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	uint32_t count;
+	m_peak_search.getThreshold(count, min_width);
+	threshold = count;
+}
+
+/**
+ * Returns the peaks found in up to max_frames consecutive frames from
+ * first, at most MaxPeaks per frame. The peaks are kept as long as their
+ * frames in the buffer ring. Without peaks, the table has 5 columns and no
+ * row, over a buffer of one row so that it is never a null pointer (NumPy
+ * would allocate one, see mythen3DataArray()).
+ * @param[out] peaks the peaks, one row of frame number, position (channel),
+ * height, area and width (channels) per peak
+ * @param[in] first the number of the first frame
+ * @param[in] max_frames the most frames searched
+ */
+void Camera::readPeaks(Data& peaks, int first, int max_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	int nbRows = m_peak_search.getNbRows();
+	long long oldest = m_acq_frame_nb - nbRows;
+	if (m_thread_running)
+		++oldest;
+	if (nbRows == 0) {
+		THROW_HW_ERROR(Error) << "No peak search acquired";
+	} else if (first >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (first < oldest) {
+		THROW_HW_ERROR(Error) << "Peaks of frame " << first << " overwritten";
+	}
+	int nb_frames = static_cast<int>(min<long long>(max_frames, m_acq_frame_nb - first));
+	int nb_peaks = 0;
+	for (int i = 0; i < nb_frames; i++)
+		nb_peaks += m_peak_search.getNbPeaks(first + i);
+	const int columns = 5;
+	Buffer *buffer = new Buffer(max(nb_peaks, 1) * columns * sizeof(double));
+	double* row = (double*) buffer->data;
+	for (int i = 0; i < nb_frames; i++) {
+		const Mythen3PeakSearch::Peak* peak = m_peak_search.getPeaks(first + i);
+		for (int p = m_peak_search.getNbPeaks(first + i); p > 0; p--, peak++, row += columns) {
+			row[0] = first + i;
+			row[1] = peak->position;
+			row[2] = peak->height;
+			row[3] = peak->area;
+			row[4] = peak->width;
+		}
+	}
+	aLock.unlock();
+
+	peaks.type = Data::DOUBLE;
+	peaks.dimensions.clear();
+	peaks.dimensions.push_back(columns);
+	peaks.dimensions.push_back(nb_peaks);
+	peaks.frameNumber = first;
+	peaks.setBuffer(buffer);
+	buffer->unref();
+}
+
+/**
+ * Sets the channels summed into each channel of the binned frames, a
+ * reduced resolution copy of each frame made by the acquisition thread from
+ * the next acquisition on. The sums saturate at the largest 32 bit count.
+ * @param[in] factor the channels per binned channel, a divisor of the
+ * channels of a module, 1 disables the binned frames
+ */
+void Camera::setChannelBinning(int factor) {
+	DEB_MEMBER_FUNCT();
+	if (factor < 1 || factor > MaxChannelBinning || PixelsPerModule % factor) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(factor)
+				<< ", must divide " << PixelsPerModule << " up to " << MaxChannelBinning;
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Channel binning cannot change during an acquisition";
+	}
+	m_channel_binning.setFactor(factor);
+}
+
+/**
+ * Returns the channels summed into each channel of the binned frames
+ * @param[out] factor the channels per binned channel, 1 if disabled
+ */
+void Camera::getChannelBinning(int& factor) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	factor = m_channel_binning.getFactor();
+}
+
+/**
+ * Returns up to max_frames consecutive binned frames from first. The binned
+ * frames are kept as long as their frames in the buffer ring.
+ * @param[out] frames the binned frames, of dimensions binned channels x frames
+ * @param[in] first the number of the first frame
+ * @param[in] max_frames the most frames returned
+ */
+void Camera::readBinnedFrames(Data& frames, int first, int max_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	int width = m_channel_binning.getWidth();
+	int nbRows = m_channel_binning.getNbRows();
+	long long oldest = m_acq_frame_nb - nbRows;
+	if (m_thread_running)
+		++oldest;
+	if (nbRows == 0) {
+		THROW_HW_ERROR(Error) << "No binned frame acquired";
+	} else if (first >= m_acq_frame_nb) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	} else if (first < oldest) {
+		THROW_HW_ERROR(Error) << "Binned frame " << first << " overwritten";
+	}
+	int nb_frames = static_cast<int>(min<long long>(max_frames, m_acq_frame_nb - first));
+	Buffer *buffer = new Buffer(nb_frames * width * sizeof(uint32_t));
+	uint32_t* row = (uint32_t*) buffer->data;
+	for (int i = 0; i < nb_frames; i++, row += width)
+		memcpy(row, m_channel_binning.getRow(first + i), width * sizeof(uint32_t));
+	aLock.unlock();
+
+	frames.type = Data::UINT32;
+	frames.dimensions.clear();
+	frames.dimensions.push_back(width);
+	frames.dimensions.push_back(nb_frames);
+	frames.frameNumber = first;
+	frames.setBuffer(buffer);
+	buffer->unref();
+}
+
+/**
+ * Enables the running statistics of each channel (mean, variance, minimum
+ * and maximum), updated by the acquisition thread from the next acquisition
+ * on. Cheap enough to stay on.
+ * @param[in] enable ON to keep the statistics
+ */
+void Camera::setChannelStats(Switch enable) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Channel statistics cannot change during an acquisition";
+	}
+	AutoMutex statsLock(m_stats_mutex);
+	m_channel_stats.setEnabled(enable == ON);
+}
+
+/**
+ * Returns whether the running statistics of each channel are kept
+ * @param[out] enable ON if kept
+ */
+void Camera::getChannelStats(Switch& enable) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex statsLock(m_stats_mutex);
+	enable = m_channel_stats.isEnabled() ? ON : OFF;
+}
+
+/**
+ * Sets the frames over which the channel statistics are kept, from the next
+ * acquisition on. The window slides by an eighth of its frames.
+ * @param[in] frames the frames of the window, 0 for the whole acquisition
+ */
+void Camera::setChannelStatsWindow(int frames) {
+	DEB_MEMBER_FUNCT();
+	if (frames < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(frames);
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_thread_running || m_start_pending) {
+		THROW_HW_ERROR(Error) << "Channel statistics cannot change during an acquisition";
+	}
+	AutoMutex statsLock(m_stats_mutex);
+	m_channel_stats.setWindow(frames);
+}
+
+/**
+ * Returns the frames over which the channel statistics are kept
+ * @param[out] frames the frames of the window, 0 for the whole acquisition
+ */
+void Camera::getChannelStatsWindow(int& frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex statsLock(m_stats_mutex);
+	frames = m_channel_stats.getWindow();
+}
+
+/**
+ * Returns the statistics of each channel over the frames of the window, or
+ * of the acquisition, read so far
+ * @param[out] stats the mean, variance, minimum and maximum rows, of
+ * dimensions channels x 4
+ * @param[out] nb_frames the frames of the statistics
+ */
+void Camera::readChannelStats(Data& stats, int& nb_frames) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex statsLock(m_stats_mutex);
+	int width = m_channel_stats.getWidth();
+	if (width == 0) {
+		THROW_HW_ERROR(Error) << "No channel statistics acquired";
+	}
+	Buffer *buffer = new Buffer(4 * width * sizeof(double));
+	double* rows = (double*) buffer->data;
+	m_channel_stats.get(rows, rows + width, rows + 2 * width, rows + 3 * width);
+	nb_frames = static_cast<int>(m_channel_stats.getNbFrames());
+	statsLock.unlock();
+
+	stats.type = Data::DOUBLE;
+	stats.dimensions.clear();
+	stats.dimensions.push_back(width);
+	stats.dimensions.push_back(4);
+	stats.frameNumber = 0;
+	stats.setBuffer(buffer);
+	buffer->unref();
+}
+
+/**
+ * Compares the channel statistics with the bad channel map of the detector.
+ * A channel not flagged bad is dead if it never counted while the median of
+ * its module did, hot if its mean is HotChannelFactor times the median,
+ * noisy if its variance is NoisyChannelFactor times its mean. A channel
+ * flagged bad is recovered if none of these hold, unless the bad channels
+ * are interpolated.
+ * @param[out] health the {@see ChannelHealth} of each channel
+ */
+void Camera::checkChannels(std::vector<int>& health) {
+	DEB_MEMBER_FUNCT();
+	Data badChannels;
+	getBadChannels(badChannels);
+	Switch interpolated;
+	getBadChannelInterpolation(interpolated);
+	Data stats;
+	int nb_frames;
+	readChannelStats(stats, nb_frames);
+	int width = stats.dimensions[0];
+	if (nb_frames == 0) {
+		THROW_HW_ERROR(Error) << "No frame in the channel statistics";
+	} else if (badChannels.dimensions[0] < width) {
+		THROW_HW_ERROR(Error) << "Bad channel map of " << badChannels.dimensions[0]
+				<< " channels, " << width << " expected";
+	}
+	const int32_t* bad = (const int32_t*) badChannels.data();
+	const double* mean = (const double*) stats.data();
+	const double* variance = mean + width;
+	const double* high = mean + 3 * width;
+	health.assign(width, CONSISTENT);
+	std::vector<double> means;
+	for (int module = 0; module < width / PixelsPerModule; module++) {
+		int first = module * PixelsPerModule;
+		means.assign(mean + first, mean + first + PixelsPerModule);
+		std::nth_element(means.begin(), means.begin() + PixelsPerModule / 2, means.end());
+		double median = means[PixelsPerModule / 2];
+		for (int c = first; c < first + PixelsPerModule; c++) {
+			ChannelHealth state = CONSISTENT;
+			if (high[c] == 0 && median > 0)
+				state = DEAD;
+			else if (mean[c] > HotChannelFactor * std::max(median, 1.0))
+				state = HOT;
+			else if (variance[c] > NoisyChannelFactor * std::max(mean[c], 1.0))
+				state = NOISY;
+			if (!bad[c])
+				health[c] = state;
+			else if (state == CONSISTENT && interpolated == OFF)
+				health[c] = RECOVERED;
+		}
+	}
+}
+
+/**
+ * Returns the number of automatic reconnections since the camera was created
+ * @param[out] nbReconnects the number of reconnections
+ */
+void Camera::getNbReconnects(int& nbReconnects) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_recover_mutex);
+	nbReconnects = m_nb_reconnects;
+}
+
+///////////////////////
+// private methods
+///////////////////////
+
+/*
+ * Returns the data of the oldest frame in the buffer (i.e. the frames are
+ * returned in the same order as they were acquired. The Mythen can internally
+ * buffer the last four acquired frames.  If the buffer is empty and there is
+ * an ongoing measurement, the command returns the data after the measurement
+ * has finished. If the readout fails all count are set to -1.
+ * @param[out] data an array containing the frame data
+ * @param[in] len the size of the array = [nbModules*npixels].
+ */
+void Camera::readout(uint32_t* data, int len) {
+	DEB_HOT_FUNCT();
+	requestCmd(READOUT, data, len);
+	// a bad channel reads -2, only a failed readout reads -1
+	if (data[0] == FailedReadoutCount && data[len - 1] == FailedReadoutCount) {
+		DEB_HOT_ERROR_FUNCT();
+		THROW_HW_ERROR(Error) << serverStatusMap[-6];
+	}
+}
+
+/*
+ * Returns the data of the oldest frame in the buffer in a raw compressed format.
+ * The Mythen does not apply any correction to the data , thereby allowing for
+ * maximal frame rates.
+ * @param[out] data an array containing the raw data
+ * @param[in] len the size of the array = [nbModules*nBits].
+ */
+void Camera::readoutRaw(uint32_t* data, int len) {
+	DEB_HOT_FUNCT();
+	requestCmd(READOUTRAW, data, len);
+}
+
+/*
+ * Decode the raw data buffer in-place.
+ * @param[in] nbits number of bits read out
+ * @param[in] width the image width = [nbModules*PixelsPerModule]
+ * @param[out] buff packed data array in decoded array out
+ */
+void Camera::decodeRaw(Nbits nbits, uint32_t* buff, int width) {
+	int chansPerPoint = CHAR_BIT * sizeof(int) / nbits;
+	uint32_t mask = 0xffffffff >> ((nbits * (chansPerPoint - 1)));
+	int size = width / chansPerPoint;
+	uint32_t *bptr = buff + width - 1;
+	uint32_t *iptr = buff + size - 1;
+	for (int j = size - 1; j >= 0; j--, iptr--) {
+		for (int i = chansPerPoint - 1; i >= 0; i--) {
+			uint32_t shift = nbits * i;
+			uint32_t shiftmask = mask << shift;
+			*bptr-- = ((*iptr & shiftmask) >> shift) & mask;
+		}
+	}
+}
+
+/*
+ * Map a frame number onto the buffer ring. Frame numbers are 64 bit and
+ * never wrap; the buffers are reused modulo the ring size.
+ */
+int Camera::getRingIndex(long long frame_nb) const {
+	return static_cast<int>(frame_nb % m_nb_buffers);
+}
+
+/*
+ * Return the number of the oldest frame not yet overwritten in the ring.
+ * While running, the buffer of frame m_acq_frame_nb is being written and
+ * the frame nb_buffers older than it is already lost. Called with m_cond
+ * locked.
+ */
+long long Camera::getOldestFrameNb() const {
+	long long oldest = m_acq_frame_nb - m_nb_buffers;
+	if (m_thread_running)
+		++oldest;
+	return (oldest > 0) ? oldest : 0;
+}
+
+/*
+ * The count at which a sub-frame saturates, read from the detector cutoff
+ * at 24 bits, and checked not to overflow the 32 bit sum of the sub-frames.
+ * 0 when not accumulating.
+ */
+uint32_t Camera::accThreshold() {
+	DEB_MEMBER_FUNCT();
+	int nb_sub_frames;
+	getAccumulation(nb_sub_frames);
+	if (nb_sub_frames == 1)
+		return 0;
+	uint32_t threshold = (1U << m_nbits) - 1;
+	if (m_nbits == Camera::BPP24) {
+		if (!m_scan_mode || m_cutoff < 0)
+			getCutoff(m_cutoff);
+		if (m_cutoff > 0 && static_cast<uint32_t>(m_cutoff) < threshold)
+			threshold = m_cutoff;
+	}
+	if (static_cast<uint64_t>(threshold) * nb_sub_frames > UINT32_MAX) {
+		THROW_HW_ERROR(InvalidValue) << nb_sub_frames << " sub-frames of up to " << threshold
+				<< " counts overflow 32 bit frames";
+	}
+	return threshold;
+}
+
+/*
+ * Read the channels the detector reads as -2: the bad channels, unless it
+ * interpolates them
+ */
+void Camera::updateBadChannels() {
+	DEB_MEMBER_FUNCT();
+	std::vector<int> channels;
+	Switch interpolated;
+	getBadChannelInterpolation(interpolated);
+	if (interpolated == OFF) {
+		Data badChannels;
+		getBadChannels(badChannels);
+		const int32_t* bad = (const int32_t*) badChannels.data();
+		for (int c = 0; c < badChannels.dimensions[0]; c++)
+			if (bad[c])
+				channels.push_back(c);
+	}
+	DEB_TRACE() << channels.size() << " bad channels masked";
+	AutoMutex aLock(m_cond.mutex());
+	m_bad_channels.setBadChannels(channels);
+	m_bad_channels_known = true;
+}
+
+/*
+ * Record a value requested by the synchronisation control; it is sent to the
+ * detector by applySyncConfig() if it differs from the current value.
+ */
+void Camera::setSyncParam(SyncParam param, long long value) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(param, value);
+	m_sync_desired[param] = value;
+	m_sync_pending |= 1 << param;
+}
+
+/*
+ * Returns the value to report for a synchronisation parameter without a
+ * network request: the pending desired value, or in scan mode the current
+ * one. Returns false if the detector must be asked.
+ */
+bool Camera::getCachedSyncParam(SyncParam param, long long& value) const {
+	unsigned int bit = 1 << param;
+	if (m_sync_pending & bit) {
+		value = m_sync_desired[param];
+		return true;
+	}
+	if (m_scan_mode && (m_sync_known & bit)) {
+		value = m_sync_current[param];
+		return true;
+	}
+	return false;
+}
+
+/*
+ * The value the detector has or will have after applySyncConfig(), if known
+ */
+bool Camera::getKnownSyncParam(SyncParam param, long long& value) const {
+	unsigned int bit = 1 << param;
+	if (m_sync_pending & bit) {
+		value = m_sync_desired[param];
+		return true;
+	}
+	if (m_sync_known & bit) {
+		value = m_sync_current[param];
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Time allowed for a frame to arrive in internal trigger mode: the frame
+ * period plus ReadoutTimeoutMargin. A frame waiting for a trigger or a gate
+ * may come at any time, the readout is then not bounded and a lost detector
+ * is only detected by the TCP keepalive of Mythen3Net.
+ */
+double Camera::readoutTimeout() {
+	DEB_MEMBER_FUNCT();
+	static const SyncParam external[] = {SYNC_TRIGGERED, SYNC_CONTTRIG, SYNC_GATEMODE};
+	long long value;
+	for (unsigned int i = 0; i < sizeof(external) / sizeof(*external); i++) {
+		if (!getKnownSyncParam(external[i], value) || value)
+			return 0;
+	}
+	long long period = 0;
+	if (!getKnownSyncParam(SYNC_TIME, value))
+		getTime(value);
+	period += value;
+	if (!getKnownSyncParam(SYNC_DELBEF, value))
+		getDelayBeforeFrame(value);
+	period += value;
+	if (!getKnownSyncParam(SYNC_DELAFTER, value))
+		getDelayAfterFrame(value);
+	period += value;
+	return period * 1e-7 + ReadoutTimeoutMargin;
+}
+
+/*
+ * Track a value written to or read from the detector outside
+ * applySyncConfig(). A value written explicitly supersedes the pending one.
+ */
+void Camera::syncUpdated(SyncParam param, long long value, bool written) {
+	unsigned int bit = 1 << param;
+	m_sync_current[param] = value;
+	m_sync_known |= bit;
+	if (written)
+		m_sync_pending &= ~bit;
+}
+
+void Camera::syncUpdated(const AcqConfig& config, bool written) {
+	syncUpdated(SYNC_CONTTRIG, config.continuousTrigger, written);
+	syncUpdated(SYNC_TRIGGERED, config.triggered, written);
+	syncUpdated(SYNC_GATEMODE, config.gateMode, written);
+	syncUpdated(SYNC_GATES, config.gates, written);
+	syncUpdated(SYNC_DELBEF, config.delayBefore, written);
+	syncUpdated(SYNC_DELAFTER, config.delayAfter, written);
+	syncUpdated(SYNC_TIME, config.time, written);
+	syncUpdated(SYNC_FRAMES, config.frames ? config.frames : ContinuousHwFrames, written);
+}
+
+/*
+ * Reconcile the desired synchronisation parameters with the detector: only
+ * the values that differ from the last known detector state are sent, in a
+ * single batch. On failure the state of the parameters sent is unknown and
+ * they stay pending.
+ */
+void Camera::applySyncConfig() {
+	DEB_MEMBER_FUNCT();
+	BatchCmd batch[MaxBatchCmds];
+	int nb = 0;
+	unsigned int sent = 0;
+	for (int param = 0; param < NB_SYNC_PARAMS; param++) {
+		unsigned int bit = 1 << param;
+		if (!(m_sync_pending & bit))
+			continue;
+		if ((m_sync_known & bit) && m_sync_current[param] == m_sync_desired[param])
+			continue;
+		if (param == SYNC_TIME || param == SYNC_DELBEF || param == SYNC_DELAFTER) {
+			batchSet(batch, nb, syncSetCmds[param], m_sync_desired[param]);
+		} else {
+			batchSet(batch, nb, syncSetCmds[param], static_cast<int>(m_sync_desired[param]));
+		}
+		sent |= bit;
+	}
+	DEB_TRACE() << DEB_VAR3(m_sync_pending, m_sync_known, nb);
+	if (nb > 0) {
+		try {
+			sendBatch(batch, nb);
+		} catch (...) {
+			m_sync_known &= ~sent;
+			throw;
+		}
+	}
+	for (int param = 0; param < NB_SYNC_PARAMS; param++) {
+		if (m_sync_pending & (1 << param))
+			m_sync_current[param] = m_sync_desired[param];
+	}
+	m_sync_known |= m_sync_pending;
+	m_sync_pending = 0;
+}
+
+template<typename T>
+void Camera::checkReply(T rc) {
+	DEB_HOT_FUNCT();
+	int irc = *((unsigned int *) &rc);
+	if (irc < 0) {
+		DEB_HOT_ERROR_FUNCT();
+		THROW_HW_ERROR(Error) << serverStatusMap[irc];
+	}
+}
+
+/*
+ * Append a command argument. Overloaded for the argument types sent to the
+ * socket server; formats like operator<< without touching the heap.
+ */
+static int formatArg(char* buf, int size, int value) {
+	return snprintf(buf, size, " %d", value);
+}
+
+static int formatArg(char* buf, int size, long long value) {
+	return snprintf(buf, size, " %lld", value);
+}
+
+static int formatArg(char* buf, int size, float value) {
+	return snprintf(buf, size, " %g", value);
+}
+
+static int formatArg(char* buf, int size, const string& value) {
+	return snprintf(buf, size, " %s", value.c_str());
+}
+
+static int formatArg(char* buf, int size, const uint8_t* value) {
+	return snprintf(buf, size, " %s", reinterpret_cast<const char*>(value));
+}
+
+/*
+ * Append an argument to the command in cmdBuf, of which n characters are
+ * used. Returns the new length; a command that does not fit in MaxCmdLength
+ * is refused rather than sent truncated.
+ */
+template<typename T>
+int Camera::appendArg(char* cmdBuf, int n, const T& value) {
+	int len = formatArg(cmdBuf + n, MaxCmdLength - n, value);
+	if (len < 0 || len >= MaxCmdLength - n) {
+		DEB_MEMBER_FUNCT();
+		THROW_HW_ERROR(InvalidValue) << "Command " << cmdBuf << " too long";
+	}
+	return n + len;
+}
+
+void Camera::requestCmd(ServerCmd cmd) {
+	DEB_MEMBER_FUNCT();
+	sendCmd(Camera::CMD, cmd);
+}
+
+template<typename T>
+void Camera::requestCmd(ServerCmd cmd, T* value, int len) {
+	DEB_HOT_FUNCT();
+	uint8_t* buff;
+	buff = reinterpret_cast<uint8_t*>(value);
+	sendCmd(Camera::CMD, cmd, buff, len * sizeof(T));
+}
+
+template<typename T>
+void Camera::requestSet(ServerCmd cmd, T value) {
+	DEB_MEMBER_FUNCT();
+	sendCmd(Camera::SET, cmd, value);
+}
+template<typename T>
+void Camera::requestSet(ServerCmd cmd, T value1, T value2) {
+	DEB_MEMBER_FUNCT();
+	sendCmd(Camera::SET, cmd, value1, value2);
+}
+
+template<typename T>
+void Camera::requestGet(ServerCmd cmd, T& value) {
+	DEB_MEMBER_FUNCT();
+	uint8_t* recvBuf;
+	recvBuf = reinterpret_cast<uint8_t*>(&value);
+	sendCmd(Camera::GET, cmd, recvBuf, sizeof(T));
+}
+
+void Camera::requestGet(ServerCmd cmd, string& reply, int len) {
+	DEB_MEMBER_FUNCT();
+	uint8_t buff[64];
+	sendCmd(Camera::GET, cmd, buff, len);
+	stringstream os;
+	os << buff;
+	reply = os.str();
+}
+
+template<typename T>
+void Camera::requestGet(ServerCmd cmd, T* value, int len) {
+	DEB_MEMBER_FUNCT();
+	uint8_t* buff;
+	buff = reinterpret_cast<uint8_t*>(value);
+	sendCmd(Camera::GET, cmd, buff, len * max(sizeof(uint32_t), sizeof(T)));
+}
+
+void Camera::sendCmd(Action action, ServerCmd cmd) {
+	DEB_MEMBER_FUNCT();
+	int rc;
+	uint8_t *buff = reinterpret_cast<uint8_t*>(&rc);
+	if (m_simulated) {
+		simulate(action, cmd, buff, sizeof(int));
+	} else {
+		char cmdBuf[MaxCmdLength];
+		formatCmd(cmdBuf, action, cmd);
+		exchange(action, cmd, cmdBuf, buff, sizeof(int));
+	}
+}
+
+template<typename T>
+void Camera::sendCmd(Action action, ServerCmd cmd, T value) {
+	DEB_MEMBER_FUNCT();
+	int rc;
+	uint8_t *buff;
+	if (m_simulated) {
+		simulate(action, cmd, reinterpret_cast<uint8_t*>(&value), sizeof(T));
+	} else {
+		char cmdBuf[MaxCmdLength];
+		int n = formatCmd(cmdBuf, action, cmd);
+		appendArg(cmdBuf, n, value);
+		buff = reinterpret_cast<uint8_t*>(&rc);
+		exchange(action, cmd, cmdBuf, buff, sizeof(int));
+	}
+}
+
+template<typename T>
+void Camera::sendCmd(Action action, ServerCmd cmd, T value1, T value2) {
+	DEB_MEMBER_FUNCT();
+	int rc;
+	uint8_t *buff;
+	if (m_simulated) {
+		int size = sizeof(T);
+		uint8_t values[2*size];
+		memcpy(values, &value1, size);
+		memcpy((values+size), &value2, size);
+		simulate(action, cmd, values, size*2);
+	} else {
+		char cmdBuf[MaxCmdLength];
+		int n = formatCmd(cmdBuf, action, cmd);
+		n = appendArg(cmdBuf, n, value1);
+		appendArg(cmdBuf, n, value2);
+		buff = reinterpret_cast<uint8_t*>(&rc);
+		exchange(action, cmd, cmdBuf, buff, sizeof(int));
+	}
+}
+
+void Camera::sendCmd(Action action, ServerCmd cmd, uint8_t* buff, int len) {
+	DEB_HOT_FUNCT();
+	if (m_simulated) {
+		simulate(action, cmd, buff, len);
+	} else {
+		char cmdBuf[MaxCmdLength];
+		int n = formatCmd(cmdBuf, action, cmd);
+		if (action == Camera::SET) {
+			appendArg(cmdBuf, n, buff);
+		}
+		int reads = exchange(action, cmd, cmdBuf, buff, len);
+		if (cmd == READOUT || cmd == READOUTRAW)
+			m_readout_reads += reads;
+	}
+}
+
+/*
+ * The replies of these commands are data in which a negative first word is
+ * a legal value, not an error code: a bad channel reads -2 when the
+ * interpolation is off and tau reads -1.0 for the default dead time.
+ */
+static bool hasDataReply(Camera::ServerCmd cmd) {
+	switch (cmd) {
+	case Camera::READOUT:
+	case Camera::READOUTRAW:
+	case Camera::TESTPATTERN:
+	case Camera::LOGREAD:
+	case Camera::BADCHANNELS:
+	case Camera::FLATFIELD:
+	case Camera::TAU:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Send a command to the socket server and check its reply. After a lost
+ * connection has been recovered, see recover(), GET and SET commands are
+ * sent again; other commands are not repeated as their effect on the
+ * detector is unknown. Returns the number of recv() calls of the reply.
+ */
+int Camera::exchange(Action action, ServerCmd cmd, const char* cmdBuf, uint8_t* buff, int len) {
+	DEB_HOT_FUNCT();
+	bool data = (action != Camera::SET && hasDataReply(cmd));
+	int reads;
+	try {
+		reads = m_mythen->sendCmd(cmdBuf, buff, len, cmd, data);
+	} catch (Exception&) {
+		if (m_mythen->isConnected())
+			throw;
+		recover();
+		if (action == Camera::CMD) {
+			DEB_HOT_ERROR_FUNCT();
+			THROW_HW_ERROR(Error) << "Connection lost during " << serverCmdNames[cmd]
+					<< ", command not repeated";
+		}
+		reads = m_mythen->sendCmd(cmdBuf, buff, len, cmd, data);
+	}
+	if (!data) {
+		int rc = *((int *) buff);
+		checkReply(rc);
+	}
+	if (action == Camera::SET)
+		recordSet(cmd, cmdBuf);
+	return reads;
+}
+
+void Camera::recordSet(ServerCmd cmd, const char* cmdBuf) {
+	AutoMutex aLock(m_recover_mutex);
+	strncpy(m_config_snapshot[cmd], cmdBuf, MaxCmdLength);
+	m_config_seq[cmd] = ++m_config_count;
+}
+
+void Camera::clearConfigSnapshot() {
+	AutoMutex aLock(m_recover_mutex);
+	for (int cmd = 0; cmd < NB_SERVER_CMDS; cmd++)
+		m_config_seq[cmd] = 0;
+	m_config_count = 0;
+}
+
+/*
+ * Recover from a lost connection: reconnect with an exponential backoff and
+ * replay the configuration, see replayConfig(). Throws if auto reconnection
+ * is disabled or the detector stays unreachable. A thread finding the
+ * connection already recovered by another one returns at once.
+ */
+void Camera::recover() {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_recover_mutex);
+	if (m_mythen->isConnected())
+		return;
+	if (!m_auto_reconnect) {
+		THROW_HW_ERROR(Error) << "Camera::recover(): connection to " << m_hostname << " lost";
+	}
+	DEB_WARNING() << "Connection to " << m_hostname << " lost, reconnecting";
+	m_mythen->reconnect();
+	++m_nb_reconnects;
+	replayConfig();
+	m_sync_known = 0;
+	m_nbits_cached = false;
+	m_bad_channels_known = false;
+}
+
+/*
+ * Send again the last value of every setting changed since the last reset,
+ * in the order they were set, so that a power cycled detector gets the
+ * configuration back.
+ */
+void Camera::replayConfig() {
+	DEB_MEMBER_FUNCT();
+	unsigned long last = 0;
+	for (;;) {
+		int next = -1;
+		for (int cmd = 0; cmd < NB_SERVER_CMDS; cmd++) {
+			if (m_config_seq[cmd] > last && (next < 0 || m_config_seq[cmd] < m_config_seq[next]))
+				next = cmd;
+		}
+		if (next < 0)
+			break;
+		last = m_config_seq[next];
+		DEB_TRACE() << "replay " << m_config_snapshot[next];
+		int rc;
+		m_mythen->sendCmd(m_config_snapshot[next], reinterpret_cast<uint8_t*>(&rc), sizeof(int), next);
+		checkReply(rc);
+	}
+}
+
+template<typename T>
+void Camera::batchSet(BatchCmd* batch, int& nb, ServerCmd cmd, T value) {
+	DEB_MEMBER_FUNCT();
+	if (nb >= MaxBatchCmds) {
+		THROW_HW_ERROR(Error) << "Camera::batchSet(): too many commands in batch";
+	}
+	BatchCmd& bc = batch[nb++];
+	bc.action = Camera::SET;
+	bc.cmd = cmd;
+	int n = formatCmd(bc.cmdBuf, Camera::SET, cmd);
+	appendArg(bc.cmdBuf, n, value);
+	memcpy(bc.value, &value, sizeof(T));
+	bc.valueLen = sizeof(T);
+	bc.reply = reinterpret_cast<uint8_t*>(&bc.rc);
+	bc.len = sizeof(int);
+}
+
+template<typename T>
+void Camera::batchGet(BatchCmd* batch, int& nb, ServerCmd cmd, T& value) {
+	DEB_MEMBER_FUNCT();
+	if (nb >= MaxBatchCmds) {
+		THROW_HW_ERROR(Error) << "Camera::batchGet(): too many commands in batch";
+	}
+	BatchCmd& bc = batch[nb++];
+	bc.action = Camera::GET;
+	bc.cmd = cmd;
+	formatCmd(bc.cmdBuf, Camera::GET, cmd);
+	bc.valueLen = 0;
+	bc.reply = reinterpret_cast<uint8_t*>(&value);
+	bc.len = sizeof(T);
+}
+
+/*
+ * Send the commands queued by batchSet()/batchGet() in a single call to the
+ * socket layer, which pipelines them if enabled. Replies are checked once
+ * the whole batch has been exchanged.
+ */
+void Camera::sendBatch(BatchCmd* batch, int nb) {
+	DEB_MEMBER_FUNCT();
+	if (m_simulated) {
+		for (int i = 0; i < nb; i++) {
+			if (batch[i].action == Camera::SET) {
+				simulate(Camera::SET, batch[i].cmd, batch[i].value, batch[i].valueLen);
+			} else {
+				simulate(Camera::GET, batch[i].cmd, batch[i].reply, batch[i].len);
+			}
+		}
+		return;
+	}
+	Mythen3Net::Request requests[MaxBatchCmds];
+	for (int i = 0; i < nb; i++) {
+		requests[i].cmd = batch[i].cmdBuf;
+		requests[i].reply = batch[i].reply;
+		requests[i].len = batch[i].len;
+		requests[i].slot = batch[i].cmd;
+	}
+	try {
+		m_mythen->sendCmds(requests, nb);
+	} catch (Exception&) {
+		if (m_mythen->isConnected())
+			throw;
+		recover();
+		m_mythen->sendCmds(requests, nb);
+	}
+	for (int i = 0; i < nb; i++) {
+		int rc = *((int *) batch[i].reply);
+		checkReply(rc);
+		if (batch[i].action == Camera::SET)
+			recordSet(batch[i].cmd, batch[i].cmdBuf);
+	}
+}
+
+#if __GNUC_MINOR__ < 4
+typedef pair<int, string> StatusPair;
+static const StatusPair serverStatusList[] = {
+    StatusPair(  0, "Success"),
+    StatusPair( -1, "Unknown command"),
+    StatusPair( -2, "Invalid argument"),
+    StatusPair( -3, "Unknown settings"),
+    StatusPair( -4, "Out of memory"),
     StatusPair( -5, "Module calibration files not found"),
     StatusPair( -6, "Readout failed"),
     StatusPair(-10, "Flatfield file not found"),
@@ -1306,59 +3160,6 @@ static const StatusPair serverStatusList[] = {
 };
 std::map<int, std::string> Camera::serverStatusMap(C_LIST_ITERS(serverStatusList));
 
-typedef pair<const Camera::ServerCmd, string> ServerCmdPair;
-static const ServerCmdPair serverCmdList[] = {
-	ServerCmdPair(Camera::ASSEMBLYDATE,"assemblydate"),
-	ServerCmdPair(Camera::BADCHANNELS, "badchannels"),
-	ServerCmdPair(Camera::COMMANDID, "commandid"),
-	ServerCmdPair(Camera::MODNUM, "modnum"),
-	ServerCmdPair(Camera::MODULE, "module"),
-	ServerCmdPair(Camera::NMAXMODULES, "nmaxmodules"),
-	ServerCmdPair(Camera::NMODULES, "nmodules"),
-	ServerCmdPair(Camera::SENSORMATERIAL, "sensormaterial"),
-	ServerCmdPair(Camera::SENSORTHICKNESS, "sensorthickness"),
-	ServerCmdPair(Camera::SYSTEMNUM, "systemnum"),
-	ServerCmdPair(Camera::VERSION, "version"),
-	ServerCmdPair(Camera::RESET, "reset"),
-	ServerCmdPair(Camera::DELAFTER, "delafter"),
-	ServerCmdPair(Camera::FRAMES, "frames"),
-	ServerCmdPair(Camera::NBITS, "nbits"),
-	ServerCmdPair(Camera::STATUS, "status"),
-	ServerCmdPair(Camera::READOUT, "readout"),
-	ServerCmdPair(Camera::READOUTRAW, "readoutraw"),
-	ServerCmdPair(Camera::START, "start"),
-	ServerCmdPair(Camera::STOP, "stop"),
-	ServerCmdPair(Camera::TIME, "time"),
-	ServerCmdPair(Camera::ENERGY, "energy"),
-	ServerCmdPair(Camera::ENERGYMAX, "energymax"),
-	ServerCmdPair(Camera::ENERGYMIN, "energymin"),
-	ServerCmdPair(Camera::KTHRESH, "kthresh"),
-	ServerCmdPair(Camera::KTHRESHMAX, "kthreshmax"),
-	ServerCmdPair(Camera::KTHRESHMIN, "kthreshmin"),
-	ServerCmdPair(Camera::KTHRESHENERGY, "kthreshenergy"),
-	ServerCmdPair(Camera::SETTINGS, "settings"),
-	ServerCmdPair(Camera::BADCHANNELINTERPOLATION, "badchannelinterpolation"),
-	ServerCmdPair(Camera::FLATFIELDCORRECTION, "flatfieldcorrection"),
-	ServerCmdPair(Camera::CUTOFF, "cutoff"),
-	ServerCmdPair(Camera::FLATFIELD, "flatfield"),
-	ServerCmdPair(Camera::RATECORRECTION, "ratecorrection"),
-	ServerCmdPair(Camera::TAU, "tau"),
-	ServerCmdPair(Camera::CONTTRIGEN, "conttrigen"),
-	ServerCmdPair(Camera::DELBEF, "delbef"),
-	ServerCmdPair(Camera::GATEEN, "gateen"),
-	ServerCmdPair(Camera::GATES, "gates"),
-	ServerCmdPair(Camera::CONTTRIG, "conttrig"),
-	ServerCmdPair(Camera::GATE, "gate"),
-	ServerCmdPair(Camera::INPOL, "inpol"),
-	ServerCmdPair(Camera::OUTPOL, "outpol"),
-	ServerCmdPair(Camera::TRIG, "trig"),
-	ServerCmdPair(Camera::TRIGEN, "trigen"),
-	ServerCmdPair(Camera::LOGSTART, "log start"),
-	ServerCmdPair(Camera::LOGSTOP, "log stop"),
-	ServerCmdPair(Camera::LOGREAD, "log read"),
-	ServerCmdPair(Camera::TESTPATTERN, "testpattern"),
-};
-std::map<Camera::ServerCmd, std::string> Camera::serverCmdMap(C_LIST_ITERS(serverCmdList));
 
 #else
 std::map<int, std::string> Camera::serverStatusMap = {
@@ -1390,59 +3191,89 @@ std::map<int, std::string> Camera::serverStatusMap = {
 	    {-32, "Could not read the log file"}
 };
 
-std::map<Camera::ServerCmd, std::string> Camera::serverCmdMap = {
-	{ASSEMBLYDATE,"assemblydate"},
-	{BADCHANNELS, "badchannels"},
-	{COMMANDID, "commandid"},
-	{MODNUM, "modnum"},
-	{MODULE, "module"},
-	{NMAXMODULES, "nmaxmodules"},
-	{NMODULES, "nmodules"},
-	{SENSORMATERIAL, "sensormaterial"},
-	{SENSORTHICKNESS, "sensorthickness"},
-	{SYSTEMNUM, "systemnum"},
-	{VERSION, "version"},
-	{RESET, "reset"},
-	{DELAFTER, "delafter"},
-	{FRAMES, "frames"},
-	{NBITS, "nbits"},
-	{STATUS, "status"},
-	{READOUT, "readout"},
-	{READOUTRAW, "readoutraw"},
-	{START, "start"},
-	{STOP, "stop"},
-	{TIME, "time"},
-	{ENERGY, "energy"},
-	{ENERGYMAX, "energymax"},
-	{ENERGYMIN, "energymin"},
-	{KTHRESH, "kthresh"},
-	{KTHRESHMAX, "kthreshmax"},
-	{KTHRESHMIN, "kthreshmin"},
-	{KTHRESHENERGY, "kthreshenergy"},
-	{SETTINGS, "settings"},
-	{BADCHANNELINTERPOLATION, "badchannelinterpolation"},
-	{FLATFIELDCORRECTION, "flatfieldcorrection"},
-	{CUTOFF, "cutoff"},
-	{FLATFIELD, "flatfield"},
-	{RATECORRECTION, "ratecorrection"},
-	{TAU, "tau"},
-	{CONTTRIGEN, "conttrigen"},
-	{DELBEF, "delbef"},
-	{GATEEN, "gateen"},
-	{GATES, "gates"},
-	{CONTTRIG, "conttrig"},
-	{GATE, "gate"},
-	{INPOL, "inpol"},
-	{OUTPOL, "outpol"},
-	{TRIG, "trig"},
-	{TRIGEN, "trigen"},
-	{LOGSTART, "log start"},
-	{LOGSTOP, "log stop"},
-	{LOGREAD, "log read"},
-	{TESTPATTERN, "testpattern"},
-};
 #endif
 
+// Commands setting the synchronisation parameters, indexed by Camera::SyncParam
+const Camera::ServerCmd Camera::syncSetCmds[] = {
+	CONTTRIGEN,					// SYNC_CONTTRIG
+	TRIGEN,						// SYNC_TRIGGERED
+	GATEEN,						// SYNC_GATEMODE
+	GATES,						// SYNC_GATES
+	DELBEF,						// SYNC_DELBEF
+	DELAFTER,					// SYNC_DELAFTER
+	TIME,						// SYNC_TIME
+	FRAMES,						// SYNC_FRAMES
+};
+
+// Socket server command names, indexed by Camera::ServerCmd
+const char* const Camera::serverCmdNames[] = {
+	"assemblydate",				// ASSEMBLYDATE
+	"badchannels",				// BADCHANNELS
+	"commandid",				// COMMANDID
+	"modnum",					// MODNUM
+	"module",					// MODULE
+	"nmaxmodules",				// NMAXMODULES
+	"nmodules",					// NMODULES
+	"sensormaterial",			// SENSORMATERIAL
+	"sensorthickness",			// SENSORTHICKNESS
+	"systemnum",				// SYSTEMNUM
+	"version",					// VERSION
+	"reset",					// RESET
+	"delafter",					// DELAFTER
+	"frames",					// FRAMES
+	"nbits",					// NBITS
+	"status",					// STATUS
+	"time",						// TIME
+	"readout",					// READOUT
+	"readoutraw",				// READOUTRAW
+	"start",					// START
+	"stop",						// STOP
+	"energy",					// ENERGY
+	"energymax",				// ENERGYMAX
+	"energymin",				// ENERGYMIN
+	"kthresh",					// KTHRESH
+	"kthreshmax",				// KTHRESHMAX
+	"kthreshmin",				// KTHRESHMIN
+	"kthreshenergy",			// KTHRESHENERGY
+	"settings",					// SETTINGS
+	"badchannelinterpolation",	// BADCHANNELINTERPOLATION
+	"flatfieldcorrection",		// FLATFIELDCORRECTION
+	"cutoff",					// CUTOFF
+	"flatfield",				// FLATFIELD
+	"ratecorrection",			// RATECORRECTION
+	"tau",						// TAU
+	"conttrigen",				// CONTTRIGEN
+	"delbef",					// DELBEF
+	"gateen",					// GATEEN
+	"gates",					// GATES
+	"conttrig",					// CONTTRIG
+	"gate",						// GATE
+	"inpol",					// INPOL
+	"outpol",					// OUTPOL
+	"trig",						// TRIG
+	"trigen",					// TRIGEN
+	"log start",				// LOGSTART
+	"log stop",					// LOGSTOP
+	"log read",					// LOGREAD
+	"testpattern",				// TESTPATTERN
+};
+
+/*
+ * Format the command string into the caller's buffer, which must hold
+ * MaxCmdLength characters. Returns the length of the string.
+ */
+int Camera::formatCmd(char* cmdBuf, Action action, ServerCmd cmd) {
+	static_assert(sizeof(serverCmdNames) / sizeof(*serverCmdNames) == NB_SERVER_CMDS,
+			"serverCmdNames must name every ServerCmd");
+	const char* fmt = (action == Camera::GET) ? "-get %s" : "-%s";
+	int n = snprintf(cmdBuf, MaxCmdLength, fmt, serverCmdNames[cmd]);
+	if (n < 0 || n >= MaxCmdLength) {
+		DEB_MEMBER_FUNCT();
+		THROW_HW_ERROR(Error) << "Command " << serverCmdNames[cmd] << " too long";
+	}
+	return n;
+}
+
 ostream& lima::Mythen3::operator <<(ostream& os, Camera::Polarity const &polarity) {
 	const char* name = "Unknown";
 	switch (polarity) {
@@ -1482,317 +3313,5 @@ ostream& lima::Mythen3::operator <<(ostream& os, Camera::Settings const &setting
  */
 void Camera::simulate(Action action, ServerCmd cmd, uint8_t* recvBuf, int len) {
 	DEB_MEMBER_FUNCT();
-	string assemblyDate = "27-feb-2015 21:08 GMT                             ";
-	static int commandID = 1;
-	static int modnum[] = { 31, 32, 33, 34, 35, 36 };
-	static int module = -1;
-	static int maxModules = 6;
-	static int nmodules = 1;
-	static int sensorMaterial = 0;
-	static int sensorThickness = 320;
-	static int sysNum = 116;
-	static string version = "M3.0.1";
-	static bool badChannelInterpolation = true;
-	static bool flatfieldCorrection = true;
-	static bool rateCorrection = false;
-	static bool triggerMode = false;
-	static bool gate = false;
-	static bool continuousTrigger = false;
-	static float energy[] = { 8.05, 8.05, 8.05, 8.05, 8.05, 8.05 };
-	static float kthresh[] = { 6.4, 6.4, 6.4, 6.4, 6.4, 6.4 };
-	static float tau[] = { 197.6159, 197.6159, 197.6159, 197.6159, 197.6159, 197.6159 };
-	static float energyMax = 40.0;
-	static float energyMin = 4.09;
-	static float kthreshMax = 20.0;
-	static float kthreshMin = 4.0;
-	static int inpol = 0;
-	static int outpol = 0;
-	static int gates = 1;
-	static int zero = 0;
-	static long long delafter = 0;
-	static long long delbef = 0;
-	static long long time = 10000000;
-	static int frames = 1;
-	static int nbits = 24;
-	static int status = 0x10000;
-	static int cutoff = 1280;
-	int length;
-
-	commandID++;
-	int* iptr = reinterpret_cast<int*>(recvBuf);
-	int* bptr = reinterpret_cast<int*>(recvBuf);
-	float* fptr = reinterpret_cast<float*>(recvBuf);
-	long long* llptr = reinterpret_cast<long long*>(recvBuf);
-	char *cptr = reinterpret_cast<char*>(recvBuf);
-	switch (action) {
-	case Camera::GET:
-		DEB_TRACE() << "sendCmd(" << findCmd(action, cmd) << ")";
-		switch (cmd) {
-		case ASSEMBLYDATE:
-			length = assemblyDate.length();
-			memcpy(cptr, assemblyDate.c_str(), assemblyDate.length()-1);
-			*(cptr+assemblyDate.length() - 1) = '\0';
-			break;
-		case BADCHANNELS:
-			for (int i = 0; i < nmodules; i++)
-				for (int j = 0; j < PixelsPerModule; j++)
-					*iptr++ = zero;
-			break;
-		case COMMANDID:
-			iptr[0] = commandID;
-			break;
-		case MODNUM:
-			for (int i = 0; i < nmodules; i++)
-				*iptr++ = modnum[i];
-			break;
-		case MODULE:
-			iptr[0] = module;
-			break;
-		case NMAXMODULES:
-			iptr[0] = maxModules;
-			break;
-		case NMODULES:
-			iptr[0] = nmodules;
-			break;
-		case SENSORMATERIAL:
-			iptr[0] = sensorMaterial;
-			break;
-		case SENSORTHICKNESS:
-			iptr[0] = sensorThickness;
-			break;
-		case SYSTEMNUM:
-			iptr[0] = sysNum;
-			break;
-		case VERSION:
-			memcpy(cptr, version.c_str(), version.length());
-			break;
-		case DELAFTER:
-			llptr[0] = delafter;
-			break;
-		case FRAMES:
-			iptr[0] = frames;
-			break;
-		case NBITS:
-			iptr[0] = nbits;
-			break;
-		case STATUS:
-			iptr[0] = status;
-			break;
-		case TIME:
-			llptr[0] = time;
-			break;
-		case ENERGY:
-			if (module == -1) {
-				for (int i = 0; i < nmodules; i++) {
-					*fptr++ = energy[i];
-				}
-			} else {
-				*fptr = energy[module];
-			}
-			break;
-		case ENERGYMAX:
-			fptr[0] = energyMax;
-			break;
-		case ENERGYMIN:
-			fptr[0] = energyMin;
-			break;
-		case KTHRESH:
-			if (module == -1) {
-				for (int i = 0; i < nmodules; i++) {
-					*fptr++ = kthresh[i];
-				}
-			} else {
-				*fptr = kthresh[module];
-			}
-			break;
-		case KTHRESHMAX:
-			fptr[0] = kthreshMax;
-			break;
-		case KTHRESHMIN:
-			fptr[0] = kthreshMin;
-			break;
-		case BADCHANNELINTERPOLATION:
-			bptr[0] = badChannelInterpolation;
-			break;
-		case FLATFIELDCORRECTION:
-			bptr[0] = flatfieldCorrection;
-			break;
-		case CUTOFF:
-			iptr[0] = cutoff;
-			break;
-		case FLATFIELD:
-			for (int i = 0; i < nmodules; i++)
-				for (int j = 0; j < PixelsPerModule; j++)
-					*iptr++ = j;
-			break;
-		case RATECORRECTION:
-			cout << "rate correction requested" << endl;
-			bptr[0] = rateCorrection;
-			cout << "rate correction got " << bptr[0] << endl;
-			break;
-		case TAU:
-			if (module == -1) {
-				for (int i = 0; i < nmodules; i++) {
-					*fptr++ = tau[i];
-				}
-			} else {
-				*fptr = tau[module];
-			}
-			break;
-		case DELBEF:
-			llptr[0] = delbef;
-			break;
-		case GATES:
-			iptr[0] = gates;
-			break;
-		case CONTTRIG:
-			bptr[0] = continuousTrigger;
-			break;
-		case GATE:
-			bptr[0] = gate;
-			break;
-		case INPOL:
-			iptr[0] = inpol;
-			break;
-		case OUTPOL:
-			iptr[0] = outpol;
-			break;
-		case TRIG:
-			bptr[0] = triggerMode;
-			break;
-		default:
-			THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): cmd unknown. Please report";
-			break;
-		}
-		break;
-	case Camera::SET:
-		DEB_TRACE() << "sendCmd(" << findCmd(action, cmd) << " " << recvBuf
-				<< ")";
-		switch (cmd) {
-		case MODULE:
-			module = iptr[0];
-			break;
-		case NMODULES:
-			nmodules = iptr[0];
-			break;
-		case DELAFTER:
-			delafter = llptr[0];
-			break;
-		case FRAMES:
-			frames = iptr[0];
-			break;
-		case NBITS:
-			nbits = iptr[0];
-			break;
-		case TIME:
-			time = llptr[0];
-			break;
-		case ENERGY:
-			if (module == -1)
-				for (int i = 0; i < nmodules; i++)
-					energy[i] = fptr[0];
-			else
-				energy[module] = fptr[0];
-			break;
-		case KTHRESH:
-			if (module == -1)
-				for (int i = 0; i < nmodules; i++)
-					kthresh[i] = fptr[0];
-			else
-				kthresh[module] = fptr[0];
-			break;
-		case KTHRESHENERGY:
-			if (module == -1) {
-				for (int i = 0; i < nmodules; i++) {
-					kthresh[i] = fptr[0];
-					energy[i] = fptr[1];
-				}
-			} else {
-				kthresh[module] = fptr[0];
-				energy[module] = fptr[1];
-			}
-			break;
-		case SETTINGS:
-			break;
-		case BADCHANNELINTERPOLATION:
-			badChannelInterpolation = bptr[0];
-			break;
-		case FLATFIELDCORRECTION:
-			flatfieldCorrection = bptr[0];
-			break;
-		case RATECORRECTION:
-			rateCorrection = bptr[0];
-			break;
-		case TAU:
-			if (module == -1)
-				for (int i = 0; i < nmodules; i++)
-					tau[i] = fptr[0];
-			else
-				tau[module] = fptr[0];
-			break;
-		case CONTTRIGEN:
-			continuousTrigger = bptr[0];
-			break;
-		case DELBEF:
-			delbef = llptr[0];
-			break;
-		case GATEEN:
-			gate = bptr[0];
-			break;
-		case GATES:
-			gates = iptr[0];
-			break;
-		case INPOL:
-			inpol = iptr[0];
-			break;
-		case OUTPOL:
-			outpol = iptr[0];
-			break;
-		case TRIGEN:
-			triggerMode = bptr[0];
-			break;
-		default:
-			THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): cmd unknown. Please report";
-			break;
-		}
-		break;
-	case Camera::CMD:
-		switch (cmd) {
-		case TESTPATTERN:
-			for (int i = 0; i < nmodules; i++)
-				for (int j = 0; j < PixelsPerModule; j++)
-					*iptr++ = j * 2;
-			break;
-		case RESET:
-			break;
-		case START:
-			status = 0x1;
-			break;
-		case STOP:
-			status = 0x10000;
-			break;
-		case READOUT:
-			for (int i = 0; i < nmodules; i++)
-				for (int j = 0; j < PixelsPerModule; j++)
-					*iptr++ = j * 3;
-			break;
-		case READOUTRAW:
-			for (int i = 0; i < nmodules; i++)
-				for (int j = 0; j < PixelsPerModule; j++)
-					*iptr++ = 0;
-			break;
-		case LOGSTART:
-		case LOGSTOP:
-		case LOGREAD:
-			THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): Not implemented in simulate mode";
-			break;
-		default:
-			THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): ServerCmd unknown. Please report";
-			break;
-		}
-		break;
-	default:
-		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): Action unknown. Please report";
-		break;
-	};
+	m_simulator->exchange(action, cmd, recvBuf, len);
 }
@@ -0,0 +1,113 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3ChannelBinning.h"
+
+using namespace std;
+using namespace lima::Mythen3;
+
+/*
+ * Sum groups of Factor channels, the factor known at compile time so that
+ * the inner loop is unrolled and the groups vectorised
+ */
+template <int Factor>
+static void binBy(const uint32_t* frame, int width, uint32_t* binned) {
+	for (int b = 0; b < width / Factor; b++, frame += Factor) {
+		uint64_t sum = 0;
+		for (int i = 0; i < Factor; i++)
+			sum += frame[i];
+		binned[b] = (sum > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(sum);
+	}
+}
+
+Mythen3ChannelBinning::Mythen3ChannelBinning() :
+		m_factor(1), m_width(0), m_nb_rows(0) {
+}
+
+/*
+ * Set the channels summed per binned channel, validated by the caller; 1
+ * disables the binning. Taken into account at the next startAcq().
+ */
+void Mythen3ChannelBinning::setFactor(int factor) {
+	m_factor = factor;
+}
+
+int Mythen3ChannelBinning::getFactor() const {
+	return m_factor;
+}
+
+bool Mythen3ChannelBinning::isEnabled() const {
+	return m_factor > 1;
+}
+
+/*
+ * Size the ring for nbRows frames of width channels, a multiple of the
+ * factor
+ */
+void Mythen3ChannelBinning::startAcq(int nbRows, int width) {
+	m_width = width / m_factor;
+	m_nb_rows = isEnabled() ? nbRows : 0;
+	m_frames.resize(static_cast<size_t>(m_nb_rows) * m_width);
+}
+
+/*
+ * Bin the decoded frame frameNb into its row of the ring
+ */
+void Mythen3ChannelBinning::compute(long long frameNb, const uint32_t* frame) {
+	if (m_nb_rows == 0)
+		return;
+	bin(frame, m_width * m_factor, m_factor, &m_frames[(frameNb % m_nb_rows) * m_width]);
+}
+
+int Mythen3ChannelBinning::getNbRows() const {
+	return m_nb_rows;
+}
+
+int Mythen3ChannelBinning::getWidth() const {
+	return m_width;
+}
+
+/*
+ * The binned frame frameNb, of the frames still held by the ring
+ */
+const uint32_t* Mythen3ChannelBinning::getRow(long long frameNb) const {
+	return &m_frames[(frameNb % m_nb_rows) * m_width];
+}
+
+/*
+ * Sum groups of factor channels of width channels into binned
+ */
+void Mythen3ChannelBinning::bin(const uint32_t* frame, int width, int factor, uint32_t* binned) {
+	switch (factor) {
+	case 2: binBy<2>(frame, width, binned); break;
+	case 4: binBy<4>(frame, width, binned); break;
+	case 8: binBy<8>(frame, width, binned); break;
+	case 16: binBy<16>(frame, width, binned); break;
+	default:
+		for (int b = 0; b < width / factor; b++, frame += factor) {
+			uint64_t sum = 0;
+			for (int i = 0; i < factor; i++)
+				sum += frame[i];
+			binned[b] = (sum > UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(sum);
+		}
+	}
+}
@@ -0,0 +1,172 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3ChannelStats.h"
+#include <algorithm>
+
+using namespace std;
+using namespace lima::Mythen3;
+
+Mythen3ChannelStats::Mythen3ChannelStats() :
+		m_enabled(false), m_window(0), m_width(0), m_block_frames(0), m_current(0) {
+}
+
+/*
+ * Enable the statistics, taken into account at the next startAcq()
+ */
+void Mythen3ChannelStats::setEnabled(bool enabled) {
+	m_enabled = enabled;
+}
+
+bool Mythen3ChannelStats::isEnabled() const {
+	return m_enabled;
+}
+
+/*
+ * Set the frames of the sliding window, validated by the caller; 0 for the
+ * whole acquisition. Taken into account at the next startAcq().
+ */
+void Mythen3ChannelStats::setWindow(int window) {
+	m_window = window;
+}
+
+int Mythen3ChannelStats::getWindow() const {
+	return m_window;
+}
+
+/*
+ * Clear the statistics of frames of width channels, a multiple of
+ * StatsChunk as the channels of a module are
+ */
+void Mythen3ChannelStats::startAcq(int width) {
+	m_width = m_enabled ? width : 0;
+	m_block_frames = m_window ? max(1, m_window / StatsBlocks) : 0;
+	m_blocks.resize((m_enabled && m_window) ? StatsBlocks + 1 : m_enabled);
+	for (size_t b = 0; b < m_blocks.size(); b++) {
+		Block& block = m_blocks[b];
+		block.nbFrames = 0;
+		block.chunks.resize(m_width / StatsChunk);
+	}
+	m_current = 0;
+}
+
+/*
+ * Account for the decoded frame in the block in progress, starting the next
+ * block, over the oldest one, when it is complete
+ */
+void Mythen3ChannelStats::compute(const uint32_t* frame) {
+	if (m_width == 0)
+		return;
+	Block& block = m_blocks[m_current];
+	Chunk* chunk = &block.chunks[0];
+	int nbChunks = static_cast<int>(block.chunks.size());
+	if (block.nbFrames++ == 0) {
+		for (int k = 0; k < nbChunks; k++, frame += StatsChunk)
+			start(chunk[k], frame);
+	} else {
+		double inv = 1.0 / block.nbFrames;
+		for (int k = 0; k < nbChunks; k++, frame += StatsChunk)
+			update(chunk[k], frame, inv, 1.0 - inv);
+	}
+	if (m_block_frames && block.nbFrames == m_block_frames) {
+		m_current = (m_current + 1) % m_blocks.size();
+		m_blocks[m_current].nbFrames = 0;
+	}
+}
+
+void Mythen3ChannelStats::start(Chunk& chunk, const uint32_t* frame) {
+	for (int c = 0; c < StatsChunk; c++) {
+		chunk.mean[c] = frame[c];
+		chunk.m2[c] = 0;
+		chunk.min[c] = frame[c];
+		chunk.max[c] = frame[c];
+	}
+}
+
+/*
+ * Welford update of a chunk: x - mean after the update is delta * keep,
+ * keep = 1 - inv, so both sums only depend on delta. The counts are
+ * converted through a signed integer with a bias, exactly, as the vector
+ * units convert signed integers only, and their extremes are kept as
+ * doubles, which the base vector instructions compare, unlike unsigned
+ * integers.
+ */
+void Mythen3ChannelStats::update(Chunk& chunk, const uint32_t* frame, double inv, double keep) {
+	for (int c = 0; c < StatsChunk; c++) {
+		double x = static_cast<int32_t>(frame[c] ^ 0x80000000u) + 2147483648.0;
+		double delta = x - chunk.mean[c];
+		chunk.mean[c] += delta * inv;
+		chunk.m2[c] += delta * delta * keep;
+		chunk.min[c] = (x < chunk.min[c]) ? x : chunk.min[c];
+		chunk.max[c] = (x > chunk.max[c]) ? x : chunk.max[c];
+	}
+}
+
+int Mythen3ChannelStats::getWidth() const {
+	return m_width;
+}
+
+long long Mythen3ChannelStats::getNbFrames() const {
+	long long nbFrames = 0;
+	for (size_t b = 0; b < m_blocks.size(); b++)
+		nbFrames += m_blocks[b].nbFrames;
+	return nbFrames;
+}
+
+/*
+ * Merge the blocks into the statistics of each channel; the variance is
+ * that of a sample, 0 below two frames
+ */
+void Mythen3ChannelStats::get(double* mean, double* variance, double* min, double* max) const {
+	vector<double> m2(m_width, 0.0);
+	long long nbFrames = 0;
+	for (size_t b = 0; b < m_blocks.size(); b++) {
+		const Block& block = m_blocks[b];
+		if (block.nbFrames == 0)
+			continue;
+		long long total = nbFrames + block.nbFrames;
+		double weight = static_cast<double>(block.nbFrames) / total;
+		double cross = static_cast<double>(nbFrames) * block.nbFrames / total;
+		for (int c = 0; c < m_width; c++) {
+			const Chunk& chunk = block.chunks[c / StatsChunk];
+			int i = c % StatsChunk;
+			if (nbFrames == 0) {
+				mean[c] = chunk.mean[i];
+				m2[c] = chunk.m2[i];
+				min[c] = chunk.min[i];
+				max[c] = chunk.max[i];
+				continue;
+			}
+			double delta = chunk.mean[i] - mean[c];
+			mean[c] += delta * weight;
+			m2[c] += chunk.m2[i] + delta * delta * cross;
+			min[c] = std::min(min[c], chunk.min[i]);
+			max[c] = std::max(max[c], chunk.max[i]);
+		}
+		nbFrames = total;
+	}
+	for (int c = 0; c < m_width; c++) {
+		if (nbFrames == 0)
+			mean[c] = min[c] = max[c] = 0;
+		variance[c] = (nbFrames > 1) ? m2[c] / (nbFrames - 1) : 0;
+	}
+}
@@ -0,0 +1,365 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "lima/Exceptions.h"
+#include "Mythen3Composite.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+/*
+ * Worker of one system: runs each operation posted to the composite on its
+ * camera, concurrently with the workers of the other systems
+ */
+class Mythen3Composite::SystemThread: public Thread {
+public:
+	SystemThread(Mythen3Composite& composite, int system) :
+			m_composite(composite), m_system(system) {}
+
+protected:
+	virtual void threadFunction();
+
+private:
+	Mythen3Composite& m_composite;
+	int m_system;
+};
+
+void Mythen3Composite::SystemThread::threadFunction() {
+	AutoMutex lock(m_composite.m_cond.mutex());
+	long long done = 0; // an operation may be posted before the thread runs
+	while (true) {
+		while (done == m_composite.m_op_nb && !m_composite.m_quit)
+			m_composite.m_cond.wait();
+		if (m_composite.m_quit)
+			return;
+		done = m_composite.m_op_nb;
+		Op op = m_composite.m_op;
+		double value = m_composite.m_value;
+		string error;
+		lock.unlock();
+		try {
+			m_composite.runOp(m_system, op, value);
+		} catch (Exception& e) {
+			ostringstream os;
+			os << e;
+			error = os.str();
+		}
+		lock.lock();
+		m_composite.m_errors[m_system] = error;
+		if (--m_composite.m_pending == 0)
+			m_composite.m_cond.broadcast();
+	}
+}
+
+Mythen3Composite::Mythen3Composite(const vector<string>& hostnames, int tcpPort, bool simulate) :
+		m_hostnames(hostnames), m_widths(hostnames.size(), 0), m_errors(hostnames.size()),
+		m_nb_buffers(1), m_op(OP_RESET), m_value(0), m_op_nb(0), m_pending(0), m_quit(false) {
+	DEB_CONSTRUCTOR();
+	if (hostnames.empty()) {
+		THROW_HW_ERROR(InvalidValue) << "No Mythen3 system given";
+	}
+	try {
+		for (size_t s = 0; s < hostnames.size(); s++) {
+			DEB_TRACE() << "Mythen3 system " << s << " on " << hostnames[s];
+			string hostname = hostnames[s];
+			int port = tcpPort;
+			size_t colon = hostname.rfind(':');
+			if (colon != string::npos) {
+				port = atoi(hostname.c_str() + colon + 1);
+				hostname.erase(colon);
+			}
+			m_cameras.push_back(new Camera(hostname, port, simulate));
+		}
+	} catch (...) {
+		for (size_t s = 0; s < m_cameras.size(); s++)
+			delete m_cameras[s];
+		throw;
+	}
+	for (size_t s = 0; s < m_cameras.size(); s++) {
+		m_threads.push_back(new SystemThread(*this, s));
+		m_threads[s]->start();
+	}
+}
+
+Mythen3Composite::~Mythen3Composite() {
+	DEB_DESTRUCTOR();
+	AutoMutex lock(m_cond.mutex());
+	m_quit = true;
+	m_cond.broadcast();
+	lock.unlock();
+	for (size_t s = 0; s < m_threads.size(); s++) {
+		m_threads[s]->join();
+		delete m_threads[s];
+	}
+	for (size_t s = 0; s < m_cameras.size(); s++) {
+		m_cameras[s]->stopAcq();
+		delete m_cameras[s];
+	}
+}
+
+int Mythen3Composite::getNbSystems() const {
+	return m_cameras.size();
+}
+
+Camera& Mythen3Composite::getCamera(int system) {
+	DEB_MEMBER_FUNCT();
+	if (system < 0 || system >= getNbSystems()) {
+		THROW_HW_ERROR(InvalidValue) << "No Mythen3 system " << system;
+	}
+	return *m_cameras[system];
+}
+
+void Mythen3Composite::reset() {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_RESET);
+}
+
+/*
+ * Apply the configuration of all the systems in parallel and size their
+ * frames from their number of modules
+ */
+void Mythen3Composite::prepareAcq() {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_PREPARE);
+}
+
+/*
+ * The acquisition threads of the systems send their START commands
+ * concurrently
+ */
+void Mythen3Composite::startAcq() {
+	DEB_MEMBER_FUNCT();
+	for (size_t s = 0; s < m_cameras.size(); s++)
+		m_cameras[s]->startAcq();
+}
+
+void Mythen3Composite::stopAcq() {
+	DEB_MEMBER_FUNCT();
+	for (size_t s = 0; s < m_cameras.size(); s++)
+		m_cameras[s]->stopAcq();
+}
+
+bool Mythen3Composite::isAcqRunning() {
+	for (size_t s = 0; s < m_cameras.size(); s++)
+		if (m_cameras[s]->isAcqRunning())
+			return true;
+	return false;
+}
+
+/*
+ * Frames acquired by every system
+ */
+int Mythen3Composite::getNbAcquiredFrames() {
+	int nb_frames = m_cameras[0]->getNbHwAcquiredFrames();
+	for (size_t s = 1; s < m_cameras.size(); s++)
+		nb_frames = min(nb_frames, m_cameras[s]->getNbHwAcquiredFrames());
+	return nb_frames;
+}
+
+/*
+ * Throw if the systems are no longer in step: a system aborted its
+ * acquisition, a system is ahead of another by more than the ring size, so
+ * that its frames are overwritten before they can be stitched, or the
+ * acquisition ended with different numbers of frames.
+ */
+void Mythen3Composite::checkFrames() {
+	DEB_MEMBER_FUNCT();
+	bool running = false;
+	int first = 0, last = 0;
+	for (size_t s = 0; s < m_cameras.size(); s++) {
+		int nb_frames = m_cameras[s]->getNbHwAcquiredFrames();
+		if (m_cameras[s]->isAcqFailed()) {
+			THROW_HW_ERROR(Error) << "Mythen3 system " << s << " (" << m_hostnames[s]
+					<< ") aborted after " << nb_frames << " frames";
+		}
+		running |= m_cameras[s]->isAcqRunning();
+		if (nb_frames < m_cameras[first]->getNbHwAcquiredFrames())
+			first = s;
+		if (nb_frames > m_cameras[last]->getNbHwAcquiredFrames())
+			last = s;
+	}
+	int lag = m_cameras[last]->getNbHwAcquiredFrames() - m_cameras[first]->getNbHwAcquiredFrames();
+	if (lag > m_nb_buffers || (!running && lag > 0)) {
+		THROW_HW_ERROR(Error) << "Mythen3 systems out of step: system " << last << " ("
+				<< m_hostnames[last] << ") is " << lag << " frames ahead of system " << first
+				<< " (" << m_hostnames[first] << ")";
+	}
+}
+
+void Mythen3Composite::setTrigMode(TrigMode mode) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_TRIG_MODE, mode);
+}
+
+void Mythen3Composite::setExpTime(double exp_time) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_EXP_TIME, exp_time);
+}
+
+void Mythen3Composite::setLatTime(double lat_time) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_LAT_TIME, lat_time);
+}
+
+void Mythen3Composite::setNbFrames(int nb_frames) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_NB_FRAMES, nb_frames);
+}
+
+void Mythen3Composite::setNbits(Camera::Nbits nbits) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_NBITS, nbits);
+}
+
+void Mythen3Composite::setUseRawReadout(Camera::Switch enable) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_USE_RAW, enable);
+}
+
+/*
+ * Size of the frame ring of each system. A system may run ahead of the
+ * others by less than this number of frames.
+ */
+void Mythen3Composite::setNbBuffers(int nb_buffers) {
+	DEB_MEMBER_FUNCT();
+	runAll(OP_NB_BUFFERS, nb_buffers);
+	m_nb_buffers = nb_buffers;
+}
+
+/*
+ * Width of the stitched frame as of the last prepareAcq()
+ */
+void Mythen3Composite::getWidth(int& width) {
+	width = 0;
+	for (size_t s = 0; s < m_widths.size(); s++)
+		width += m_widths[s];
+}
+
+/*
+ * Stitch frame frame_nb of all the systems, checking that each of them
+ * returns that frame
+ */
+void Mythen3Composite::readFrame(Data& data, int frame_nb) {
+	DEB_MEMBER_FUNCT();
+	checkFrames();
+	if (frame_nb >= getNbAcquiredFrames()) {
+		THROW_HW_ERROR(Error) << "Frame not available yet";
+	}
+	int width;
+	getWidth(width);
+	Buffer* buffer = new Buffer(width * sizeof(uint32_t));
+	uint8_t* ptr = reinterpret_cast<uint8_t*>(buffer->data);
+	try {
+		for (size_t s = 0; s < m_cameras.size(); s++) {
+			Data part;
+			m_cameras[s]->readFrame(part, frame_nb);
+			if (part.frameNumber != frame_nb || part.dimensions[0] != m_widths[s]) {
+				THROW_HW_ERROR(Error) << "Mythen3 system " << s << " (" << m_hostnames[s]
+						<< ") returned frame " << part.frameNumber << " of width "
+						<< part.dimensions[0] << " for frame " << frame_nb;
+			}
+			memcpy(ptr, part.data(), m_widths[s] * sizeof(uint32_t));
+			ptr += m_widths[s] * sizeof(uint32_t);
+		}
+	} catch (...) {
+		buffer->unref();
+		throw;
+	}
+	data.type = Data::UINT32;
+	data.dimensions.clear();
+	data.dimensions.push_back(width);
+	data.frameNumber = frame_nb;
+	data.setBuffer(buffer);
+	buffer->unref();
+}
+
+/*
+ * Post an operation to the workers of all the systems and wait for its
+ * completion. The failures of all the systems are reported together.
+ */
+void Mythen3Composite::runAll(Op op, double value) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex lock(m_cond.mutex());
+	m_op = op;
+	m_value = value;
+	m_pending = m_cameras.size();
+	m_op_nb++;
+	m_cond.broadcast();
+	while (m_pending > 0)
+		m_cond.wait();
+	ostringstream errors;
+	for (size_t s = 0; s < m_errors.size(); s++)
+		if (!m_errors[s].empty())
+			errors << " system " << s << " (" << m_hostnames[s] << "): " << m_errors[s];
+	if (!errors.str().empty()) {
+		THROW_HW_ERROR(Error) << "Mythen3 systems failed:" << errors.str();
+	}
+}
+
+/*
+ * Run an operation on one system, in its worker thread
+ */
+void Mythen3Composite::runOp(int system, Op op, double value) {
+	DEB_MEMBER_FUNCT();
+	Camera& cam = *m_cameras[system];
+	switch (op) {
+	case OP_RESET:
+		cam.stopAcq();
+		cam.reset();
+		break;
+	case OP_PREPARE: {
+		Size size;
+		cam.getDetectorImageSize(size);
+		ImageType type;
+		cam.getImageType(type);
+		cam.getBufferCtrlObj()->setFrameDim(FrameDim(size, type));
+		cam.prepareAcq();
+		m_widths[system] = size.getWidth();
+		break;
+	}
+	case OP_TRIG_MODE:
+		cam.setTrigMode(static_cast<TrigMode>(value));
+		break;
+	case OP_EXP_TIME:
+		cam.setExpTime(value);
+		break;
+	case OP_LAT_TIME:
+		cam.setLatTime(value);
+		break;
+	case OP_NB_FRAMES:
+		cam.setNbFrames(static_cast<int>(value));
+		break;
+	case OP_NBITS:
+		cam.setNbits(static_cast<Camera::Nbits>(static_cast<int>(value)));
+		break;
+	case OP_USE_RAW:
+		cam.setUseRawReadout(static_cast<Camera::Switch>(static_cast<int>(value)));
+		break;
+	case OP_NB_BUFFERS:
+		cam.getBufferCtrlObj()->setNbBuffers(static_cast<int>(value));
+		break;
+	}
+}
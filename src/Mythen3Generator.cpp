@@ -0,0 +1,198 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <cmath>
+#include "Mythen3Generator.h"
+
+using namespace std;
+using namespace lima::Mythen3;
+
+static const float FwhmToSigma = 1.0f / 2.3548200f;
+static const int MaxLowCounts = 64; // inversion limit, P(k > 64) < 1e-20 below PoissonNormalMin
+
+/*
+ * splitmix64 finalizer: a well mixed 64 bit value per counter, with no
+ * state carried from one channel to the next
+ */
+static inline uint64_t mix(uint64_t z) {
+	z += 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static inline float uniform(uint64_t r) {
+	return (r >> 40) * (1.0f / 16777216.0f);
+}
+
+/*
+ * The default pattern has a peak every GeneratorPeakSpacing channels, with
+ * positions, widths and heights drawn from the seed
+ */
+Mythen3Generator::Mythen3Generator(int nbChannels, uint64_t seed) :
+		m_nb_channels(nbChannels), m_seed(seed), m_background(GeneratorBackground),
+		m_dead_fraction(GeneratorDeadFraction), m_hot_fraction(GeneratorHotFraction),
+		m_updated(false) {
+	// normal quantiles of the centres of NormalTableSize equal probability bins
+	for (int k = 0; k < NormalTableSize; k++) {
+		double p = (k + 0.5) / NormalTableSize;
+		double low = -10, high = 10;
+		for (int it = 0; it < 60; it++) {
+			double x = 0.5 * (low + high);
+			if (0.5 * erfc(-x / sqrt(2.0)) < p)
+				low = x;
+			else
+				high = x;
+		}
+		m_normal[k] = 0.5 * (low + high);
+	}
+	uint64_t key = mix(m_seed ^ 0x7065616bULL);
+	for (int p = GeneratorPeakSpacing / 2; p < m_nb_channels; p += GeneratorPeakSpacing) {
+		float position = p + (uniform(mix(key + 3 * p)) - 0.5f) * GeneratorPeakSpacing * 0.5f;
+		float fwhm = 3.0f + 5.0f * uniform(mix(key + 3 * p + 1));
+		float height = 200.0f * exp(3.2f * uniform(mix(key + 3 * p + 2)));
+		addPeak(position, fwhm, height);
+	}
+}
+
+/*
+ * Background counts at the first channel, falling to half at the last one
+ */
+void Mythen3Generator::setBackground(float level) {
+	m_background = level;
+	m_updated = false;
+}
+
+void Mythen3Generator::clearPeaks() {
+	m_peaks.clear();
+	m_updated = false;
+}
+
+void Mythen3Generator::addPeak(float position, float fwhm, float height) {
+	Peak peak = { position, fwhm, height };
+	m_peaks.push_back(peak);
+	m_updated = false;
+}
+
+/*
+ * Fractions of the channels that count nothing and of those that count
+ * HotChannelCounts, chosen from the seed
+ */
+void Mythen3Generator::setBadChannels(float deadFraction, float hotFraction) {
+	m_dead_fraction = deadFraction;
+	m_hot_fraction = hotFraction;
+	m_updated = false;
+}
+
+void Mythen3Generator::getMean(vector<float>& mean) {
+	if (!m_updated)
+		update();
+	mean = m_mean;
+}
+
+int Mythen3Generator::getNbChannels() const {
+	return m_nb_channels;
+}
+
+/*
+ * Draw the counts of frame frameNb for the first nbChannels channels
+ */
+void Mythen3Generator::generate(uint32_t* counts, int nbChannels, long long frameNb) {
+	if (!m_updated)
+		update();
+	if (nbChannels > m_nb_channels)
+		nbChannels = m_nb_channels;
+	uint64_t key = mix(m_seed + static_cast<uint64_t>(frameNb) * 0x9e3779b97f4a7c15ULL);
+	const float* mean = &m_mean[0];
+	const float* sigma = &m_sigma[0];
+	const float* normal = m_normal;
+	// one hash gives the normal deviates of 4 channels
+	int i = 0;
+	for (; i + 4 <= nbChannels; i += 4) {
+		uint64_t r = mix(key + i);
+		float x0 = mean[i] + sigma[i] * normal[r & (NormalTableSize - 1)] + 0.5f;
+		float x1 = mean[i + 1] + sigma[i + 1] * normal[(r >> 16) & (NormalTableSize - 1)] + 0.5f;
+		float x2 = mean[i + 2] + sigma[i + 2] * normal[(r >> 32) & (NormalTableSize - 1)] + 0.5f;
+		float x3 = mean[i + 3] + sigma[i + 3] * normal[(r >> 48) & (NormalTableSize - 1)] + 0.5f;
+		counts[i] = (x0 > 0.0f) ? uint32_t(x0) : 0;
+		counts[i + 1] = (x1 > 0.0f) ? uint32_t(x1) : 0;
+		counts[i + 2] = (x2 > 0.0f) ? uint32_t(x2) : 0;
+		counts[i + 3] = (x3 > 0.0f) ? uint32_t(x3) : 0;
+	}
+	for (uint64_t r = mix(key + i); i < nbChannels; i++, r >>= 16) {
+		float x = mean[i] + sigma[i] * normal[r & (NormalTableSize - 1)] + 0.5f;
+		counts[i] = (x > 0.0f) ? uint32_t(x) : 0;
+	}
+	uint64_t lowKey = ~key;
+	for (size_t j = 0; j < m_low.size(); j++) {
+		int i = m_low[j];
+		if (i >= nbChannels)
+			break;
+		float u = uniform(mix(lowKey + i));
+		float p = m_low_exp[j];
+		float cdf = p;
+		uint32_t k = 0;
+		while (u > cdf && k < MaxLowCounts) {
+			k++;
+			p *= m_mean[i] / k;
+			cdf += p;
+		}
+		counts[i] = k;
+	}
+}
+
+/*
+ * Recompute the mean pattern and the tables of the generation
+ */
+void Mythen3Generator::update() {
+	m_mean.resize(m_nb_channels);
+	m_sigma.resize(m_nb_channels);
+	for (int i = 0; i < m_nb_channels; i++)
+		m_mean[i] = m_background * (1.0f - 0.5f * i / m_nb_channels);
+	for (size_t p = 0; p < m_peaks.size(); p++) {
+		float sigma = m_peaks[p].fwhm * FwhmToSigma;
+		int first = static_cast<int>(floor(m_peaks[p].position - 5 * sigma));
+		int last = static_cast<int>(ceil(m_peaks[p].position + 5 * sigma));
+		for (int i = (first < 0) ? 0 : first; i <= last && i < m_nb_channels; i++) {
+			float d = (i - m_peaks[p].position) / sigma;
+			m_mean[i] += m_peaks[p].height * exp(-0.5f * d * d);
+		}
+	}
+	uint64_t key = mix(m_seed ^ 0x626164ULL);
+	for (int i = 0; i < m_nb_channels; i++) {
+		float u = uniform(mix(key + i));
+		if (u < m_dead_fraction || m_mean[i] < 0.0f)
+			m_mean[i] = 0.0f;
+		else if (u < m_dead_fraction + m_hot_fraction)
+			m_mean[i] = HotChannelCounts;
+	}
+	m_low.clear();
+	m_low_exp.clear();
+	for (int i = 0; i < m_nb_channels; i++) {
+		m_sigma[i] = sqrt(m_mean[i]);
+		if (m_mean[i] < PoissonNormalMin) {
+			m_low.push_back(i);
+			m_low_exp.push_back(exp(-m_mean[i]));
+		}
+	}
+	m_updated = true;
+}
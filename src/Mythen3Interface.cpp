@@ -242,11 +242,14 @@ void Interface::stopAcq() {
 
 void Interface::getStatus(StatusType& status) {
 	DEB_MEMBER_FUNCT();
-	status.acq = m_cam.isAcqRunning() ? AcqRunning : AcqReady;
+	if (m_cam.isAcqRunning())
+		status.acq = AcqRunning;
+	else
+		status.acq = m_cam.isAcqFailed() ? AcqFault : AcqReady;
 	status.det_mask = DetExposure | DetReadout | DetLatency;
 }
 
 int Interface::getNbHwAcquiredFrames() {
 	DEB_MEMBER_FUNCT();
-	return getNbHwAcquiredFrames();
+	return m_cam.getNbHwAcquiredFrames();
 }
@@ -0,0 +1,287 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sstream>
+
+#include "Mythen3Metrics.h"
+#include "lima/Exceptions.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+Mythen3Metrics::Mythen3Metrics() :
+		m_acquisitions(0), m_frames(0), m_bytes(0), m_readout_ns(0), m_decode_ns(0),
+		m_decoded_frames(0), m_overruns(0), m_view_copies(0), m_acq_frames(0), m_last_read(-1), m_ring_size(0),
+		m_rate_time(now()), m_rate_frames(0), m_rate_bytes(0) {
+}
+
+long long Mythen3Metrics::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void Mythen3Metrics::startAcq(int ringSize) {
+	m_acquisitions.fetch_add(1, memory_order_relaxed);
+	m_acq_frames.store(0, memory_order_relaxed);
+	m_last_read.store(-1, memory_order_relaxed);
+	m_ring_size.store(ringSize, memory_order_relaxed);
+}
+
+/*
+ * Count frame frameNb of the current acquisition, read out in readoutNs and
+ * decoded in decodeNs, 0 if the detector sent it decoded
+ */
+void Mythen3Metrics::frameAcquired(long long frameNb, int bytes, long long readoutNs, long long decodeNs) {
+	m_frames.fetch_add(1, memory_order_relaxed);
+	m_bytes.fetch_add(bytes, memory_order_relaxed);
+	m_readout_ns.fetch_add(readoutNs, memory_order_relaxed);
+	if (decodeNs > 0) {
+		m_decode_ns.fetch_add(decodeNs, memory_order_relaxed);
+		m_decoded_frames.fetch_add(1, memory_order_relaxed);
+	}
+	m_acq_frames.store(frameNb + 1, memory_order_relaxed);
+	long long overwritten = frameNb - m_ring_size.load(memory_order_relaxed);
+	long long lastRead = m_last_read.load(memory_order_relaxed);
+	if (overwritten >= 0 && lastRead >= 0 && lastRead < overwritten)
+		m_overruns.fetch_add(1, memory_order_relaxed);
+}
+
+/*
+ * Frames up to lastFrameNb of the current acquisition have been read back
+ */
+void Mythen3Metrics::framesRead(long long lastFrameNb) {
+	long long last = m_last_read.load(memory_order_relaxed);
+	while (lastFrameNb > last && !m_last_read.compare_exchange_weak(last, lastFrameNb, memory_order_relaxed))
+		;
+}
+
+/*
+ * A frame view was still held when the ring was about to wrap over it
+ */
+void Mythen3Metrics::viewDetached() {
+	m_view_copies.fetch_add(1, memory_order_relaxed);
+}
+
+static void addMetric(ostringstream& out, const char* name, const char* type, const char* help, double value) {
+	out << "# HELP " << name << " " << help << "\n";
+	out << "# TYPE " << name << " " << type << "\n";
+	out << name << " " << value << "\n";
+}
+
+void Mythen3Metrics::formatText(string& text) {
+	long long frames = m_frames.load(memory_order_relaxed);
+	long long bytes = m_bytes.load(memory_order_relaxed);
+	long long decodedFrames = m_decoded_frames.load(memory_order_relaxed);
+	long long acqFrames = m_acq_frames.load(memory_order_relaxed);
+	long long lastRead = m_last_read.load(memory_order_relaxed);
+	int ringSize = m_ring_size.load(memory_order_relaxed);
+
+	double frameRate, byteRate;
+	{
+		AutoMutex aLock(m_rate_mutex);
+		long long t = now();
+		double elapsed = (t - m_rate_time) * 1e-9;
+		frameRate = (elapsed > 0) ? (frames - m_rate_frames) / elapsed : 0;
+		byteRate = (elapsed > 0) ? (bytes - m_rate_bytes) / elapsed : 0;
+		m_rate_time = t;
+		m_rate_frames = frames;
+		m_rate_bytes = bytes;
+	}
+	long long unread = acqFrames - (lastRead + 1);
+	long long occupancy = (unread < 0) ? 0 : (unread > ringSize) ? ringSize : unread;
+
+	ostringstream out;
+	out.precision(15);
+	addMetric(out, "mythen3_acquisitions_total", "counter", "Acquisitions started",
+			m_acquisitions.load(memory_order_relaxed));
+	addMetric(out, "mythen3_frames_total", "counter", "Frames read out", frames);
+	addMetric(out, "mythen3_bytes_total", "counter", "Frame bytes read out", bytes);
+	addMetric(out, "mythen3_frame_rate", "gauge", "Frames per second since the previous export", frameRate);
+	addMetric(out, "mythen3_throughput_megabytes", "gauge", "Frame MB per second since the previous export",
+			byteRate * 1e-6);
+	addMetric(out, "mythen3_readout_seconds_total", "counter", "Time spent reading out frames",
+			m_readout_ns.load(memory_order_relaxed) * 1e-9);
+	addMetric(out, "mythen3_decode_seconds_total", "counter", "Time spent decoding raw frames",
+			m_decode_ns.load(memory_order_relaxed) * 1e-9);
+	addMetric(out, "mythen3_decoded_frames_total", "counter", "Raw frames decoded", decodedFrames);
+	addMetric(out, "mythen3_decode_ns_per_frame", "gauge", "Average decode time of a raw frame",
+			decodedFrames ? double(m_decode_ns.load(memory_order_relaxed)) / decodedFrames : 0);
+	addMetric(out, "mythen3_ring_size", "gauge", "Frames in the buffer ring", ringSize);
+	addMetric(out, "mythen3_ring_occupancy", "gauge", "Frames in the buffer ring not read back yet", occupancy);
+	addMetric(out, "mythen3_overruns_total", "counter", "Frames overwritten before being read back",
+			m_overruns.load(memory_order_relaxed));
+	addMetric(out, "mythen3_view_copies_total", "counter", "Frame views copied before the ring wrapped over them",
+			m_view_copies.load(memory_order_relaxed));
+	text = out.str();
+}
+
+class Mythen3MetricsExporter::ExportThread: public Thread {
+public:
+	ExportThread(Mythen3MetricsExporter& exporter) : m_exporter(exporter) {}
+
+protected:
+	virtual void threadFunction() {
+		m_exporter.run();
+	}
+
+private:
+	Mythen3MetricsExporter& m_exporter;
+};
+
+Mythen3MetricsExporter::Mythen3MetricsExporter(Mythen3Metrics& metrics, const string& target, double period) :
+		m_metrics(metrics), m_target(target), m_period(period), m_listen(-1), m_thread(0) {
+	DEB_CONSTRUCTOR();
+	DEB_PARAM() << DEB_VAR2(target, period);
+	if (period <= 0) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid metrics export period " << period;
+	}
+	int prefixLength = sizeof(MetricsSocketPrefix) - 1;
+	if (target.compare(0, prefixLength, MetricsSocketPrefix) == 0) {
+		m_socket_path = target.substr(prefixLength);
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (m_socket_path.empty() || m_socket_path.size() >= sizeof(addr.sun_path)) {
+			THROW_HW_ERROR(InvalidValue) << "Invalid metrics socket path " << m_socket_path;
+		}
+		strcpy(addr.sun_path, m_socket_path.c_str());
+		m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_listen < 0) {
+			THROW_HW_ERROR(Error) << "Cannot create the metrics socket: " << strerror(errno);
+		}
+		unlink(m_socket_path.c_str());
+		if (bind(m_listen, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(m_listen, MetricsSocketBacklog) < 0) {
+			int err = errno;
+			close(m_listen);
+			THROW_HW_ERROR(Error) << "Cannot listen on " << m_socket_path << ": " << strerror(err);
+		}
+	}
+	if (pipe(m_stop_pipe) < 0) {
+		int err = errno;
+		if (m_listen >= 0) {
+			close(m_listen);
+			unlink(m_socket_path.c_str());
+		}
+		THROW_HW_ERROR(Error) << "Cannot create the metrics export pipe: " << strerror(err);
+	}
+	m_thread = new ExportThread(*this);
+	m_thread->start();
+}
+
+Mythen3MetricsExporter::~Mythen3MetricsExporter() {
+	DEB_DESTRUCTOR();
+	char stop = 0;
+	if (write(m_stop_pipe[1], &stop, 1) != 1) {
+		DEB_ERROR() << "Cannot stop the metrics export thread";
+	}
+	m_thread->join();
+	delete m_thread;
+	close(m_stop_pipe[0]);
+	close(m_stop_pipe[1]);
+	if (m_listen >= 0) {
+		close(m_listen);
+		unlink(m_socket_path.c_str());
+	}
+}
+
+/*
+ * Export thread: write the file every period, or serve the connections to
+ * the socket as they come, until the stop pipe is written
+ */
+void Mythen3MetricsExporter::run() {
+	DEB_MEMBER_FUNCT();
+	struct pollfd fds[2];
+	fds[0].fd = m_stop_pipe[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = m_listen;
+	fds[1].events = POLLIN;
+	int nfds = (m_listen >= 0) ? 2 : 1;
+	int timeout = (m_listen >= 0) ? -1 : static_cast<int>(m_period * 1000);
+	for (;;) {
+		if (m_listen < 0)
+			writeFile();
+		int rc = poll(fds, nfds, timeout);
+		if (rc < 0 && errno != EINTR) {
+			DEB_ERROR() << "Metrics export stopped: " << strerror(errno);
+			return;
+		}
+		if (rc > 0 && fds[0].revents)
+			return;
+		if (rc > 0 && nfds == 2 && (fds[1].revents & POLLIN)) {
+			int client = accept(m_listen, 0, 0);
+			if (client >= 0)
+				serve(client);
+		}
+	}
+}
+
+void Mythen3MetricsExporter::writeFile() {
+	DEB_MEMBER_FUNCT();
+	string text;
+	m_metrics.formatText(text);
+	string tmpName = m_target + ".tmp";
+	FILE* file = fopen(tmpName.c_str(), "w");
+	if (!file) {
+		DEB_ERROR() << "Cannot create " << tmpName << ": " << strerror(errno);
+		return;
+	}
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	if (fclose(file) != 0 || !written || rename(tmpName.c_str(), m_target.c_str()) != 0) {
+		DEB_ERROR() << "Cannot write " << m_target;
+		unlink(tmpName.c_str());
+	}
+}
+
+/*
+ * Answer a connection with the metrics whatever it asks: the request is not
+ * read, a scraper sending one gets it discarded when the socket is closed.
+ */
+void Mythen3MetricsExporter::serve(int client) {
+	DEB_MEMBER_FUNCT();
+	string text;
+	m_metrics.formatText(text);
+	ostringstream response;
+	response << "HTTP/1.0 200 OK\r\n"
+			<< "Content-Type: text/plain; version=0.0.4\r\n"
+			<< "Content-Length: " << text.size() << "\r\n\r\n" << text;
+	string data = response.str();
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			DEB_WARNING() << "Metrics not sent: " << strerror(errno);
+			break;
+		}
+		sent += n;
+	}
+	close(client);
+}
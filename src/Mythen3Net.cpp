@@ -20,13 +20,18 @@
 // along with this program; if not, see <http://www.gnu.org/licenses/>.
 //###########################################################################
 
+#include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/time.h>
+#include <time.h>
+#include <errno.h>
 
 #include "Mythen3Net.h"
+#include "Mythen3Trace.h"
 #include "lima/ThreadUtils.h"
 #include "lima/Exceptions.h"
 #include "lima/Debug.h"
@@ -35,6 +40,29 @@ using namespace std;
 using namespace lima;
 using namespace lima::Mythen3;
 
+/*
+ * Traffic recording format, in host byte order:
+ *   file header  char magic[8] = "M3TRAF02"
+ *   each record  int64 send time (ns since the start of the recording)
+ *                int64 delay until the reply was complete (ns)
+ *                uint16 command length, uint32 reply length
+ *                command bytes, reply bytes
+ * The send times are kept for offline analysis only: the replay is paced
+ * by the commands of its client and reproduces the reply delays, not the
+ * gaps between the recorded commands.
+ */
+static const char RecordMagic[8] = {'M', '3', 'T', 'R', 'A', 'F', '0', '2'};
+static const size_t RecordDelayOffset = 8;
+static const size_t RecordCmdLenOffset = 16;
+static const size_t RecordReplyLenOffset = 18;
+static const size_t RecordHeaderSize = 22;
+
+static long long monotonicNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 Mythen3Net::Mythen3Net() {
 	DEB_CONSTRUCTOR();
 	// Ignore the sigpipe we get we try to send quit to
@@ -45,11 +73,25 @@ Mythen3Net::Mythen3Net() {
 	pipe_act.sa_handler = SIG_IGN;
 	sigaction(SIGPIPE, &pipe_act, 0);
 	m_connected = false;
+	m_pipelining = false;
+	m_port = -1;
+	m_rcvbuf = 0;
+	m_quick_ack = false;
+	m_busy_poll = 0;
+	m_read_timeout = 0;
+	m_stats = 0;
+	m_cmd_reads = 0;
+	m_record_file = 0;
+	m_record_start = 0;
+	m_replaying = false;
+	m_replay_speed = 1.0;
+	m_replay_pos = 0;
 	m_sock = -1;
 }
 
 Mythen3Net::~Mythen3Net() {
 	DEB_DESTRUCTOR();
+	stopRecording();
 	disconnectFromServer();
 }
 
@@ -62,6 +104,8 @@ void Mythen3Net::connectToServer(const string hostname, int port) {
 	if (m_connected) {
 		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Already connected to server";
 	}
+	m_hostname = hostname;
+	m_port = port;
 	if ((host = gethostbyname(hostname.c_str())) == 0) {
 		endhostent();
 		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't get gethostbyname";
@@ -75,20 +119,35 @@ void Mythen3Net::connectToServer(const string hostname, int port) {
 	size_t len = host->h_length;
 	memcpy(&m_remote_addr.sin_addr.s_addr, host->h_addr, len);
 	endhostent();
+	if (m_rcvbuf > 0 && setsockopt(m_sock, SOL_SOCKET, SO_RCVBUF, &m_rcvbuf, sizeof(m_rcvbuf)) < 0) {
+		close(m_sock);
+		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't set SO_RCVBUF to " << m_rcvbuf;
+	}
 	if (connect(m_sock, (struct sockaddr *) &m_remote_addr, sizeof(struct sockaddr_in)) == -1) {
 		close(m_sock);
 		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Connection to server refused. Is the server running?";
 	}
 	protocol = getprotobyname("tcp");
 	if (protocol == 0) {
+		close(m_sock);
 		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't get protocol TCP";
 	} else {
 		opt = 1;
 		if (setsockopt(m_sock, protocol->p_proto, TCP_NODELAY, (char *) &opt, 4) < 0) {
+			close(m_sock);
 			THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't set socket options";
 		}
 	}
 	endprotoent();
+	if (!setKeepAliveOptions() || !setReadTimeoutOption(m_read_timeout)) {
+		close(m_sock);
+		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't set socket timeouts";
+	}
+	if (m_busy_poll > 0 && !setBusyPollOption(m_busy_poll)) {
+		close(m_sock);
+		THROW_HW_ERROR(Error) << "Mythen3Net::connectToServer(): Can't set SO_BUSY_POLL to "
+				<< m_busy_poll << " (needs CAP_NET_ADMIN)";
+	}
 	m_connected = true;
 }
 
@@ -98,32 +157,599 @@ void Mythen3Net::disconnectFromServer() {
 		shutdown(m_sock, 2);
 		close(m_sock);
 		m_connected = false;
+		m_replaying = false;
 	}
 }
 
-void Mythen3Net::sendCmd(string cmd, uint8_t* recvBuf, int len) {
+/*
+ * Re-establish a lost connection to the last server, retrying with an
+ * exponential backoff. Throws if the server is still unreachable after
+ * MaxReconnectRetries further attempts. The lock is released during the
+ * backoff so that isConnected() and the status polls are not held up.
+ */
+void Mythen3Net::reconnect() {
 	DEB_MEMBER_FUNCT();
-	DEB_TRACE() << "Mythen3Net::sendCmd(" << cmd << ")";
+	AutoMutex aLock(m_cond.mutex());
+	disconnectFromServer();
+	double delay = ReconnectDelay;
+	for (int retry = 0;; retry++) {
+		try {
+			connectToServer(m_hostname, m_port);
+			DEB_TRACE() << "Mythen3Net::reconnect(): connected after " << retry << " retries";
+			return;
+		} catch (Exception& e) {
+			if (retry == MaxReconnectRetries)
+				throw;
+		}
+		DEB_WARNING() << "Mythen3Net::reconnect(): connection to " << m_hostname
+				<< " failed, retrying in " << delay << " s";
+		aLock.unlock();
+		usleep(static_cast<useconds_t>(delay * 1e6));
+		aLock.lock();
+		// reconnected by another thread meanwhile
+		if (m_connected)
+			return;
+		delay *= 2;
+	}
+}
+
+bool Mythen3Net::isConnected() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_connected;
+}
+
+/*
+ * Send a command and read its reply of len bytes, counting the exchange in
+ * the statistics slot unless negative. The first word of the reply is
+ * counted as its status unless data is set, for replies holding values
+ * that may be negative. Returns the number of receive system calls needed
+ * for the reply (recv() or io_uring_enter()), 0 when replaying.
+ */
+int Mythen3Net::sendCmd(const char* cmd, uint8_t* recvBuf, int len, int slot, bool data) {
+	DEB_HOT_FUNCT();
+	DEB_HOT_TRACE() << "Mythen3Net::sendCmd(" << cmd << ")";
 	AutoMutex aLock(m_cond.mutex());
 
 	if (!m_connected) {
+		DEB_HOT_ERROR_FUNCT();
 		THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): not connected";
 	}
-	if (write(m_sock, cmd.c_str(), strlen(cmd.c_str())) <= 0) {
-		THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): write to socket error";
+	if (m_replaying) {
+		replayCmd(cmd, recvBuf, len);
+		return 0;
+	}
+	long long sendTime = monotonicNs();
+	m_cmd_reads = 0;
+	int total;
+	try {
+		if (m_uring.isOpen()) {
+			total = uringExchange(cmd, recvBuf, len);
+		} else {
+			writeCmd(cmd, strlen(cmd));
+			total = readReply(recvBuf, len);
+		}
+	} catch (Exception&) {
+		countFailure(slot);
+		throw;
+	}
+	long long endTime = monotonicNs();
+	countReply(slot, data ? 0 : recvBuf, total, endTime - sendTime);
+	if (m_record_file)
+		record(cmd, recvBuf, total, sendTime, endTime);
+	return m_cmd_reads;
+}
+
+/*
+ * Send a batch of commands. With pipelining enabled the commands are
+ * coalesced into as few writes as possible and the replies are then collected
+ * in the same order, so the batch costs a single round trip. The socket server
+ * must then be able to separate commands arriving in the same segment.
+ */
+void Mythen3Net::sendCmds(Request* requests, int nbRequests) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(nbRequests, m_pipelining);
+	AutoMutex aLock(m_cond.mutex());
+
+	if (!m_connected) {
+		THROW_HW_ERROR(Error) << "Mythen3Net::sendCmds(): not connected";
+	}
+	if (m_replaying) {
+		for (int i = 0; i < nbRequests; i++)
+			replayCmd(requests[i].cmd, requests[i].reply, requests[i].len);
+		return;
+	}
+	long long sendTime, endTime;
+	int i = 0;
+	try {
+		if (!m_pipelining) {
+			for (i = 0; i < nbRequests; i++) {
+				DEB_TRACE() << "Mythen3Net::sendCmds(" << requests[i].cmd << ")";
+				sendTime = monotonicNs();
+				writeCmd(requests[i].cmd, strlen(requests[i].cmd));
+				int total = readReply(requests[i].reply, requests[i].len);
+				endTime = monotonicNs();
+				countReply(requests[i].slot, requests[i].reply, total, endTime - sendTime);
+				if (m_record_file)
+					record(requests[i].cmd, requests[i].reply, total, sendTime, endTime);
+			}
+			return;
+		}
+		sendTime = monotonicNs();
+		char buff[PipelineBufSize];
+		int n = 0;
+		for (int j = 0; j < nbRequests; j++) {
+			DEB_TRACE() << "Mythen3Net::sendCmds(" << requests[j].cmd << ")";
+			int len = strlen(requests[j].cmd);
+			if (n + len > PipelineBufSize) {
+				writeCmd(buff, n);
+				n = 0;
+			}
+			if (len > PipelineBufSize) {
+				writeCmd(requests[j].cmd, len);
+			} else {
+				memcpy(buff + n, requests[j].cmd, len);
+				n += len;
+			}
+		}
+		if (n > 0) {
+			writeCmd(buff, n);
+		}
+		// the latency of a pipelined command runs from the batch write
+		for (i = 0; i < nbRequests; i++) {
+			int total = readReply(requests[i].reply, requests[i].len);
+			endTime = monotonicNs();
+			countReply(requests[i].slot, requests[i].reply, total, endTime - sendTime);
+			if (m_record_file)
+				record(requests[i].cmd, requests[i].reply, total, sendTime, endTime);
+		}
+	} catch (Exception&) {
+		if (i < nbRequests)
+			countFailure(requests[i].slot);
+		throw;
+	}
+}
+
+/*
+ * Count every exchange of sendCmd() and sendCmds() in stats, see
+ * Mythen3Statistics. The counters are owned by the caller.
+ */
+void Mythen3Net::setStatistics(Mythen3Statistics* stats) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_stats = stats;
+}
+
+/*
+ * Count a reply in slot, with the status read from its first word unless
+ * reply is 0.
+ */
+void Mythen3Net::countReply(int slot, const uint8_t* reply, int len, long long latency) {
+	if (!m_stats || slot < 0)
+		return;
+	int32_t status = 0;
+	if (reply && len >= (int) sizeof(int32_t))
+		memcpy(&status, reply, sizeof(int32_t));
+	m_stats->add(slot, latency, len, status);
+}
+
+void Mythen3Net::countFailure(int slot) {
+	if (m_stats && slot >= 0)
+		m_stats->addFailure(slot);
+}
+
+/*
+ * Record every command with its reply and timing to fileName, see the
+ * format above, until stopRecording().
+ */
+void Mythen3Net::startRecording(const string& fileName) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(fileName);
+	AutoMutex aLock(m_cond.mutex());
+	if (m_record_file) {
+		fclose(m_record_file);
+		m_record_file = 0;
+	}
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (!file) {
+		THROW_HW_ERROR(Error) << "Mythen3Net::startRecording(): cannot create " << fileName;
+	}
+	if (fwrite(RecordMagic, sizeof(RecordMagic), 1, file) != 1) {
+		fclose(file);
+		THROW_HW_ERROR(Error) << "Mythen3Net::startRecording(): cannot write " << fileName;
+	}
+	m_record_file = file;
+	m_record_start = monotonicNs();
+}
+
+void Mythen3Net::stopRecording() {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	if (m_record_file) {
+		int rc = fclose(m_record_file);
+		m_record_file = 0;
+		if (rc != 0) {
+			THROW_HW_ERROR(Error) << "Mythen3Net::stopRecording(): recording incomplete";
+		}
+	}
+}
+
+/*
+ * Answer the commands from a recording instead of a server. Each command is
+ * matched with the next record of the same command, wrapping around at the
+ * end of the recording, and its recorded reply is returned after the
+ * recorded delay scaled by the replay speed. Commands absent from the
+ * recording get an all zero (successful) reply.
+ */
+void Mythen3Net::openReplay(const string& fileName) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(fileName);
+	AutoMutex aLock(m_cond.mutex());
+	if (m_connected) {
+		THROW_HW_ERROR(Error) << "Mythen3Net::openReplay(): Already connected to server";
+	}
+	FILE* file = fopen(fileName.c_str(), "rb");
+	if (!file) {
+		THROW_HW_ERROR(Error) << "Mythen3Net::openReplay(): cannot open " << fileName;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	m_replay_data.resize(size > 0 ? size : 0);
+	size_t nread = size > 0 ? fread(&m_replay_data[0], 1, size, file) : 0;
+	fclose(file);
+	if (nread < sizeof(RecordMagic) || memcmp(&m_replay_data[0], RecordMagic, sizeof(RecordMagic))) {
+		THROW_HW_ERROR(Error) << "Mythen3Net::openReplay(): " << fileName << " is not a traffic recording";
+	}
+	m_replay_index.clear();
+	size_t pos = sizeof(RecordMagic);
+	while (pos + RecordHeaderSize <= nread) {
+		uint16_t cmdLen;
+		uint32_t replyLen;
+		memcpy(&cmdLen, &m_replay_data[pos + RecordCmdLenOffset], sizeof(cmdLen));
+		memcpy(&replyLen, &m_replay_data[pos + RecordReplyLenOffset], sizeof(replyLen));
+		if (pos + RecordHeaderSize + cmdLen + replyLen > nread)
+			break;
+		m_replay_index.push_back(pos);
+		pos += RecordHeaderSize + cmdLen + replyLen;
+	}
+	DEB_TRACE() << "Mythen3Net::openReplay(): " << m_replay_index.size() << " records";
+	m_hostname = ReplayPrefix + fileName;
+	m_replay_pos = 0;
+	m_replaying = true;
+	m_connected = true;
+}
+
+/*
+ * Socket receive buffer size (SO_RCVBUF), 0 for the system default. The TCP
+ * window scale is negotiated by connect(), so an open connection is
+ * re-established to apply the new size.
+ */
+void Mythen3Net::setRecvBufferSize(int size) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(size);
+	if (size < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Mythen3Net: invalid receive buffer size " << size;
+	}
+	bool reopen;
+	{
+		AutoMutex aLock(m_cond.mutex());
+		m_rcvbuf = size;
+		reopen = m_connected && !m_replaying;
 	}
-	uint8_t* buffer;
-	buffer = recvBuf;
+	if (reopen)
+		reconnect();
+}
+
+int Mythen3Net::getRecvBufferSize() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_rcvbuf;
+}
+
+/*
+ * With quick ack, TCP_QUICKACK is set before reading each reply so that the
+ * detector is not slowed down by delayed acknowledgements. The kernel clears
+ * it by itself, hence one more system call per reply.
+ */
+void Mythen3Net::setQuickAck(bool enable) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(enable);
+	AutoMutex aLock(m_cond.mutex());
+	m_quick_ack = enable;
+}
+
+bool Mythen3Net::getQuickAck() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_quick_ack;
+}
+
+/*
+ * Busy poll the device queue for up to usecs when reading, 0 to disable.
+ * Raising it above the system value requires CAP_NET_ADMIN: a refused value
+ * is not kept, so that it cannot prevent a later reconnection.
+ */
+void Mythen3Net::setBusyPoll(int usecs) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(usecs);
+	if (usecs < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Mythen3Net: invalid busy poll time " << usecs;
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_connected && !m_replaying && !setBusyPollOption(usecs)) {
+		THROW_HW_ERROR(Error) << "Mythen3Net: Can't set SO_BUSY_POLL to " << usecs
+				<< " (needs CAP_NET_ADMIN)";
+	}
+	m_busy_poll = usecs;
+}
+
+int Mythen3Net::getBusyPoll() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_busy_poll;
+}
+
+/*
+ * Bound the wait for a reply: a read that times out is handled as a lost
+ * connection. 0 waits forever, the TCP keepalive still detects a detector
+ * that disappeared.
+ */
+void Mythen3Net::setReadTimeout(double timeout) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(timeout);
+	if (timeout < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Mythen3Net: invalid read timeout " << timeout;
+	}
+	AutoMutex aLock(m_cond.mutex());
+	if (m_connected && !m_replaying && !setReadTimeoutOption(timeout)) {
+		THROW_HW_ERROR(Error) << "Mythen3Net: Can't set SO_RCVTIMEO to " << timeout;
+	}
+	m_read_timeout = timeout;
+}
+
+double Mythen3Net::getReadTimeout() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_read_timeout;
+}
+
+/*
+ * Exchange the commands over io_uring instead of write() and recv(), see
+ * Mythen3Uring. Returns whether io_uring is in use: when the kernel does not
+ * provide it, the classic path is kept. Batches (sendCmds()) always use the
+ * classic path.
+ */
+bool Mythen3Net::setIoUring(bool enable) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR1(enable);
+	AutoMutex aLock(m_cond.mutex());
+	if (!enable) {
+		m_uring.close();
+	} else if (!m_uring.open()) {
+		DEB_WARNING() << "Mythen3Net: io_uring not available, using the socket calls";
+	}
+	return m_uring.isOpen();
+}
+
+bool Mythen3Net::getIoUring() const {
+	AutoMutex aLock(m_cond.mutex());
+	return m_uring.isOpen();
+}
+
+/*
+ * Register the buffers replies are received into, the frame ring of an
+ * acquisition, with the io_uring transport. Does nothing without io_uring.
+ */
+void Mythen3Net::registerBuffers(void* const* buffers, int nbBuffers, int size) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	if (m_uring.isOpen())
+		m_uring.registerBuffers(buffers, nbBuffers, size);
+}
+
+void Mythen3Net::unregisterBuffers() {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_uring.unregisterBuffers();
+}
+
+/*
+ * Set the replay time scale: 1 reproduces the recorded reply delays,
+ * 2 halves them, 0 replies at once.
+ */
+void Mythen3Net::setReplaySpeed(double speed) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_replay_speed = speed;
+}
+
+void Mythen3Net::setPipelining(bool enable) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	m_pipelining = enable;
+}
+
+bool Mythen3Net::getPipelining() const {
+	DEB_MEMBER_FUNCT();
+	AutoMutex aLock(m_cond.mutex());
+	return m_pipelining;
+}
+
+void Mythen3Net::writeCmd(const char* cmd, int len) {
+	DEB_HOT_FUNCT();
+	while (len > 0) {
+		int count = write(m_sock, cmd, len);
+		if (count <= 0) {
+			DEB_HOT_ERROR_FUNCT();
+			connectionLost();
+			THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): write to socket error";
+		}
+		cmd += count;
+		len -= count;
+	}
+}
+
+/*
+ * Read a reply of len bytes. The reply is always read in full: a data
+ * reply may legally start with a negative word (a bad channel reads -2,
+ * a failed readout -1 in every channel) and stopping at it would leave the
+ * rest of the reply in the socket for the next command. Returns the number
+ * of bytes received.
+ */
+int Mythen3Net::readReply(uint8_t* buffer, int len) {
+	DEB_HOT_FUNCT();
+	if (m_quick_ack) {
+		int opt = 1;
+		setsockopt(m_sock, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt));
+	}
+	readBytes(buffer, len);
+	DEB_HOT_TRACE() << "Mythen3Net::sendCmd(): total bytes read " << len;
+	return len;
+}
+
+void Mythen3Net::readBytes(uint8_t* buffer, int len) {
+	DEB_HOT_FUNCT();
 	int total = 0;
-	int count;
-	while (len > 0 && count != 4) {
-		if ((count = read(m_sock, buffer, len)) < 0) {
+	while (total < len) {
+		int count = recv(m_sock, buffer + total, len - total, MSG_WAITALL);
+		++m_cmd_reads;
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0) {
+			DEB_HOT_ERROR_FUNCT();
+			bool timedOut = (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ETIMEDOUT));
+			connectionLost();
+			if (timedOut) {
+				THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): no reply from " << m_hostname;
+			}
 			THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): read from socket error";
 		}
-		buffer += count;
-		len -= count;
 		total += count;
-		DEB_TRACE() << "Mythen3Net::sendCmd(): read " << count << " bytes, total " << total;
+		DEB_HOT_TRACE() << "Mythen3Net::sendCmd(): read " << count << " bytes, total " << total;
+	}
+}
+
+/*
+ * The exchange of sendCmd() over io_uring, see Mythen3Uring::exchange().
+ * Errors and timeouts are handled as in readBytes().
+ */
+int Mythen3Net::uringExchange(const char* cmd, uint8_t* buffer, int len) {
+	DEB_HOT_FUNCT();
+	if (m_quick_ack) {
+		int opt = 1;
+		setsockopt(m_sock, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(opt));
 	}
-	DEB_TRACE() << "Mythen3Net::sendCmd(): total bytes read" << total;
+	int total = m_uring.exchange(m_sock, cmd, strlen(cmd), buffer, len, m_read_timeout, m_cmd_reads);
+	if (total < 0) {
+		DEB_HOT_ERROR_FUNCT();
+		connectionLost();
+		if (total == -ETIMEDOUT) {
+			THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): no reply from " << m_hostname;
+		}
+		THROW_HW_ERROR(Error) << "Mythen3Net::sendCmd(): io_uring exchange error: " << strerror(-total);
+	}
+	DEB_HOT_TRACE() << "Mythen3Net::sendCmd(): total bytes read " << total;
+	return total;
+}
+
+/*
+ * The stream is out of step with the server once a read or write failed:
+ * close it so that the next command reports the lost connection.
+ */
+void Mythen3Net::connectionLost() {
+	DEB_MEMBER_FUNCT();
+	DEB_WARNING() << "Mythen3Net: connection to " << m_hostname << " lost";
+	disconnectFromServer();
+}
+
+/*
+ * Append a record. A failed write stops the recording rather than the
+ * communication with the detector.
+ */
+void Mythen3Net::record(const char* cmd, const uint8_t* reply, int len, long long sendTime, long long endTime) {
+	char header[RecordHeaderSize];
+	int64_t time = sendTime - m_record_start;
+	int64_t delay = endTime - sendTime;
+	uint16_t cmdLen = strlen(cmd);
+	uint32_t replyLen = len;
+	memcpy(header, &time, sizeof(time));
+	memcpy(header + RecordDelayOffset, &delay, sizeof(delay));
+	memcpy(header + RecordCmdLenOffset, &cmdLen, sizeof(cmdLen));
+	memcpy(header + RecordReplyLenOffset, &replyLen, sizeof(replyLen));
+	if (fwrite(header, RecordHeaderSize, 1, m_record_file) != 1
+			|| fwrite(cmd, 1, cmdLen, m_record_file) != cmdLen
+			|| fwrite(reply, 1, replyLen, m_record_file) != replyLen) {
+		DEB_MEMBER_FUNCT();
+		DEB_ERROR() << "Mythen3Net: traffic recording write failed, recording stopped";
+		fclose(m_record_file);
+		m_record_file = 0;
+	}
+}
+
+void Mythen3Net::replayCmd(const char* cmd, uint8_t* buffer, int len) {
+	DEB_HOT_FUNCT();
+	size_t nbRecords = m_replay_index.size();
+	size_t cmdLen = strlen(cmd);
+	for (size_t i = 0; i < nbRecords; i++) {
+		size_t index = (m_replay_pos + i) % nbRecords;
+		const char* rec = &m_replay_data[m_replay_index[index]];
+		int64_t delay;
+		uint16_t recCmdLen;
+		uint32_t replyLen;
+		memcpy(&delay, rec + RecordDelayOffset, sizeof(delay));
+		memcpy(&recCmdLen, rec + RecordCmdLenOffset, sizeof(recCmdLen));
+		memcpy(&replyLen, rec + RecordReplyLenOffset, sizeof(replyLen));
+		if (recCmdLen != cmdLen || memcmp(rec + RecordHeaderSize, cmd, cmdLen))
+			continue;
+		int n = (static_cast<int>(replyLen) < len) ? replyLen : len;
+		memcpy(buffer, rec + RecordHeaderSize + recCmdLen, n);
+		memset(buffer + n, 0, len - n);
+		m_replay_pos = index + 1;
+		if (m_replay_speed > 0) {
+			long long ns = static_cast<long long>(delay / m_replay_speed);
+			struct timespec ts;
+			ts.tv_sec = ns / 1000000000LL;
+			ts.tv_nsec = ns % 1000000000LL;
+			nanosleep(&ts, 0);
+		}
+		return;
+	}
+	DEB_HOT_TRACE() << "Mythen3Net::replayCmd(): " << cmd << " not recorded";
+	memset(buffer, 0, len);
+}
+
+bool Mythen3Net::setBusyPollOption(int usecs) {
+#ifdef SO_BUSY_POLL
+	return setsockopt(m_sock, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) == 0;
+#else
+	return usecs == 0;
+#endif
+}
+
+bool Mythen3Net::setReadTimeoutOption(double timeout) {
+	struct timeval tv;
+	tv.tv_sec = static_cast<time_t>(timeout);
+	tv.tv_usec = static_cast<suseconds_t>((timeout - tv.tv_sec) * 1e6);
+	return setsockopt(m_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+/*
+ * A power cycled detector does not close the connection: without keepalive
+ * a read waiting for a trigger would never return.
+ */
+bool Mythen3Net::setKeepAliveOptions() {
+	int opt = 1;
+	if (setsockopt(m_sock, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)) < 0)
+		return false;
+	opt = KeepAliveIdle;
+	if (setsockopt(m_sock, IPPROTO_TCP, TCP_KEEPIDLE, &opt, sizeof(opt)) < 0)
+		return false;
+	opt = KeepAliveInterval;
+	if (setsockopt(m_sock, IPPROTO_TCP, TCP_KEEPINTVL, &opt, sizeof(opt)) < 0)
+		return false;
+	opt = KeepAliveCount;
+	if (setsockopt(m_sock, IPPROTO_TCP, TCP_KEEPCNT, &opt, sizeof(opt)) < 0)
+		return false;
+#ifdef TCP_USER_TIMEOUT
+	opt = UserTimeout;
+	if (setsockopt(m_sock, IPPROTO_TCP, TCP_USER_TIMEOUT, &opt, sizeof(opt)) < 0)
+		return false;
+#endif
+	return true;
 }
@@ -0,0 +1,129 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3PeakSearch.h"
+
+using namespace std;
+using namespace lima::Mythen3;
+
+Mythen3PeakSearch::Mythen3PeakSearch() :
+		m_threshold(0), m_min_width(1), m_width(0), m_nb_rows(0) {
+}
+
+/*
+ * Set the search parameters, validated by the caller; threshold 0 disables
+ * the search. Taken into account at the next startAcq().
+ */
+void Mythen3PeakSearch::setThreshold(uint32_t threshold, int minWidth) {
+	m_threshold = threshold;
+	m_min_width = minWidth;
+}
+
+void Mythen3PeakSearch::getThreshold(uint32_t& threshold, int& minWidth) const {
+	threshold = m_threshold;
+	minWidth = m_min_width;
+}
+
+bool Mythen3PeakSearch::isEnabled() const {
+	return m_threshold > 0;
+}
+
+/*
+ * Size the ring for nbRows frames of width channels
+ */
+void Mythen3PeakSearch::startAcq(int nbRows, int width) {
+	m_width = width;
+	m_nb_rows = isEnabled() ? nbRows : 0;
+	m_nb_peaks.assign(m_nb_rows, 0);
+	m_peaks.resize(static_cast<size_t>(m_nb_rows) * MaxPeaks);
+}
+
+/*
+ * Search the decoded frame frameNb for peaks into its row of the ring
+ */
+void Mythen3PeakSearch::compute(long long frameNb, const uint32_t* frame) {
+	if (m_nb_rows == 0)
+		return;
+	int row = static_cast<int>(frameNb % m_nb_rows);
+	m_nb_peaks[row] = search(frame, m_width, m_threshold, m_min_width,
+			&m_peaks[static_cast<size_t>(row) * MaxPeaks], MaxPeaks);
+}
+
+int Mythen3PeakSearch::getNbRows() const {
+	return m_nb_rows;
+}
+
+int Mythen3PeakSearch::getNbPeaks(long long frameNb) const {
+	return m_nb_peaks[frameNb % m_nb_rows];
+}
+
+/*
+ * The peaks of frameNb, of the frames still held by the ring
+ */
+const Mythen3PeakSearch::Peak* Mythen3PeakSearch::getPeaks(long long frameNb) const {
+	return &m_peaks[(frameNb % m_nb_rows) * MaxPeaks];
+}
+
+/*
+ * Search width channels for up to maxPeaks peaks, returning their number.
+ * The channels below the threshold, most of a frame, are skipped eight at
+ * a time with a branch-free comparison that the compiler vectorises.
+ */
+int Mythen3PeakSearch::search(const uint32_t* frame, int width, uint32_t threshold, int minWidth,
+		Peak* peaks, int maxPeaks) {
+	int nbPeaks = 0;
+	int c = 0;
+	while (c < width && nbPeaks < maxPeaks) {
+		for (; c + 8 <= width; c += 8) {
+			uint32_t above = 0;
+			for (int i = 0; i < 8; i++)
+				above |= (frame[c + i] >= threshold);
+			if (above)
+				break;
+		}
+		for (; c < width && frame[c] < threshold; c++)
+			;
+		if (c == width)
+			break;
+		int first = c;
+		uint32_t height = 0;
+		double area = 0, net = 0, moment = 0;
+		for (; c < width && frame[c] >= threshold; c++) {
+			uint32_t counts = frame[c];
+			double excess = counts - threshold;
+			area += counts;
+			net += excess;
+			moment += excess * (c - first);
+			if (counts > height)
+				height = counts;
+		}
+		int peakWidth = c - first;
+		if (peakWidth < minWidth)
+			continue;
+		Peak& peak = peaks[nbPeaks++];
+		peak.position = first + ((net > 0) ? moment / net : (peakWidth - 1) / 2.0);
+		peak.height = height;
+		peak.area = area;
+		peak.width = peakWidth;
+	}
+	return nbPeaks;
+}
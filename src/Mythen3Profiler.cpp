@@ -0,0 +1,181 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include "Mythen3Profiler.h"
+
+using namespace lima;
+using namespace lima::Mythen3;
+
+#if defined(__linux__) && defined(__NR_perf_event_open)
+#define MYTHEN3_HAS_PERF_EVENT
+
+static const uint64_t counterConfigs[NB_PROFILE_COUNTERS] = {
+	PERF_COUNT_HW_INSTRUCTIONS,		// PROFILE_INSTRUCTIONS
+	PERF_COUNT_HW_CPU_CYCLES,		// PROFILE_CYCLES
+	PERF_COUNT_HW_CACHE_MISSES,		// PROFILE_CACHE_MISSES
+	PERF_COUNT_HW_BRANCH_MISSES,	// PROFILE_BRANCH_MISSES
+};
+
+static int perfEventOpen(uint64_t config, int groupFd) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.disabled = (groupFd < 0);
+	return syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+static const char* const stageNames[NB_PROFILE_STAGES] = {
+	"readout",		// PROFILE_READOUT
+	"decode",		// PROFILE_DECODE
+	"reduce",		// PROFILE_REDUCE
+	"publish",		// PROFILE_PUBLISH
+};
+
+Mythen3Profiler::Mythen3Profiler() : m_leader(-1), m_nb_counters(0) {
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++) {
+		m_fds[c] = -1;
+		m_index[c] = -1;
+		m_last[c] = 0;
+	}
+	reset();
+}
+
+Mythen3Profiler::~Mythen3Profiler() {
+	close();
+}
+
+/*
+ * Open the counters for the calling thread. Returns false if none is
+ * available, perf_event_paranoid above 2 or no PMU exposed.
+ */
+bool Mythen3Profiler::open() {
+	DEB_MEMBER_FUNCT();
+	close();
+#ifdef MYTHEN3_HAS_PERF_EVENT
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++) {
+		m_fds[c] = perfEventOpen(counterConfigs[c], m_leader);
+		if (m_fds[c] < 0) {
+			DEB_TRACE() << "counter " << c << " not available: " << strerror(errno);
+			continue;
+		}
+		if (m_leader < 0)
+			m_leader = m_fds[c];
+		m_index[c] = m_nb_counters++;
+	}
+	if (m_leader < 0) {
+		DEB_WARNING() << "Hardware performance counters not available: " << strerror(errno);
+		return false;
+	}
+	ioctl(m_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++)
+		m_result.available[c] = (m_fds[c] >= 0);
+	return true;
+#else
+	DEB_WARNING() << "Hardware performance counters not supported";
+	return false;
+#endif
+}
+
+void Mythen3Profiler::close() {
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++) {
+		if (m_fds[c] >= 0)
+			::close(m_fds[c]);
+		m_fds[c] = -1;
+		m_index[c] = -1;
+		m_result.available[c] = false;
+	}
+	m_leader = -1;
+	m_nb_counters = 0;
+}
+
+bool Mythen3Profiler::isOpen() const {
+	return m_leader >= 0;
+}
+
+void Mythen3Profiler::reset() {
+	for (int s = 0; s < NB_PROFILE_STAGES; s++) {
+		m_result.frames[s] = 0;
+		for (int c = 0; c < NB_PROFILE_COUNTERS; c++)
+			m_result.counts[s][c] = 0;
+	}
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++)
+		m_result.available[c] = (m_fds[c] >= 0);
+}
+
+/*
+ * Read the counters at the start of a stage
+ */
+void Mythen3Profiler::sample() {
+	read(m_last);
+}
+
+/*
+ * Add the counts since the last sample to stage and start the next stage
+ */
+void Mythen3Profiler::stage(ProfileStage stage) {
+	uint64_t values[NB_PROFILE_COUNTERS];
+	if (!read(values))
+		return;
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++) {
+		m_result.counts[stage][c] += values[c] - m_last[c];
+		m_last[c] = values[c];
+	}
+	m_result.frames[stage]++;
+}
+
+void Mythen3Profiler::getResult(Result& result) const {
+	result = m_result;
+}
+
+const char* Mythen3Profiler::stageName(ProfileStage stage) {
+	return stageNames[stage];
+}
+
+/*
+ * One read() of the whole group: the number of counters then their values
+ */
+bool Mythen3Profiler::read(uint64_t* values) {
+	if (m_leader < 0)
+		return false;
+	uint64_t group[1 + NB_PROFILE_COUNTERS];
+	ssize_t size = (1 + m_nb_counters) * sizeof(uint64_t);
+	if (::read(m_leader, group, size) != size)
+		return false;
+	for (int c = 0; c < NB_PROFILE_COUNTERS; c++)
+		values[c] = (m_index[c] >= 0) ? group[1 + m_index[c]] : 0;
+	return true;
+}
@@ -0,0 +1,186 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3Rebin.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace lima::Mythen3;
+
+Mythen3Rebin::Mythen3Rebin() :
+		m_start(0), m_bin_size(0), m_nb_bins(0), m_width(0), m_channel_bins(0), m_nb_rows(0) {
+}
+
+/*
+ * Set the calibration of each module, validated by the caller. Taken into
+ * account at the next build().
+ */
+void Mythen3Rebin::setCalibration(const vector<double>& centre, const vector<double>& conversion,
+		const vector<double>& offset) {
+	m_centre = centre;
+	m_conversion = conversion;
+	m_offset = offset;
+}
+
+void Mythen3Rebin::getCalibration(vector<double>& centre, vector<double>& conversion,
+		vector<double>& offset) const {
+	centre = m_centre;
+	conversion = m_conversion;
+	offset = m_offset;
+}
+
+int Mythen3Rebin::getNbCalibratedModules() const {
+	return static_cast<int>(m_centre.size());
+}
+
+/*
+ * Set the angular grid, validated by the caller: bins of binSize from start
+ * up to end, binSize 0 disables the rebinning
+ */
+void Mythen3Rebin::setBinning(double start, double end, double binSize) {
+	m_start = start;
+	m_bin_size = binSize;
+	m_nb_bins = (binSize > 0) ? static_cast<int>(ceil((end - start) / binSize - 1e-9)) : 0;
+}
+
+void Mythen3Rebin::getBinning(double& start, double& end, double& binSize) const {
+	start = m_start;
+	end = m_start + m_nb_bins * m_bin_size;
+	binSize = m_bin_size;
+}
+
+bool Mythen3Rebin::isEnabled() const {
+	return m_nb_bins > 0;
+}
+
+int Mythen3Rebin::getNbBins() const {
+	return m_nb_bins;
+}
+
+/*
+ * The angle at the centre of each bin
+ */
+void Mythen3Rebin::getAngles(vector<double>& angles) const {
+	angles.resize(m_nb_bins);
+	for (int b = 0; b < m_nb_bins; b++)
+		angles[b] = m_start + (b + 0.5) * m_bin_size;
+}
+
+/*
+ * Precompute the table of the bins of each channel, for width channels,
+ * moduleChannels per module. The calibration must cover the modules.
+ */
+void Mythen3Rebin::build(int width, int moduleChannels) {
+	vector<double> lo(width), hi(width);
+	m_channel_bins = 0;
+	for (int c = 0; c < width && m_nb_bins > 0; c++) {
+		int m = c / moduleChannels;
+		double x = c % moduleChannels;
+		lo[c] = twoTheta(m_centre[m], m_conversion[m], m_offset[m], x - 0.5);
+		hi[c] = twoTheta(m_centre[m], m_conversion[m], m_offset[m], x + 0.5);
+		if (lo[c] > hi[c])
+			swap(lo[c], hi[c]);
+		int bins = static_cast<int>(floor((hi[c] - m_start) / m_bin_size))
+				- static_cast<int>(floor((lo[c] - m_start) / m_bin_size)) + 1;
+		m_channel_bins = max(m_channel_bins, bins);
+	}
+	// null weights go to the padding bin m_nb_bins
+	m_bin.assign(static_cast<size_t>(width) * m_channel_bins, m_nb_bins);
+	m_weight.assign(m_bin.size(), 0.0f);
+	vector<double> weight(m_bin.size(), 0.0);
+	vector<double> coverage(m_nb_bins + 1, 0.0);
+	for (int c = 0; c < width && m_nb_bins > 0; c++) {
+		size_t e = static_cast<size_t>(c) * m_channel_bins;
+		int first = static_cast<int>(floor((lo[c] - m_start) / m_bin_size));
+		for (int b = max(0, first); b < min(m_nb_bins, first + m_channel_bins); b++) {
+			double binLo = m_start + b * m_bin_size;
+			double overlap = min(hi[c], binLo + m_bin_size) - max(lo[c], binLo);
+			if (overlap <= 0)
+				continue;
+			m_bin[e] = b;
+			weight[e] = overlap / (hi[c] - lo[c]);
+			coverage[b] += weight[e++];
+		}
+	}
+	for (size_t e = 0; e < m_bin.size(); e++)
+		if (weight[e] > 0)
+			m_weight[e] = static_cast<float>(weight[e] / coverage[m_bin[e]]);
+	m_sums.resize(m_nb_bins + 1);
+	m_width = width;
+}
+
+int Mythen3Rebin::getNbEntries() const {
+	return static_cast<int>(m_bin.size());
+}
+
+/*
+ * Size the ring for nbRows patterns
+ */
+void Mythen3Rebin::startAcq(int nbRows) {
+	m_nb_rows = (m_nb_bins > 0) ? nbRows : 0;
+	m_patterns.resize(static_cast<size_t>(m_nb_rows) * m_nb_bins);
+}
+
+/*
+ * Rebin the decoded frame frameNb into its row of the ring. The frame is
+ * read sequentially and every channel adds to the same number of bins, so
+ * the loop runs without a data dependent branch.
+ */
+void Mythen3Rebin::compute(long long frameNb, const uint32_t* frame) {
+	if (m_nb_rows == 0)
+		return;
+	float* sums = &m_sums[0];
+	fill(m_sums.begin(), m_sums.end(), 0.0f);
+	const int* bin = &m_bin[0];
+	const float* weight = &m_weight[0];
+	if (m_channel_bins == 2) {
+		for (int c = 0; c < m_width; c++, bin += 2, weight += 2) {
+			float counts = static_cast<float>(frame[c]);
+			sums[bin[0]] += weight[0] * counts;
+			sums[bin[1]] += weight[1] * counts;
+		}
+	} else {
+		for (int c = 0; c < m_width; c++) {
+			float counts = static_cast<float>(frame[c]);
+			for (int k = 0; k < m_channel_bins; k++, bin++, weight++)
+				sums[*bin] += *weight * counts;
+		}
+	}
+	memcpy(&m_patterns[(frameNb % m_nb_rows) * m_nb_bins], sums, m_nb_bins * sizeof(float));
+}
+
+int Mythen3Rebin::getNbRows() const {
+	return m_nb_rows;
+}
+
+/*
+ * The pattern of frameNb, of the frames still held by the ring
+ */
+const float* Mythen3Rebin::getRow(long long frameNb) const {
+	return &m_patterns[(frameNb % m_nb_rows) * m_nb_bins];
+}
+
+double Mythen3Rebin::twoTheta(double centre, double conversion, double offset, double x) {
+	return offset + atan((x - centre) * conversion) * 180.0 / M_PI;
+}
@@ -0,0 +1,99 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3Roi.h"
+
+using namespace std;
+using namespace lima::Mythen3;
+
+Mythen3Roi::Mythen3Roi() : m_nb_rows(0) {
+}
+
+/*
+ * Set the channel ranges, validated by the caller. Taken into account at
+ * the next startAcq().
+ */
+void Mythen3Roi::setRois(const vector<int>& first, const vector<int>& last) {
+	m_first = first;
+	m_last = last;
+}
+
+void Mythen3Roi::getRois(vector<int>& first, vector<int>& last) const {
+	first = m_first;
+	last = m_last;
+}
+
+int Mythen3Roi::getNbRois() const {
+	return static_cast<int>(m_first.size());
+}
+
+/*
+ * Size the table for an acquisition of nbFrames, 0 if continuous
+ */
+void Mythen3Roi::startAcq(int nbFrames) {
+	m_nb_rows = (nbFrames > 0 && nbFrames < RoiTableFrames) ? nbFrames : RoiTableFrames;
+	if (m_first.empty())
+		m_nb_rows = 0;
+	m_table.resize(static_cast<size_t>(m_nb_rows) * m_first.size());
+}
+
+/*
+ * Sum the ROIs of the decoded frame frameNb into its row of the table
+ */
+void Mythen3Roi::compute(long long frameNb, const uint32_t* frame) {
+	int nbRois = getNbRois();
+	if (nbRois == 0)
+		return;
+	int64_t* row = &m_table[(frameNb % m_nb_rows) * nbRois];
+	for (int r = 0; r < nbRois; r++)
+		row[r] = sum(frame + m_first[r], m_last[r] - m_first[r] + 1);
+}
+
+int Mythen3Roi::getNbRows() const {
+	return m_nb_rows;
+}
+
+/*
+ * The sums of frameNb, of the frames still held by the table
+ */
+const int64_t* Mythen3Roi::getRow(long long frameNb) const {
+	return &m_table[(frameNb % m_nb_rows) * getNbRois()];
+}
+
+/*
+ * Sum of nbChannels counts. Four independent 64 bit accumulators keep the
+ * additions out of one dependency chain and let the compiler vectorise the
+ * loop with wide integer adds.
+ */
+int64_t Mythen3Roi::sum(const uint32_t* counts, int nbChannels) {
+	uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i = 0;
+	for (; i + 4 <= nbChannels; i += 4) {
+		s0 += counts[i];
+		s1 += counts[i + 1];
+		s2 += counts[i + 2];
+		s3 += counts[i + 3];
+	}
+	for (; i < nbChannels; i++)
+		s0 += counts[i];
+	return static_cast<int64_t>(s0 + s1 + s2 + s3);
+}
@@ -0,0 +1,440 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "lima/Exceptions.h"
+#include "lima/Timestamp.h"
+#include "Mythen3Simulator.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+Camera::Simulator::Simulator() :
+		m_speed(1.0), m_assembly_date("27-feb-2015 21:08 GMT                             "),
+		m_version("M3.0.1"), m_command_id(1), m_module(-1), m_max_modules(SimulatedMaxModules),
+		m_nmodules(1), m_sensor_material(0), m_sensor_thickness(320), m_sys_num(116),
+		m_bad_channel_interpolation(true), m_flatfield_correction(true), m_rate_correction(false),
+		m_trigger_mode(false), m_gate(false), m_continuous_trigger(false),
+		m_energy_max(40.0), m_energy_min(4.09), m_kthresh_max(20.0), m_kthresh_min(4.0),
+		m_inpol(0), m_outpol(0), m_gates(1), m_delafter(0), m_delbef(0), m_time(10000000),
+		m_frames(1), m_nbits(24), m_cutoff(1280), m_running(false), m_start_time(0),
+		m_readouts(0), m_generator(SimulatedMaxModules * PixelsPerModule),
+		m_counts(SimulatedMaxModules * PixelsPerModule) {
+	DEB_CONSTRUCTOR();
+	for (int i = 0; i < SimulatedMaxModules; i++) {
+		m_modnum[i] = 31 + i;
+		m_energy[i] = 8.05;
+		m_kthresh[i] = 6.4;
+		m_tau[i] = 197.6159;
+	}
+}
+
+/*
+ * Answer a command in recvBuf of len bytes as the socket server would. For
+ * SET, recvBuf holds the binary value instead.
+ */
+void Camera::Simulator::exchange(Action action, ServerCmd cmd, uint8_t* recvBuf, int len) {
+	DEB_MEMBER_FUNCT();
+	AutoMutex lock(m_cond.mutex());
+	m_command_id++;
+	switch (action) {
+	case Camera::GET:
+		DEB_TRACE() << "sendCmd(-get " << serverCmdNames[cmd] << ")";
+		get(cmd, recvBuf);
+		break;
+	case Camera::SET:
+		DEB_TRACE() << "sendCmd(-" << serverCmdNames[cmd] << " " << recvBuf << ")";
+		set(cmd, recvBuf);
+		break;
+	case Camera::CMD:
+		command(cmd, recvBuf, len);
+		break;
+	default:
+		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): Action unknown. Please report";
+		break;
+	};
+}
+
+/*
+ * Scale the time between simulated frames: 1 is real time, 2 twice as fast
+ * and 0 produces the frames without delay
+ */
+void Camera::Simulator::setSpeed(double speed) {
+	DEB_MEMBER_FUNCT();
+	if (speed < 0) {
+		THROW_HW_ERROR(InvalidValue) << "Invalid simulation speed " << speed;
+	}
+	AutoMutex lock(m_cond.mutex());
+	m_speed = speed;
+}
+
+double Camera::Simulator::getSpeed() {
+	AutoMutex lock(m_cond.mutex());
+	return m_speed;
+}
+
+void Camera::Simulator::get(ServerCmd cmd, uint8_t* recvBuf) {
+	DEB_MEMBER_FUNCT();
+	int* iptr = reinterpret_cast<int*>(recvBuf);
+	float* fptr = reinterpret_cast<float*>(recvBuf);
+	long long* llptr = reinterpret_cast<long long*>(recvBuf);
+	char *cptr = reinterpret_cast<char*>(recvBuf);
+	switch (cmd) {
+	case ASSEMBLYDATE:
+		memcpy(cptr, m_assembly_date.c_str(), m_assembly_date.length()-1);
+		*(cptr+m_assembly_date.length() - 1) = '\0';
+		break;
+	case BADCHANNELS:
+		memset(iptr, 0, m_nmodules * PixelsPerModule * sizeof(int));
+		break;
+	case COMMANDID:
+		iptr[0] = m_command_id;
+		break;
+	case MODNUM:
+		for (int i = 0; i < m_nmodules; i++)
+			*iptr++ = m_modnum[i];
+		break;
+	case MODULE:
+		iptr[0] = m_module;
+		break;
+	case NMAXMODULES:
+		iptr[0] = m_max_modules;
+		break;
+	case NMODULES:
+		iptr[0] = m_nmodules;
+		break;
+	case SENSORMATERIAL:
+		iptr[0] = m_sensor_material;
+		break;
+	case SENSORTHICKNESS:
+		iptr[0] = m_sensor_thickness;
+		break;
+	case SYSTEMNUM:
+		iptr[0] = m_sys_num;
+		break;
+	case VERSION:
+		memcpy(cptr, m_version.c_str(), m_version.length());
+		break;
+	case DELAFTER:
+		llptr[0] = m_delafter;
+		break;
+	case FRAMES:
+		iptr[0] = m_frames;
+		break;
+	case NBITS:
+		iptr[0] = m_nbits;
+		break;
+	case STATUS:
+		iptr[0] = getStatus();
+		break;
+	case TIME:
+		llptr[0] = m_time;
+		break;
+	case ENERGY:
+		if (m_module == -1) {
+			for (int i = 0; i < m_nmodules; i++)
+				*fptr++ = m_energy[i];
+		} else {
+			*fptr = m_energy[m_module];
+		}
+		break;
+	case ENERGYMAX:
+		fptr[0] = m_energy_max;
+		break;
+	case ENERGYMIN:
+		fptr[0] = m_energy_min;
+		break;
+	case KTHRESH:
+		if (m_module == -1) {
+			for (int i = 0; i < m_nmodules; i++)
+				*fptr++ = m_kthresh[i];
+		} else {
+			*fptr = m_kthresh[m_module];
+		}
+		break;
+	case KTHRESHMAX:
+		fptr[0] = m_kthresh_max;
+		break;
+	case KTHRESHMIN:
+		fptr[0] = m_kthresh_min;
+		break;
+	case BADCHANNELINTERPOLATION:
+		iptr[0] = m_bad_channel_interpolation;
+		break;
+	case FLATFIELDCORRECTION:
+		iptr[0] = m_flatfield_correction;
+		break;
+	case CUTOFF:
+		iptr[0] = m_cutoff;
+		break;
+	case FLATFIELD:
+		for (int i = 0; i < m_nmodules; i++)
+			for (int j = 0; j < PixelsPerModule; j++)
+				*iptr++ = j;
+		break;
+	case RATECORRECTION:
+		iptr[0] = m_rate_correction;
+		break;
+	case TAU:
+		if (m_module == -1) {
+			for (int i = 0; i < m_nmodules; i++)
+				*fptr++ = m_tau[i];
+		} else {
+			*fptr = m_tau[m_module];
+		}
+		break;
+	case DELBEF:
+		llptr[0] = m_delbef;
+		break;
+	case GATES:
+		iptr[0] = m_gates;
+		break;
+	case CONTTRIG:
+		iptr[0] = m_continuous_trigger;
+		break;
+	case GATE:
+		iptr[0] = m_gate;
+		break;
+	case INPOL:
+		iptr[0] = m_inpol;
+		break;
+	case OUTPOL:
+		iptr[0] = m_outpol;
+		break;
+	case TRIG:
+		iptr[0] = m_trigger_mode;
+		break;
+	default:
+		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): cmd unknown. Please report";
+		break;
+	}
+}
+
+void Camera::Simulator::set(ServerCmd cmd, const uint8_t* value) {
+	DEB_MEMBER_FUNCT();
+	const int* iptr = reinterpret_cast<const int*>(value);
+	const float* fptr = reinterpret_cast<const float*>(value);
+	const long long* llptr = reinterpret_cast<const long long*>(value);
+	switch (cmd) {
+	case MODULE:
+		if (iptr[0] < -1 || iptr[0] >= m_nmodules) {
+			THROW_HW_ERROR(Error) << serverStatusMap[-2];
+		}
+		m_module = iptr[0];
+		break;
+	case NMODULES:
+		if (iptr[0] < 1 || iptr[0] > m_max_modules) {
+			THROW_HW_ERROR(Error) << serverStatusMap[-2];
+		}
+		m_nmodules = iptr[0];
+		break;
+	case DELAFTER:
+		m_delafter = llptr[0];
+		break;
+	case FRAMES:
+		m_frames = iptr[0];
+		break;
+	case NBITS:
+		m_nbits = iptr[0];
+		break;
+	case TIME:
+		m_time = llptr[0];
+		break;
+	case ENERGY:
+		if (m_module == -1)
+			for (int i = 0; i < m_nmodules; i++)
+				m_energy[i] = fptr[0];
+		else
+			m_energy[m_module] = fptr[0];
+		break;
+	case KTHRESH:
+		if (m_module == -1)
+			for (int i = 0; i < m_nmodules; i++)
+				m_kthresh[i] = fptr[0];
+		else
+			m_kthresh[m_module] = fptr[0];
+		break;
+	case KTHRESHENERGY:
+		if (m_module == -1) {
+			for (int i = 0; i < m_nmodules; i++) {
+				m_kthresh[i] = fptr[0];
+				m_energy[i] = fptr[1];
+			}
+		} else {
+			m_kthresh[m_module] = fptr[0];
+			m_energy[m_module] = fptr[1];
+		}
+		break;
+	case SETTINGS:
+		break;
+	case BADCHANNELINTERPOLATION:
+		m_bad_channel_interpolation = iptr[0];
+		break;
+	case FLATFIELDCORRECTION:
+		m_flatfield_correction = iptr[0];
+		break;
+	case RATECORRECTION:
+		m_rate_correction = iptr[0];
+		break;
+	case TAU:
+		if (m_module == -1)
+			for (int i = 0; i < m_nmodules; i++)
+				m_tau[i] = fptr[0];
+		else
+			m_tau[m_module] = fptr[0];
+		break;
+	case CONTTRIGEN:
+		m_continuous_trigger = iptr[0];
+		break;
+	case DELBEF:
+		m_delbef = llptr[0];
+		break;
+	case GATEEN:
+		m_gate = iptr[0];
+		break;
+	case GATES:
+		m_gates = iptr[0];
+		break;
+	case INPOL:
+		m_inpol = iptr[0];
+		break;
+	case OUTPOL:
+		m_outpol = iptr[0];
+		break;
+	case TRIGEN:
+		m_trigger_mode = iptr[0];
+		break;
+	default:
+		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): cmd unknown. Please report";
+		break;
+	}
+}
+
+void Camera::Simulator::command(ServerCmd cmd, uint8_t* recvBuf, int len) {
+	DEB_MEMBER_FUNCT();
+	uint32_t* iptr = reinterpret_cast<uint32_t*>(recvBuf);
+	int nbChannels = m_nmodules * PixelsPerModule;
+	switch (cmd) {
+	case TESTPATTERN:
+		for (int i = 0; i < m_nmodules; i++)
+			for (int j = 0; j < PixelsPerModule; j++)
+				*iptr++ = j * 2;
+		break;
+	case RESET:
+	case STOP:
+		m_running = false;
+		m_cond.broadcast();
+		break;
+	case START:
+		m_running = true;
+		m_start_time = Timestamp::now();
+		m_readouts = 0;
+		break;
+	case READOUT:
+		waitForFrame();
+		m_generator.generate(iptr, min<int>(len / sizeof(uint32_t), nbChannels), m_readouts - 1);
+		break;
+	case READOUTRAW:
+		waitForFrame();
+		m_generator.generate(&m_counts[0], nbChannels, m_readouts - 1);
+		packRaw(&m_counts[0], iptr, min<int>(len / sizeof(uint32_t), nbChannels / (32 / m_nbits)));
+		break;
+	case LOGSTART:
+	case LOGSTOP:
+	case LOGREAD:
+		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): Not implemented in simulate mode";
+		break;
+	default:
+		THROW_HW_ERROR(Error) << "Mythen3Camera::simulate(): ServerCmd unknown. Please report";
+		break;
+	}
+}
+
+/*
+ * Running while frames of the started acquisition are due, NoDataInBuffer
+ * once all the frames due have been read out
+ */
+int Camera::Simulator::getStatus() {
+	long long due = getFramesDue();
+	int status = 0;
+	if (m_running && due < m_frames)
+		status |= Camera::Running;
+	if (m_readouts >= due)
+		status |= Camera::NoDataInBuffer;
+	return status;
+}
+
+/*
+ * Frames of the current acquisition acquired by now: the first one after
+ * delbef + time, then one every time + delafter
+ */
+long long Camera::Simulator::getFramesDue() {
+	if (!m_running)
+		return m_readouts;
+	if (m_speed == 0)
+		return m_frames;
+	double elapsed = (Timestamp::now() - m_start_time) * m_speed / 1e-7;
+	double first = m_delbef + m_time;
+	if (elapsed < first)
+		return 0;
+	long long period = m_time + m_delafter;
+	long long due = (period > 0) ? static_cast<long long>((elapsed - first) / period) + 1 : m_frames;
+	return (due < m_frames) ? due : m_frames;
+}
+
+/*
+ * Wait, without blocking the other commands, until the next frame has been
+ * acquired. A readout beyond the last frame or after STOP returns at once.
+ */
+void Camera::Simulator::waitForFrame() {
+	while (m_running && m_readouts < m_frames && getFramesDue() <= m_readouts) {
+		double frameTime = (m_delbef + m_time + m_readouts * (m_time + m_delafter)) * 1e-7 / m_speed;
+		double wait = m_start_time + frameTime - Timestamp::now();
+		if (wait > 0)
+			m_cond.wait(wait);
+	}
+	m_readouts++;
+}
+
+/*
+ * Pack the counts as READOUTRAW does, the inverse of Camera::decodeRaw():
+ * word j holds channels j * 32 / nbits to (j + 1) * 32 / nbits - 1, the
+ * first one in the least significant bits. Counts saturate at the largest
+ * value of nbits bits.
+ */
+void Camera::Simulator::packRaw(const uint32_t* counts, uint32_t* raw, int nbWords) {
+	int chansPerPoint = CHAR_BIT * sizeof(int) / m_nbits;
+	uint32_t mask = 0xffffffff >> ((m_nbits * (chansPerPoint - 1)));
+	if (chansPerPoint == 1)
+		mask = 0xffffffff >> (CHAR_BIT * sizeof(int) - m_nbits);
+	for (int j = 0; j < nbWords; j++) {
+		uint32_t word = 0;
+		for (int i = 0; i < chansPerPoint; i++) {
+			uint32_t count = counts[j * chansPerPoint + i];
+			word |= ((count < mask) ? count : mask) << (m_nbits * i);
+		}
+		raw[j] = word;
+	}
+}
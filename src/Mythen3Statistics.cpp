@@ -0,0 +1,144 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include "Mythen3Statistics.h"
+
+using namespace lima;
+using namespace lima::Mythen3;
+
+Mythen3Statistics::Mythen3Statistics(int nbSlots) :
+		m_nb_slots(nbSlots), m_slots(new Slot[nbSlots]) {
+	reset();
+}
+
+Mythen3Statistics::~Mythen3Statistics() {
+	delete[] m_slots;
+}
+
+/*
+ * Count an exchange of slot answered after latency ns with bytes bytes,
+ * status being the first 4 bytes of the reply. A negative status is an
+ * error reply of the socket server.
+ */
+void Mythen3Statistics::add(int slot, long long latency, int bytes, int status) {
+	Slot& s = m_slots[slot];
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	s.buckets[bucketOf(latency)].fetch_add(1, std::memory_order_relaxed);
+	long long max = s.max.load(std::memory_order_relaxed);
+	while (latency > max && !s.max.compare_exchange_weak(max, latency, std::memory_order_relaxed))
+		;
+	if (status < 0) {
+		int code = (status > -NbStatusCodes) ? -status : 0;
+		s.errorCodes[code].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/*
+ * Count an exchange of slot that got no reply: a timeout or a lost
+ * connection
+ */
+void Mythen3Statistics::addFailure(int slot) {
+	m_slots[slot].failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Mythen3Statistics::reset() {
+	for (int i = 0; i < m_nb_slots; i++) {
+		Slot& s = m_slots[i];
+		s.count = 0;
+		s.bytes = 0;
+		s.failures = 0;
+		s.max = 0;
+		for (int b = 0; b < NbLatencyBuckets; b++)
+			s.buckets[b] = 0;
+		for (int c = 0; c < NbStatusCodes; c++)
+			s.errorCodes[c] = 0;
+	}
+}
+
+int Mythen3Statistics::getNbSlots() const {
+	return m_nb_slots;
+}
+
+/*
+ * The percentiles are the upper limits of their histogram buckets, bounded
+ * by the maximum. errorCodes[0] counts the error replies with an unknown
+ * status code.
+ */
+void Mythen3Statistics::getSummary(int slot, Summary& summary) const {
+	const Slot& s = m_slots[slot];
+	long long buckets[NbLatencyBuckets];
+	long long count = 0;
+	for (int b = 0; b < NbLatencyBuckets; b++) {
+		buckets[b] = s.buckets[b].load(std::memory_order_relaxed);
+		count += buckets[b];
+	}
+	summary.count = count;
+	summary.bytes = s.bytes.load(std::memory_order_relaxed);
+	summary.failures = s.failures.load(std::memory_order_relaxed);
+	summary.max = s.max.load(std::memory_order_relaxed);
+	summary.p50 = percentile(buckets, count, 0.50);
+	summary.p99 = percentile(buckets, count, 0.99);
+	if (summary.p50 > summary.max)
+		summary.p50 = summary.max;
+	if (summary.p99 > summary.max)
+		summary.p99 = summary.max;
+	summary.errors = 0;
+	for (int c = 0; c < NbStatusCodes; c++) {
+		summary.errorCodes[c] = s.errorCodes[c].load(std::memory_order_relaxed);
+		summary.errors += summary.errorCodes[c];
+	}
+}
+
+/*
+ * Latencies below 2^2 ns have a bucket each; above, each power of 2 is split
+ * in LatencySubBuckets linear buckets.
+ */
+int Mythen3Statistics::bucketOf(long long latency) {
+	if (latency < LatencySubBuckets)
+		return (latency < 0) ? 0 : latency;
+	int exponent = 63 - __builtin_clzll(latency);
+	int sub = (latency >> (exponent - 2)) & (LatencySubBuckets - 1);
+	int bucket = (exponent - 1) * LatencySubBuckets + sub;
+	return (bucket < NbLatencyBuckets) ? bucket : NbLatencyBuckets - 1;
+}
+
+long long Mythen3Statistics::bucketLimit(int bucket) {
+	if (bucket < LatencySubBuckets)
+		return bucket + 1;
+	int exponent = bucket / LatencySubBuckets + 1;
+	int sub = bucket % LatencySubBuckets;
+	return (1LL << exponent) + ((sub + 1LL) << (exponent - 2));
+}
+
+long long Mythen3Statistics::percentile(const long long* buckets, long long count, double fraction) {
+	if (count == 0)
+		return 0;
+	long long rank = static_cast<long long>(fraction * (count - 1)) + 1;
+	long long seen = 0;
+	for (int b = 0; b < NbLatencyBuckets; b++) {
+		seen += buckets[b];
+		if (seen >= rank)
+			return bucketLimit(b);
+	}
+	return bucketLimit(NbLatencyBuckets - 1);
+}
@@ -0,0 +1,348 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#include "Mythen3Uring.h"
+
+using namespace lima;
+using namespace lima::Mythen3;
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_LINKED_FILE)
+#define MYTHEN3_HAS_IO_URING
+
+static long long monotonicNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int uringEnter(int fd, unsigned int toSubmit, unsigned int minComplete, long long timeoutNs) {
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	if (timeoutNs >= 0) {
+		ts.tv_sec = timeoutNs / 1000000000LL;
+		ts.tv_nsec = timeoutNs % 1000000000LL;
+		arg.ts = reinterpret_cast<uintptr_t>(&ts);
+	}
+	return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+			IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+#endif
+
+Mythen3Uring::Mythen3Uring() :
+		m_fd(-1), m_sq_ptr(0), m_sq_size(0), m_cq_ptr(0), m_cq_size(0), m_sqes(0), m_sqes_size(0),
+		m_to_submit(0), m_buffer_size(0), m_last_buffer(-1) {
+	DEB_CONSTRUCTOR();
+	for (int tag = 0; tag < NB_TAGS; tag++) {
+		m_pending[tag] = false;
+		m_result[tag] = 0;
+	}
+}
+
+Mythen3Uring::~Mythen3Uring() {
+	DEB_DESTRUCTOR();
+	close();
+}
+
+/*
+ * Create the ring. Returns false, leaving the classic socket path in use,
+ * if the kernel has no io_uring, refuses it (io_uring_disabled, seccomp) or
+ * is older than Linux 5.18, which brought MSG_WAITALL to io_uring receives
+ * (tested through IORING_FEAT_LINKED_FILE, of the same release).
+ */
+bool Mythen3Uring::open() {
+	DEB_MEMBER_FUNCT();
+	if (m_fd >= 0)
+		return true;
+#ifdef MYTHEN3_HAS_IO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(__NR_io_uring_setup, UringDepth, &params);
+	if (fd < 0) {
+		DEB_TRACE() << "io_uring_setup failed: " << strerror(errno);
+		return false;
+	}
+	if (!(params.features & IORING_FEAT_LINKED_FILE) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+		DEB_TRACE() << "io_uring too old, features " << params.features;
+		::close(fd);
+		return false;
+	}
+	m_fd = fd;
+	m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (m_cq_size > m_sq_size)
+		m_sq_size = m_cq_size;
+	m_sq_ptr = mmap(0, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = mmap(0, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (m_sq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+		if (m_sq_ptr == MAP_FAILED)
+			m_sq_ptr = 0;
+		if (sqes != MAP_FAILED)
+			munmap(sqes, m_sqes_size);
+		close();
+		return false;
+	}
+	m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+	m_cq_ptr = m_sq_ptr;
+	char* sq = static_cast<char*>(m_sq_ptr);
+	m_sq_head = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+	m_sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+	m_sq_mask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+	m_sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+	m_cq_head = reinterpret_cast<unsigned int*>(sq + params.cq_off.head);
+	m_cq_tail = reinterpret_cast<unsigned int*>(sq + params.cq_off.tail);
+	m_cq_mask = reinterpret_cast<unsigned int*>(sq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<struct io_uring_cqe*>(sq + params.cq_off.cqes);
+	return true;
+#else
+	DEB_TRACE() << "io_uring not available at compile time";
+	return false;
+#endif
+}
+
+void Mythen3Uring::close() {
+	DEB_MEMBER_FUNCT();
+	if (m_sqes) {
+		munmap(m_sqes, m_sqes_size);
+		m_sqes = 0;
+	}
+	if (m_sq_ptr) {
+		munmap(m_sq_ptr, m_sq_size);
+		m_sq_ptr = 0;
+		m_cq_ptr = 0;
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_buffers.clear();
+	m_last_buffer = -1;
+}
+
+bool Mythen3Uring::isOpen() const {
+	return m_fd >= 0;
+}
+
+/*
+ * Register the frame buffers so that the kernel maps them once rather than
+ * for every frame. Returns false if the kernel refuses (e.g. the locked
+ * memory limit); the replies are then received into unregistered memory.
+ */
+bool Mythen3Uring::registerBuffers(void* const* buffers, int nbBuffers, int size) {
+	DEB_MEMBER_FUNCT();
+	DEB_PARAM() << DEB_VAR2(nbBuffers, size);
+	unregisterBuffers();
+#ifdef MYTHEN3_HAS_IO_URING
+	if (m_fd < 0)
+		return false;
+	std::vector<struct iovec> iovecs(nbBuffers);
+	for (int i = 0; i < nbBuffers; i++) {
+		iovecs[i].iov_base = buffers[i];
+		iovecs[i].iov_len = size;
+	}
+	if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, &iovecs[0], nbBuffers) < 0) {
+		DEB_WARNING() << "io_uring buffer registration failed: " << strerror(errno);
+		return false;
+	}
+	m_buffers.resize(nbBuffers);
+	for (int i = 0; i < nbBuffers; i++)
+		m_buffers[i] = static_cast<uint8_t*>(buffers[i]);
+	m_buffer_size = size;
+	m_last_buffer = -1;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Mythen3Uring::unregisterBuffers() {
+	DEB_MEMBER_FUNCT();
+#ifdef MYTHEN3_HAS_IO_URING
+	if (m_fd >= 0 && !m_buffers.empty())
+		syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_BUFFERS, 0, 0);
+#endif
+	m_buffers.clear();
+	m_last_buffer = -1;
+}
+
+/*
+ * Index of the registered buffer holding [buffer, buffer + len), or -1.
+ * The frame ring is filled in order, so the buffer after the last one used
+ * is tried first.
+ */
+int Mythen3Uring::findBuffer(const uint8_t* buffer, int len) {
+	int nb = m_buffers.size();
+	for (int i = 0; i < nb; i++) {
+		int index = (m_last_buffer + 1 + i) % nb;
+		const uint8_t* start = m_buffers[index];
+		if (buffer >= start && buffer + len <= start + m_buffer_size) {
+			m_last_buffer = index;
+			return index;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Send cmd on sock and receive its reply of len bytes into buffer, with the
+ * same framing as Mythen3Net::readReply(): the reply is always read in
+ * full. timeout bounds the whole exchange, 0 waits forever. Returns the
+ * number of bytes received or -errno, -ETIMEDOUT on timeout; nbCalls is set
+ * to the number of system calls made.
+ */
+int Mythen3Uring::exchange(int sock, const char* cmd, int cmdLen, uint8_t* buffer, int len,
+		double timeout, int& nbCalls) {
+	nbCalls = 0;
+#ifdef MYTHEN3_HAS_IO_URING
+	long long deadline = (timeout > 0) ? monotonicNs() + static_cast<long long>(timeout * 1e9) : -1;
+	int bufIndex = findBuffer(buffer, len);
+
+	nextSqe(IORING_OP_SEND, sock, cmd, cmdLen, TAG_SEND)->flags = IOSQE_IO_LINK;
+	queueRecv(sock, buffer, len, bufIndex);
+	int total = 0;
+	for (;;) {
+		int rc = waitFor(TAG_RECV, deadline, nbCalls);
+		if (rc == 0 && total == 0 && m_result[TAG_SEND] != cmdLen)
+			rc = (m_result[TAG_SEND] < 0) ? m_result[TAG_SEND] : -EIO;
+		if (rc == 0 && m_result[TAG_RECV] <= 0)
+			rc = (m_result[TAG_RECV] < 0) ? m_result[TAG_RECV] : -ECONNRESET;
+		if (rc < 0) {
+			drain(nbCalls);
+			return rc;
+		}
+		total += m_result[TAG_RECV];
+		if (total == len)
+			return total;
+		queueRecv(sock, buffer + total, len - total, bufIndex);
+	}
+#else
+	return -ENOSYS;
+#endif
+}
+
+#ifdef MYTHEN3_HAS_IO_URING
+/*
+ * Queue an entry; it is published to the kernel at once and submitted by the
+ * next io_uring_enter() of waitFor().
+ */
+struct io_uring_sqe* Mythen3Uring::nextSqe(int opcode, int fd, const void* addr, int len, Tag tag) {
+	unsigned int tail = *m_sq_tail;
+	unsigned int index = tail & *m_sq_mask;
+	struct io_uring_sqe* sqe = &m_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uintptr_t>(addr);
+	sqe->len = len;
+	sqe->user_data = tag;
+	m_sq_array[index] = index;
+	__atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++m_to_submit;
+	m_pending[tag] = true;
+	return sqe;
+}
+
+void Mythen3Uring::queueRecv(int sock, uint8_t* buffer, int len, int bufIndex) {
+	if (bufIndex >= 0) {
+		struct io_uring_sqe* sqe = nextSqe(IORING_OP_READ_FIXED, sock, buffer, len, TAG_RECV);
+		sqe->buf_index = bufIndex;
+	} else {
+		nextSqe(IORING_OP_RECV, sock, buffer, len, TAG_RECV)->msg_flags = MSG_WAITALL;
+	}
+}
+
+void Mythen3Uring::cancel(Tag tag) {
+	if (!m_pending[tag])
+		return;
+	struct io_uring_sqe* sqe = nextSqe(IORING_OP_ASYNC_CANCEL, -1, 0, 0, TAG_CANCEL);
+	sqe->addr = tag;
+}
+
+/*
+ * Submit the queued entries and wait until the operation tagged tag has
+ * completed. Returns 0, or -ETIMEDOUT once deadline (monotonic ns, -1 for
+ * none) has passed.
+ */
+int Mythen3Uring::waitFor(Tag tag, long long deadline, int& nbCalls) {
+	reap();
+	while (m_pending[tag]) {
+		long long timeoutNs = -1;
+		if (deadline >= 0) {
+			timeoutNs = deadline - monotonicNs();
+			if (timeoutNs <= 0)
+				return -ETIMEDOUT;
+		}
+		// wait for all the operations in flight, they complete together
+		unsigned int nbPending = 0;
+		for (int i = 0; i < NB_TAGS; i++)
+			nbPending += m_pending[i];
+		int rc = uringEnter(m_fd, m_to_submit, nbPending, timeoutNs);
+		++nbCalls;
+		if (rc >= 0) {
+			m_to_submit -= (static_cast<unsigned int>(rc) < m_to_submit) ? rc : m_to_submit;
+		} else if (errno != EINTR && errno != ETIME && errno != EBUSY) {
+			return -errno;
+		}
+		reap();
+	}
+	return 0;
+}
+
+/*
+ * Wait for every operation in flight, cancelling them first: their buffers
+ * must not be written once exchange() has returned.
+ */
+void Mythen3Uring::drain(int& nbCalls) {
+	for (int tag = 0; tag < NB_TAGS; tag++)
+		if (tag != TAG_CANCEL)
+			cancel(static_cast<Tag>(tag));
+	for (int tag = 0; tag < NB_TAGS; tag++)
+		waitFor(static_cast<Tag>(tag), -1, nbCalls);
+}
+
+void Mythen3Uring::reap() {
+	unsigned int head = *m_cq_head;
+	unsigned int tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		struct io_uring_cqe* cqe = &m_cqes[head & *m_cq_mask];
+		int tag = static_cast<int>(cqe->user_data);
+		if (tag >= 0 && tag < NB_TAGS) {
+			m_result[tag] = cqe->res;
+			m_pending[tag] = false;
+		}
+	}
+	__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+}
+#endif
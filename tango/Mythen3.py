@@ -46,12 +46,56 @@
 ##############################################################################
 
 import PyTango
-import numpy
+import json
 import sys
+import threading
+import time
+import numpy
 from Lima import Core
 from Lima import Mythen3 as Mythen3Acq
 from Lima.Server import AttrHelper
 
+MaxEventDecimation = 256  # channels summed per point of lastFrame, no 32-bit overflow of 24-bit counts
+
+class EventThread(threading.Thread):
+    """Push the change and data ready events of the last acquired frame,
+    at most maxRate times per second. Frames acquired in between are
+    skipped: the events carry the latest frame only."""
+
+    def __init__(self, device):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.device = device
+        self.maxRate = 10.0
+        self.decimation = 1
+        self.stopped = threading.Event()
+        self.lastFrameNb = -1
+        self.acqRunning = False
+
+    def stop(self):
+        self.stopped.set()
+        self.join()
+
+    def run(self):
+        while not self.stopped.wait(1.0 / self.maxRate):
+            try:
+                self.poll()
+            except Exception as e:
+                print ('Mythen3 event push failed: %s' % e)
+
+    def poll(self):
+        running = _Mythen3Camera.isAcqRunning()
+        frameNb = _Mythen3Camera.getNbHwAcquiredFrames() - 1
+        if frameNb < self.lastFrameNb:
+            self.lastFrameNb = -1  # a new acquisition started
+        with PyTango.AutoTangoMonitor(self.device):
+            if frameNb > self.lastFrameNb:
+                self.device.pushFrame(frameNb, self.decimation)
+                self.lastFrameNb = frameNb
+            if running != self.acqRunning:
+                self.device.push_change_event('acqRunning', running)
+                self.acqRunning = running
+
 class Mythen3 (PyTango.Device_4Impl):
 
     Core.DEB_CLASS(Core.DebModApplication, 'LimaCCDs')
@@ -85,10 +129,22 @@ class Mythen3 (PyTango.Device_4Impl):
 
         
     def delete_device(self):
-        pass
+        self.stopEvents()
 
     def init_device(self):
         self.get_device_properties(self.get_device_class())
+        if not hasattr(self, 'eventThread'):
+            self.eventThread = None
+        self.stopEvents()
+        self.lastFrame = numpy.zeros(0, numpy.uint32)
+        self.lastFrameNb = -1
+        self.lastRoiSums = numpy.zeros(0, numpy.int64)
+        self.lastPeaks = numpy.zeros(0, numpy.float64)
+        self.eventMaxRate = 10.0
+        self.eventDecimation = 1
+        for name in ('acqRunning', 'lastFrame', 'lastFrameNumber', 'lastPeaks', 'lastRoiSums'):
+            self.set_change_event(name, True, False)
+            self.set_data_ready_event(name, True)
         self.set_state(PyTango.DevState.ON)
         self.nbModules = _Mythen3Camera.getNbModules()
         self.module = 65535;
@@ -111,6 +167,58 @@ class Mythen3 (PyTango.Device_4Impl):
         self.set_wattribute("kthresh", [6.4])
         self.set_wattribute("tau", [197.6159])
         self.set_wattribute("useRawReadout", "OFF")
+        self.set_wattribute("scanMode", "OFF")
+        self.set_wattribute("autoReconnect", "ON")
+        self.set_wattribute("eventStreaming", "OFF")
+        self.set_wattribute("eventMaxRate", self.eventMaxRate)
+        self.set_wattribute("eventDecimation", self.eventDecimation)
+
+    def startEvents(self):
+        if self.eventThread is None:
+            self.eventThread = EventThread(self)
+            self.eventThread.maxRate = self.eventMaxRate
+            self.eventThread.decimation = self.eventDecimation
+            self.eventThread.start()
+
+    def stopEvents(self):
+        if self.eventThread is not None:
+            self.eventThread.stop()
+            self.eventThread = None
+
+    def pushFrame(self, frameNb, decimation):
+        """Push the events of frame frameNb, summed over decimation channels,
+        and of its ROI sums and peaks. The binned frames of the camera are
+        used when binned by decimation. Called with the device monitor held."""
+        try:
+            if decimation > 1 and _Mythen3Camera.getChannelBinning() == decimation:
+                frame = _Mythen3Camera.readBinnedFramesArray(frameNb, 1).ravel()
+                decimation = 1
+            else:
+                frame = _Mythen3Camera.readFrameArray(frameNb)
+        except Exception:
+            return  # overwritten in the ring meanwhile, the next poll sends a newer one
+        try:
+            self.lastRoiSums = _Mythen3Camera.readRoiSumsArray(frameNb, 1).ravel()
+        except Exception:
+            self.lastRoiSums = numpy.zeros(0, numpy.int64)  # no ROI configured
+        try:
+            self.lastPeaks = _Mythen3Camera.readPeaksArray(frameNb, 1)[:, 1:].ravel()
+        except Exception:
+            self.lastPeaks = numpy.zeros(0, numpy.float64)  # no peak search
+        if decimation > 1:
+            points = len(frame) // decimation
+            frame = frame[:points * decimation].reshape(points, decimation).sum(axis=1, dtype=numpy.uint32)
+        else:
+            frame = frame.copy()  # kept past the next wrap of the ring
+        self.lastFrame = frame
+        self.lastFrameNb = frameNb
+        self.push_change_event('lastFrame', self.lastFrame)
+        self.push_change_event('lastFrameNumber', self.lastFrameNb)
+        self.push_change_event('lastRoiSums', self.lastRoiSums)
+        self.push_change_event('lastPeaks', self.lastPeaks)
+        self.push_data_ready_event('lastFrame', frameNb)
+        self.push_data_ready_event('lastRoiSums', frameNb)
+        self.push_data_ready_event('lastPeaks', frameNb)
 
     def set_wattribute(self, attr_name, value):
         attr = Mythen3.get_device_attr(self).get_attr_by_name(attr_name)
@@ -126,11 +234,7 @@ class Mythen3 (PyTango.Device_4Impl):
 
     @Core.DEB_MEMBER_FUNCT
     def read_badChannels(self, attr):
-        data = _Mythen3Camera.getBadChannels()
-        __dataflat_cache = numpy.array(data.buffer)
-        __dataflat_cache.dtype = numpy.int32
-        data.releaseBuffer()
-        attr.set_value(__dataflat_cache)
+        attr.set_value(_Mythen3Camera.getBadChannelsArray())
 
     @Core.DEB_MEMBER_FUNCT
     def read_commandID(self, attr):
@@ -270,11 +374,7 @@ class Mythen3 (PyTango.Device_4Impl):
 
     @Core.DEB_MEMBER_FUNCT
     def read_flatField(self, attr):
-        data = _Mythen3Camera.getFlatField()
-        __dataflat_cache = numpy.array(data.buffer)
-        __dataflat_cache.dtype = numpy.int32
-        data.releaseBuffer()
-        attr.set_value(__dataflat_cache)
+        attr.set_value(_Mythen3Camera.getFlatFieldArray())
 
     @Core.DEB_MEMBER_FUNCT
     def read_rateCorrection(self, attr):
@@ -374,11 +474,7 @@ class Mythen3 (PyTango.Device_4Impl):
 
     @Core.DEB_MEMBER_FUNCT
     def read_testPattern(self, attr):
-        data = _Mythen3Camera.getTestPattern()
-        __dataflat_cache = numpy.array(data.buffer)
-        __dataflat_cache.dtype = numpy.uint32
-        data.releaseBuffer()
-        attr.set_value(__dataflat_cache)
+        attr.set_value(_Mythen3Camera.getTestPatternArray())
 
     def read_acqRunning(self, attr):
         attr.set_value(_Mythen3Camera.isAcqRunning())
@@ -394,6 +490,271 @@ class Mythen3 (PyTango.Device_4Impl):
         mode = AttrHelper.getDictValue(self.__Switch, data)
         _Mythen3Camera.setUseRawReadout(mode)
 
+    @Core.DEB_MEMBER_FUNCT
+    def read_scanMode(self, attr):
+        mode = _Mythen3Camera.getScanMode()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_scanMode(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setScanMode(mode)
+
+    def read_startLatency(self, attr):
+        attr.set_value(_Mythen3Camera.getStartLatency())
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_autoReconnect(self, attr):
+        mode = _Mythen3Camera.getAutoReconnect()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_autoReconnect(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setAutoReconnect(mode)
+
+    def read_nbReconnects(self, attr):
+        attr.set_value(_Mythen3Camera.getNbReconnects())
+
+    def read_recvBufferSize(self, attr):
+        attr.set_value(_Mythen3Camera.getRecvBufferSize())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_recvBufferSize(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setRecvBufferSize(data)
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_quickAck(self, attr):
+        mode = _Mythen3Camera.getQuickAck()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_quickAck(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setQuickAck(mode)
+
+    def read_busyPoll(self, attr):
+        attr.set_value(_Mythen3Camera.getBusyPoll())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_busyPoll(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setBusyPoll(data)
+
+    def read_readsPerFrame(self, attr):
+        attr.set_value(_Mythen3Camera.getReadsPerFrame())
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_ioUring(self, attr):
+        mode = _Mythen3Camera.getIoUring()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_ioUring(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setIoUring(mode)
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_profiling(self, attr):
+        mode = _Mythen3Camera.getProfiling()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_profiling(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setProfiling(mode)
+
+    def read_profile(self, attr):
+        stages = [{'stage': s.stage, 'frames': s.frames,
+                   'instructions': s.instructions, 'cycles': s.cycles,
+                   'cache_misses': s.cacheMisses, 'branch_misses': s.branchMisses}
+                  for s in _Mythen3Camera.getProfile()]
+        attr.set_value(json.dumps(stages))
+
+    def read_simulationSpeed(self, attr):
+        attr.set_value(_Mythen3Camera.getSimulationSpeed())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_simulationSpeed(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setSimulationSpeed(data)
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_eventStreaming(self, attr):
+        attr.set_value('OFF' if self.eventThread is None else 'ON')
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_eventStreaming(self, attr):
+        data = attr.get_write_value()
+        if AttrHelper.getDictValue(self.__Switch, data) == Mythen3Acq.Camera.ON:
+            self.startEvents()
+        else:
+            self.stopEvents()
+
+    def read_eventMaxRate(self, attr):
+        attr.set_value(self.eventMaxRate)
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_eventMaxRate(self, attr):
+        data = attr.get_write_value()
+        if data <= 0:
+            PyTango.Except.throw_exception('Mythen3', 'eventMaxRate must be positive', 'write_eventMaxRate')
+        self.eventMaxRate = data
+        if self.eventThread is not None:
+            self.eventThread.maxRate = data
+
+    def read_eventDecimation(self, attr):
+        attr.set_value(self.eventDecimation)
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_eventDecimation(self, attr):
+        data = attr.get_write_value()
+        if data < 1 or data > MaxEventDecimation:
+            PyTango.Except.throw_exception('Mythen3', 'eventDecimation out of 1..%d' % MaxEventDecimation,
+                                           'write_eventDecimation')
+        self.eventDecimation = data
+        if self.eventThread is not None:
+            self.eventThread.decimation = data
+
+    def read_lastFrame(self, attr):
+        attr.set_value(self.lastFrame)
+
+    def read_lastFrameNumber(self, attr):
+        attr.set_value(self.lastFrameNb)
+
+    def read_lastPeaks(self, attr):
+        attr.set_value(self.lastPeaks)
+
+    def read_peakSearch(self, attr):
+        attr.set_value(list(_Mythen3Camera.getPeakSearch()))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_peakSearch(self, attr):
+        data = attr.get_write_value()
+        if len(data) != 2:
+            PyTango.Except.throw_exception('Mythen3', 'peakSearch must be threshold and minimum width',
+                                           'write_peakSearch')
+        _Mythen3Camera.setPeakSearch(data[0], data[1])
+
+    def read_lastRoiSums(self, attr):
+        attr.set_value(self.lastRoiSums)
+
+    def read_accumulation(self, attr):
+        attr.set_value(_Mythen3Camera.getAccumulation())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_accumulation(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setAccumulation(data)
+
+    def read_angularCalibration(self, attr):
+        centre, conversion, offset = _Mythen3Camera.getAngularCalibration()
+        attr.set_value([value for module in zip(centre, conversion, offset) for value in module])
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_angularCalibration(self, attr):
+        data = attr.get_write_value()
+        if len(data) % 3:
+            PyTango.Except.throw_exception('Mythen3', 'angularCalibration must be triplets of centre, conversion and offset',
+                                           'write_angularCalibration')
+        _Mythen3Camera.setAngularCalibration(list(data[0::3]), list(data[1::3]), list(data[2::3]))
+
+    def read_rebinning(self, attr):
+        attr.set_value(list(_Mythen3Camera.getRebinning()))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_rebinning(self, attr):
+        data = attr.get_write_value()
+        if len(data) != 3:
+            PyTango.Except.throw_exception('Mythen3', 'rebinning must be start, end and bin size',
+                                           'write_rebinning')
+        _Mythen3Camera.setRebinning(data[0], data[1], data[2])
+
+    def read_rebinAngles(self, attr):
+        attr.set_value(_Mythen3Camera.getRebinAngles())
+
+    def read_channelBinning(self, attr):
+        attr.set_value(_Mythen3Camera.getChannelBinning())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_channelBinning(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setChannelBinning(data)
+
+    def read_channelStats(self, attr):
+        mode = _Mythen3Camera.getChannelStats()
+        attr.set_value(AttrHelper.getDictKey(self.__Switch, mode))
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_channelStats(self, attr):
+        data = attr.get_write_value()
+        mode = AttrHelper.getDictValue(self.__Switch, data)
+        _Mythen3Camera.setChannelStats(mode)
+
+    def read_channelStatsWindow(self, attr):
+        attr.set_value(_Mythen3Camera.getChannelStatsWindow())
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_channelStatsWindow(self, attr):
+        data = attr.get_write_value()
+        _Mythen3Camera.setChannelStatsWindow(data)
+
+    @Core.DEB_MEMBER_FUNCT
+    def read_channelHealth(self, attr):
+        attr.set_value(_Mythen3Camera.checkChannels())
+
+    def read_rois(self, attr):
+        first, last = _Mythen3Camera.getRois()
+        attr.set_value([channel for roi in zip(first, last) for channel in roi])
+
+    @Core.DEB_MEMBER_FUNCT
+    def write_rois(self, attr):
+        data = attr.get_write_value()
+        if len(data) % 2:
+            PyTango.Except.throw_exception('Mythen3', 'rois must be pairs of first and last channels',
+                                           'write_rois')
+        _Mythen3Camera.setRois(list(data[0::2]), list(data[1::2]))
+
+    def read_metrics(self, attr):
+        attr.set_value(_Mythen3Camera.getMetrics())
+
+    def read_cmdStatNames(self, attr):
+        attr.set_value([s.name for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatCounts(self, attr):
+        attr.set_value([s.count for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatBytes(self, attr):
+        attr.set_value([s.bytes for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatErrors(self, attr):
+        attr.set_value([s.errors for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatFailures(self, attr):
+        attr.set_value([s.failures for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatLatencyP50(self, attr):
+        attr.set_value([s.p50 for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatLatencyP99(self, attr):
+        attr.set_value([s.p99 for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatLatencyMax(self, attr):
+        attr.set_value([s.max for s in _Mythen3Camera.getStatistics()])
+
+    def read_cmdStatErrorCodes(self, attr):
+        errors = []
+        for s in _Mythen3Camera.getStatistics():
+            for code, count in zip(s.errorCodes, s.errorCounts):
+                errors.append('%s %d %d' % (s.name, code, count))
+        attr.set_value(errors)
+
 #-----------------------------------------------------------------------------
     #    Mythen3 command methods
     #-----------------------------------------------------------------------------
@@ -410,6 +771,26 @@ class Mythen3 (PyTango.Device_4Impl):
     def LogRead(self):
        return _Mythen3Camera.logRead()
 
+    @Core.DEB_MEMBER_FUNCT
+    def StartRecording(self, fileName):
+        _Mythen3Camera.startRecording(fileName)
+
+    @Core.DEB_MEMBER_FUNCT
+    def StopRecording(self):
+        _Mythen3Camera.stopRecording()
+
+    @Core.DEB_MEMBER_FUNCT
+    def ResetStatistics(self):
+        _Mythen3Camera.resetStatistics()
+
+    @Core.DEB_MEMBER_FUNCT
+    def StartMetricsExport(self, target):
+        _Mythen3Camera.startMetricsExport(target)
+
+    @Core.DEB_MEMBER_FUNCT
+    def StopMetricsExport(self):
+        _Mythen3Camera.stopMetricsExport()
+
     @Core.DEB_MEMBER_FUNCT
     def ResetMythen(self):
         _Mythen3Camera.resetMythen()        
@@ -417,19 +798,36 @@ class Mythen3 (PyTango.Device_4Impl):
 
     @Core.DEB_MEMBER_FUNCT
     def ReadFrame(self, argin):
-        data = _Mythen3Camera.readFrame(argin)
-        __dataflat_cache = numpy.array(data.buffer)
-        __dataflat_cache.dtype = numpy.uint32
-        data.releaseBuffer()
-        return __dataflat_cache
+        return _Mythen3Camera.readFrameArray(argin)
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadRoiSums(self, argin):
+        return _Mythen3Camera.readRoiSumsArray(argin[0], argin[1]).ravel()
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadAccFrameInfo(self, argin):
+        info, saturated = _Mythen3Camera.getAccFrameInfo(argin)
+        return [info.subFrames, info.saturatedSubFrames, info.start, info.end] + list(saturated)
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadRebinned(self, argin):
+        return _Mythen3Camera.readRebinnedArray(argin[0], argin[1]).ravel()
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadPeaks(self, argin):
+        return _Mythen3Camera.readPeaksArray(argin[0], argin[1]).ravel()
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadBinnedFrames(self, argin):
+        return _Mythen3Camera.readBinnedFramesArray(argin[0], argin[1]).ravel()
+
+    @Core.DEB_MEMBER_FUNCT
+    def ReadChannelStats(self):
+        return _Mythen3Camera.readChannelStatsArray().ravel()
 
     @Core.DEB_MEMBER_FUNCT
     def ReadData(self):
-        data = _Mythen3Camera.readData()
-        __dataflat_cache = numpy.array(data.buffer.ravel())
-        __dataflat_cache.dtype = numpy.uint32
-        data.releaseBuffer()
-        return __dataflat_cache
+        return _Mythen3Camera.readDataArray().ravel()
 
 class Mythen3Class(PyTango.DeviceClass):
 
@@ -469,12 +867,45 @@ class Mythen3Class(PyTango.DeviceClass):
         'ResetMythen':
             [[PyTango.DevVoid, "none"],
             [PyTango.DevVoid, "none"]],
+        'ResetStatistics':
+            [[PyTango.DevVoid, "none"],
+            [PyTango.DevVoid, "none"]],
+        'StartMetricsExport':
+            [[PyTango.DevString, "metrics file name or unix:socket path"],
+            [PyTango.DevVoid, "none"]],
+        'StopMetricsExport':
+            [[PyTango.DevVoid, "none"],
+            [PyTango.DevVoid, "none"]],
+        'StartRecording':
+            [[PyTango.DevString, "recording file name"],
+            [PyTango.DevVoid, "none"]],
+        'StopRecording':
+            [[PyTango.DevVoid, "none"],
+            [PyTango.DevVoid, "none"]],
         'ReadFrame':
             [[PyTango.DevLong, "frame number"],
             [PyTango.DevVarULongArray, "a frame of mythen data"]],
         'ReadData':
             [[PyTango.DevVoid, "none"],
             [PyTango.DevVarULongArray, "all frames of mythen data"]],
+        'ReadRoiSums':
+            [[PyTango.DevVarLongArray, "first frame, most frames"],
+            [PyTango.DevVarLong64Array, "sums of each ROI, frame after frame"]],
+        'ReadBinnedFrames':
+            [[PyTango.DevVarLongArray, "first frame, most frames"],
+            [PyTango.DevVarULongArray, "binned frames, frame after frame"]],
+        'ReadChannelStats':
+            [[PyTango.DevVoid, "none"],
+            [PyTango.DevVarDoubleArray, "mean, variance, minimum and maximum of each channel"]],
+        'ReadPeaks':
+            [[PyTango.DevVarLongArray, "first frame, most frames"],
+            [PyTango.DevVarDoubleArray, "frame, position, height, area and width of each peak"]],
+        'ReadRebinned':
+            [[PyTango.DevVarLongArray, "first frame, most frames"],
+            [PyTango.DevVarFloatArray, "2theta pattern of each frame, frame after frame"]],
+        'ReadAccFrameInfo':
+            [[PyTango.DevLong, "frame number"],
+            [PyTango.DevVarDoubleArray, "sub-frames, saturated sub-frames, start, end, saturation flags"]],
         }
 
 
@@ -770,6 +1201,296 @@ class Mythen3Class(PyTango.DeviceClass):
              'label':'Raw readout Mode (packed)',
              'unit': 'ON/OFF',
                 }],
+        'scanMode':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Scan mode (cached configuration)',
+             'unit': 'ON/OFF',
+                }],
+        'startLatency':
+            [[PyTango.DevDouble,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Latency from start to first frame',
+             'unit': 's',
+                }],
+        'autoReconnect':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Reconnect and replay the configuration',
+             'unit': 'ON/OFF',
+                }],
+        'nbReconnects':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Number of automatic reconnections',
+                }],
+        'recvBufferSize':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Socket receive buffer size (0 = default)',
+             'unit': 'bytes',
+                }],
+        'quickAck':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Acknowledge replies at once',
+             'unit': 'ON/OFF',
+                }],
+        'busyPoll':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Socket busy poll time (0 = disabled)',
+             'unit': 'us',
+                }],
+        'readsPerFrame':
+            [[PyTango.DevDouble,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Receive calls per frame of the last acquisition',
+                }],
+        'cmdStatNames':
+            [[PyTango.DevString,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Commands with statistics',
+                }],
+        'cmdStatCounts':
+            [[PyTango.DevLong64,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Replies per command',
+                }],
+        'cmdStatBytes':
+            [[PyTango.DevLong64,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Reply bytes per command',
+             'unit': 'bytes',
+                }],
+        'cmdStatErrors':
+            [[PyTango.DevLong64,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Error replies per command',
+                }],
+        'cmdStatFailures':
+            [[PyTango.DevLong64,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Exchanges without a reply per command',
+                }],
+        'cmdStatLatencyP50':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Median reply latency per command',
+             'unit': 's',
+                }],
+        'cmdStatLatencyP99':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'99th percentile reply latency per command',
+             'unit': 's',
+                }],
+        'cmdStatLatencyMax':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Maximum reply latency per command',
+             'unit': 's',
+                }],
+        'cmdStatErrorCodes':
+            [[PyTango.DevString,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Error replies: command, status code, count',
+                }],
+        'profiling':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Hardware counters around the acquisition stages',
+             'unit': 'ON/OFF',
+                }],
+        'profile':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Counters per frame of each stage (JSON)',
+                }],
+        'simulationSpeed':
+            [[PyTango.DevDouble,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Pace of the simulated frames (1 = real time, 0 = no delay)',
+                }],
+        'eventStreaming':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Push the events of the last frame',
+             'unit': 'ON/OFF',
+                }],
+        'eventMaxRate':
+            [[PyTango.DevDouble,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Most frame events pushed per second',
+             'unit': 'Hz',
+                }],
+        'eventDecimation':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Channels summed per point of lastFrame',
+                }],
+        'lastFrame':
+            [[PyTango.DevULong,
+            PyTango.SPECTRUM,
+            PyTango.READ, 1280 * 24],
+            {
+             'label':'Last frame pushed, decimated',
+                }],
+        'lastFrameNumber':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Number of the last frame pushed',
+                }],
+        'lastPeaks':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ, 4 * 64],
+            {
+             'label':'Position, height, area and width of each peak of the last frame pushed',
+                }],
+        'peakSearch':
+            [[PyTango.DevLong,
+            PyTango.SPECTRUM,
+            PyTango.READ_WRITE, 2],
+            {
+             'label':'Threshold and minimum width of the peaks',
+                }],
+        'lastRoiSums':
+            [[PyTango.DevLong64,
+            PyTango.SPECTRUM,
+            PyTango.READ, 64],
+            {
+             'label':'Counts in each ROI of the last frame pushed',
+                }],
+        'accumulation':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Detector sub-frames summed per frame',
+                }],
+        'angularCalibration':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ_WRITE, 3 * 24],
+            {
+             'label':'Centre, conversion and offset of each module',
+                }],
+        'rebinning':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ_WRITE, 3],
+            {
+             'label':'Start, end and bin size of the 2theta patterns',
+             'unit': 'deg',
+                }],
+        'rebinAngles':
+            [[PyTango.DevDouble,
+            PyTango.SPECTRUM,
+            PyTango.READ, 1 << 16],
+            {
+             'label':'2theta of each bin of the patterns',
+             'unit': 'deg',
+                }],
+        'channelBinning':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Channels summed per channel of the binned frames',
+                }],
+        'channelStats':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Running statistics of each channel',
+             'unit': 'ON/OFF',
+                }],
+        'channelStatsWindow':
+            [[PyTango.DevLong,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Frames of the channel statistics, 0 for the acquisition',
+                }],
+        'channelHealth':
+            [[PyTango.DevLong,
+            PyTango.SPECTRUM,
+            PyTango.READ, 1280 * 24],
+            {
+             'label':'Deviation of each channel from the bad channel map',
+                }],
+        'rois':
+            [[PyTango.DevLong,
+            PyTango.SPECTRUM,
+            PyTango.READ_WRITE, 128],
+            {
+             'label':'First and last channel of each ROI',
+                }],
+        'metrics':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ],
+            {
+             'label':'Acquisition pipeline metrics (Prometheus text)',
+                }],
+        'ioUring':
+            [[PyTango.DevString,
+            PyTango.SCALAR,
+            PyTango.READ_WRITE],
+            {
+             'label':'Exchange commands over io_uring',
+             'unit': 'ON/OFF',
+                }],
         }
 
     def __init__(self, name) :
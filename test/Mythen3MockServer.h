@@ -0,0 +1,291 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3MOCKSERVER_H
+#define MYTHEN3MOCKSERVER_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Minimal Mythen3 socket server for the tests: listens on a loopback port,
+ * answers every command with a reply of the size the client expects and
+ * does not allocate while serving. Commands pipelined by the client in one
+ * segment are answered in order; an optional delay per segment emulates
+ * the network round trip.
+ */
+class Mythen3MockServer {
+public:
+	Mythen3MockServer(int nbModules = 1) :
+			m_nb_modules(nbModules), m_listen(-1), m_client(-1), m_nb_cmds(0),
+			m_quit(false), m_delay_us(0), m_stalled(false), m_bad_readout(false), m_nb_readouts(0), m_nbits(24),
+			m_reply(nbModules * 1280 * sizeof(uint32_t) + 64) {
+		m_failing[0] = '\0';
+	}
+
+	~Mythen3MockServer() {
+		stop();
+	}
+
+	// Start listening on a loopback port, ephemeral by default, and return it
+	int start(int port = 0) {
+		m_listen = socket(AF_INET, SOCK_STREAM, 0);
+		int opt = 1;
+		setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+		bind(m_listen, (struct sockaddr *) &addr, sizeof(addr));
+		listen(m_listen, 1);
+		socklen_t len = sizeof(addr);
+		getsockname(m_listen, (struct sockaddr *) &addr, &len);
+		m_thread = std::thread(&Mythen3MockServer::serve, this);
+		return ntohs(addr.sin_port);
+	}
+
+	void stop() {
+		if (m_listen < 0)
+			return;
+		m_quit = true;
+		shutdown(m_listen, SHUT_RDWR);
+		dropClient();
+		m_thread.join();
+		close(m_listen);
+		m_listen = -1;
+	}
+
+	// Close the current client connection, as a detector power cycle would
+	void dropClient() {
+		int client = m_client.exchange(-1);
+		if (client >= 0) {
+			shutdown(client, SHUT_RDWR);
+			close(client);
+		}
+	}
+
+	int getNbCommands() const {
+		return m_nb_cmds;
+	}
+
+	// The first count of the n-th frame read out since the reset is n
+	void resetReadouts() {
+		m_nb_readouts = 0;
+	}
+
+	// Number of times cmd is found among the last HistorySize commands
+	int countCommand(const char* cmd) {
+		std::lock_guard<std::mutex> lock(m_history_mutex);
+		int count = 0;
+		int nb = (m_nb_cmds < HistorySize) ? m_nb_cmds.load() : HistorySize;
+		for (int i = 0; i < nb; i++)
+			if (strcmp(m_history[i], cmd) == 0)
+				count++;
+		return count;
+	}
+
+	// Delay each received segment by delay_us, as a round trip would
+	void setDelay(int delay_us) {
+		m_delay_us = delay_us;
+	}
+
+	// Stop answering while keeping the connection open, as a detector that
+	// was switched off would
+	void setStalled(bool stalled) {
+		m_stalled = stalled;
+	}
+
+	// Read the bad channels as -2, as the detector does with the bad channel
+	// interpolation off. Channel 0 is then flagged bad too: frames start
+	// with -2.
+	void setBadChannelReadout(bool enable) {
+		m_bad_readout = enable;
+	}
+
+	// Answer cmd with -1 in every word of its reply until cleared with an
+	// empty cmd
+	void setFailingCommand(const char* cmd) {
+		std::lock_guard<std::mutex> lock(m_history_mutex);
+		strncpy(m_failing, cmd, CmdSize - 1);
+		m_failing[CmdSize - 1] = '\0';
+	}
+
+private:
+	void serve() {
+		char cmd[256];
+		while (!m_quit) {
+			int client = accept(m_listen, 0, 0);
+			if (client < 0)
+				break;
+			int opt = 1;
+			setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+			m_client = client;
+			int n;
+			while ((n = read(client, cmd, sizeof(cmd) - 1)) > 0) {
+				cmd[n] = '\0';
+				if (m_delay_us)
+					usleep(m_delay_us);
+				if (m_stalled)
+					continue;
+				if (!serveSegment(client, cmd, n))
+					break;
+			}
+			int expected = client;
+			if (m_client.compare_exchange_strong(expected, -1))
+				close(client);
+		}
+	}
+
+	// Split a segment at each '-' glued to the previous command and answer
+	// the commands in order. This is a rule of the mock only, the MYTHEN
+	// socket server has no command delimiter: it lets the pipelining tests
+	// check the client side ordering, not the behaviour of the detector.
+	bool serveSegment(int client, char* cmd, int n) {
+		int begin = 0;
+		for (int i = 1; i <= n; i++) {
+			if (i < n && !(cmd[i] == '-' && cmd[i - 1] != ' '))
+				continue;
+			char next = cmd[i];
+			cmd[i] = '\0';
+			record(cmd + begin);
+			int len = reply(cmd + begin);
+			cmd[i] = next;
+			if (write(client, &m_reply[0], len) != len)
+				return false;
+			begin = i;
+		}
+		return true;
+	}
+
+	void record(const char* cmd) {
+		std::lock_guard<std::mutex> lock(m_history_mutex);
+		char* entry = m_history[m_nb_cmds % HistorySize];
+		strncpy(entry, cmd, CmdSize - 1);
+		entry[CmdSize - 1] = '\0';
+		++m_nb_cmds;
+	}
+
+	// Fill the reply buffer for a command and return its length
+	int reply(const char* cmd) {
+		int len = answer(cmd);
+		if (isFailing(cmd))
+			memset(&m_reply[0], 0xff, len);
+		return len;
+	}
+
+	int answer(const char* cmd) {
+		int frameSize = m_nb_modules * 1280 * sizeof(uint32_t);
+		memset(&m_reply[0], 0, m_reply.size());
+		int32_t* iptr = reinterpret_cast<int32_t*>(&m_reply[0]);
+		long long* llptr = reinterpret_cast<long long*>(&m_reply[0]);
+		if (match(cmd, "-readout") || match(cmd, "-readoutraw") || match(cmd, "-testpattern")) {
+			for (int i = 0; i < frameSize / 4; i++)
+				iptr[i] = i % 1280;
+			if (match(cmd, "-readout"))
+				iptr[0] = m_nb_readouts++;
+			if (match(cmd, "-readout") && m_bad_readout) {
+				iptr[0] = -2;
+				for (int i = 5; i < frameSize / 4; i += 1280)
+					iptr[i] = -2;
+			}
+			// raw frames pack 32 / nbits channels per word
+			if (match(cmd, "-readoutraw"))
+				return frameSize / (32 / m_nbits);
+			return frameSize;
+		} else if (strncmp(cmd, "-nbits ", 7) == 0) {
+			m_nbits = atoi(cmd + 7);
+		} else if (match(cmd, "-get badchannels")) {
+			// channel 5 of each module is flagged bad
+			memset(iptr, 0, frameSize);
+			for (int i = 5; i < frameSize / 4; i += 1280)
+				iptr[i] = 1;
+			if (m_bad_readout)
+				iptr[0] = 1;
+			return frameSize;
+		} else if (match(cmd, "-get flatfield")) {
+			return frameSize;
+		} else if (match(cmd, "-get badchannelinterpolation")) {
+			iptr[0] = 0;
+		} else if (match(cmd, "-get nmodules")) {
+			iptr[0] = m_nb_modules;
+		} else if (match(cmd, "-get nbits")) {
+			iptr[0] = m_nbits;
+		} else if (match(cmd, "-get time")) {
+			llptr[0] = 10000000;
+			return sizeof(long long);
+		} else if (match(cmd, "-get delafter") || match(cmd, "-get delbef")) {
+			return sizeof(long long);
+		} else if (match(cmd, "-get frames")) {
+			iptr[0] = 1;
+		} else if (match(cmd, "-get version")) {
+			strcpy(&m_reply[0], "M3.0.1");
+			return 7;
+		} else if (match(cmd, "-get assemblydate")) {
+			return 50;
+		} else if (match(cmd, "-get modnum") || match(cmd, "-get energy")
+				|| match(cmd, "-get kthresh") || match(cmd, "-get tau")) {
+			return m_nb_modules * sizeof(int32_t);
+		}
+		return sizeof(int32_t);
+	}
+
+	bool isFailing(const char* cmd) {
+		std::lock_guard<std::mutex> lock(m_history_mutex);
+		return m_failing[0] && strcmp(cmd, m_failing) == 0;
+	}
+
+	static bool match(const char* cmd, const char* name) {
+		return strcmp(cmd, name) == 0;
+	}
+
+	static const int HistorySize = 64;
+	static const int CmdSize = 64;
+
+	int m_nb_modules;
+	int m_listen;
+	std::atomic<int> m_client;
+	std::atomic<int> m_nb_cmds;
+	std::atomic<bool> m_quit;
+	std::atomic<int> m_delay_us;
+	std::atomic<bool> m_stalled;
+	std::atomic<bool> m_bad_readout;
+	std::atomic<int> m_nb_readouts;
+	int m_nbits;
+	std::vector<char> m_reply;
+	std::mutex m_history_mutex;
+	char m_history[HistorySize][CmdSize];
+	char m_failing[CmdSize];
+	std::thread m_thread;
+};
+
+#endif // MYTHEN3MOCKSERVER_H
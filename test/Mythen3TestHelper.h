@@ -0,0 +1,88 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+#ifndef MYTHEN3TESTHELPER_H
+#define MYTHEN3TESTHELPER_H
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+
+#include <iostream>
+#include <unistd.h>
+
+namespace lima {
+namespace Mythen3 {
+
+// Frames/s of 32 bit frames of a full system saturating a 10 Gb/s link
+const double LinkFrameRate = 10e9 / 8 / (6 * PixelsPerModule * sizeof(uint32_t));
+
+// Print why a test failed, for use as "if (!ok && failed(msg)) return 1;"
+inline bool failed(const char* msg) {
+	std::cout << "FAILED: " << msg << std::endl;
+	return true;
+}
+
+// Whether a benchmark rate misses the detector link. Only optimized builds
+// are held to it, the rate of the others is printed only.
+inline bool slowerThanLink(double rate) {
+#ifdef __OPTIMIZE__
+	return rate < LinkFrameRate;
+#else
+	return false;
+#endif
+}
+
+/*
+ * A camera reset on a local mock server of nbModules modules, with a ring of
+ * nbBuffers frames. The server outlives the camera.
+ */
+class MockCamera {
+public:
+	MockCamera(int nbModules, int nbBuffers) :
+			server(nbModules), cam("127.0.0.1", server.start(), false), hw(cam) {
+		hw.reset(HwInterface::SoftReset);
+		cam.getBufferCtrlObj()->setNbBuffers(nbBuffers);
+	}
+
+	// Wait for the end of an acquisition of nbFrames frames
+	void wait(int nbFrames) {
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nbFrames)
+			usleep(100);
+	}
+
+	// Prepare, start and wait for an acquisition of nbFrames frames
+	void acquire(int nbFrames) {
+		hw.prepareAcq();
+		hw.startAcq();
+		wait(nbFrames);
+	}
+
+	Mythen3MockServer server;
+	Camera cam;
+	Interface hw;
+};
+
+} // namespace Mythen3
+} // namespace lima
+
+#endif // MYTHEN3TESTHELPER_H
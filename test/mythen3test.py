@@ -1,5 +1,6 @@
 import PyTango
 import numpy
+import threading
 import time
 
 dev=PyTango.DeviceProxy('d26s/mythen3/dcs1')
@@ -27,6 +28,19 @@ lima.write_attribute("saving_prefix","mythen_")
 lima.write_attribute("saving_mode","AUTO_FRAME")
 lima.write_attribute("saving_frames_per_file", nframes)
 
+# the device pushes the last frame and the end of the acquisition
+done = threading.Event()
+def frame_pushed(event):
+    if not event.err:
+        print "Frame pushed          :", event.attr_value.value
+def acq_running(event):
+    if not event.err and not event.attr_value.value:
+        done.set()
+dev.write_attribute("eventMaxRate", 4.0)
+dev.write_attribute("eventStreaming", "ON")
+frame_id = dev.subscribe_event("lastFrameNumber", PyTango.EventType.CHANGE_EVENT, frame_pushed)
+running_id = dev.subscribe_event("acqRunning", PyTango.EventType.CHANGE_EVENT, acq_running)
+
 # do acquisition
 lima.write_attribute("acq_nb_frames",nframes)
 lima.write_attribute("acq_expo_time",exp_time)
@@ -34,7 +48,9 @@ lima.write_attribute("acq_trigger_mode", "INTERNAL_TRIGGER")
 lima.command_inout("prepareAcq")
 lima.command_inout("startAcq")
 
-while dev.read_attribute("acqRunning").value :
-    time.sleep(0.5)
+done.clear()
+done.wait(nframes * exp_time + 10)
+dev.unsubscribe_event(frame_id)
+dev.unsubscribe_event(running_id)
 
 time.sleep(2)
@@ -0,0 +1,150 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Accumulation of sub-frames: each published frame is the sum of its
+// sub-frames, the detector is programmed with all the sub-frames, the
+// saturated sub-frames are flagged with their readout times, and sums that
+// could overflow 32 bits are refused. Bad channels read as -2 are left out
+// of the sums. The sum of sub-frames on one core is
+// benchmarked against the detector link and printed as JSON. The local
+// mock server stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3Accumulator.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	// one saturated channel flags its sub-frame only
+	const int width = PixelsPerModule;
+	vector<uint32_t> frame(width, 10), sub(width, 20);
+	sub[100] = 255;
+	if ((Mythen3Accumulator::saturated(&frame[0], width, 255)
+			|| !Mythen3Accumulator::add(&frame[0], &sub[0], width, 255)
+			|| frame[0] != 30 || frame[100] != 265) && failed("wrong sub-frame sum or flag"))
+		return 1;
+
+	const int nb_frames = 10;
+	const int nb_sub_frames = 4;
+
+	try {
+		MockCamera mock(1, nb_frames);
+		Camera& cam = mock.cam;
+
+		cam.setNbFrames(nb_frames);
+		cam.setAccumulation(nb_sub_frames);
+		int frames;
+		cam.getNbFrames(frames);
+		if (frames != nb_frames && failed("frames counted in sub-frames"))
+			return 1;
+		mock.server.resetReadouts();
+		mock.hw.prepareAcq();
+		if (mock.server.countCommand("-frames 40") != 1 && failed("sub-frames not programmed"))
+			return 1;
+		mock.hw.startAcq();
+		mock.wait(nb_frames);
+		double last_end = 0;
+		for (int f = 0; f < nb_frames; f++) {
+			Data data;
+			cam.readFrame(data, f);
+			const uint32_t* counts = (const uint32_t*) data.data();
+			// readouts 4f to 4f + 3 in channel 0
+			if ((counts[0] != 16U * f + 6 || counts[7] != 4 * 7U) && failed("wrong accumulated frame"))
+				return 1;
+			Camera::AccFrameInfo info;
+			vector<int> saturated;
+			cam.getAccFrameInfo(f, info, saturated);
+			if ((info.subFrames != nb_sub_frames || info.saturatedSubFrames != 0
+					|| saturated.size() != size_t(nb_sub_frames)) && failed("wrong record"))
+				return 1;
+			if ((info.start < last_end || info.end < info.start) && failed("wrong sub-frame times"))
+				return 1;
+			last_end = info.end;
+		}
+		cout << nb_frames << " frames of " << nb_sub_frames << " sub-frames, OK" << endl;
+
+		// at 8 bits, channels of 255 counts and more saturate every sub-frame
+		cam.setNbits(Camera::BPP8);
+		mock.acquire(nb_frames);
+		Camera::AccFrameInfo info;
+		vector<int> saturated;
+		cam.getAccFrameInfo(nb_frames - 1, info, saturated);
+		if ((info.saturatedSubFrames != nb_sub_frames || saturated[0] != 1) && failed("saturation not flagged"))
+			return 1;
+
+		// the -2 of the bad channels is neither summed nor taken as saturated
+		cam.setNbits(Camera::BPP24);
+		mock.server.setBadChannelReadout(true);
+		mock.acquire(nb_frames);
+		mock.server.setBadChannelReadout(false);
+		Data data;
+		cam.readFrame(data, nb_frames - 1);
+		const uint32_t* counts = (const uint32_t*) data.data();
+		cam.getAccFrameInfo(nb_frames - 1, info, saturated);
+		if ((counts[0] != BadChannelCount || counts[5] != BadChannelCount || counts[7] != 4 * 7U
+				|| info.saturatedSubFrames != 0) && failed("bad channels accumulated"))
+			return 1;
+		cout << "bad channels kept out of the sums, OK" << endl;
+
+		// 300 sub-frames of 24 bits do not fit 32 bits
+		cam.setAccumulation(300);
+		try {
+			mock.hw.prepareAcq();
+			failed("overflowing accumulation accepted");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+		cam.setAccumulation(1);
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	const int bench_frames = 20000;
+	vector<uint32_t> acc(nb_channels), bench(nb_channels, 3);
+	Timestamp t0 = Timestamp::now();
+	int nb_saturated = 0;
+	for (int f = 0; f < bench_frames; f++)
+		nb_saturated += Mythen3Accumulator::add(&acc[0], &bench[0], nb_channels, 255);
+	double elapsed = Timestamp::now() - t0;
+	double rate = bench_frames / elapsed;
+	cout << "{\"benchmark\": \"accumulate\", \"channels\": " << nb_channels
+			<< ", \"sub_frames_per_s\": " << rate << ", \"ns_per_channel\": "
+			<< elapsed * 1e9 / bench_frames / nb_channels << ", \"link_frames_per_s\": "
+			<< LinkFrameRate << "}" << endl;
+	if ((nb_saturated != 0 || acc[0] != 3U * bench_frames) && failed("wrong benchmark sum"))
+		return 1;
+	if (slowerThanLink(rate) && failed("accumulation slower than the detector link"))
+		return 1;
+	return 0;
+}
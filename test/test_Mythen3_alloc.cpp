@@ -0,0 +1,91 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Check that encoding and sending commands to the socket server does not
+// allocate: get/set/cmd requests are sent to a local mock server while
+// every operator new is counted.
+
+#include "Mythen3Camera.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static std::atomic<long> nbAllocs(0);
+
+void* operator new(size_t size) {
+	++nbAllocs;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+	const int nb_loops = 1000;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		int nbModules;
+		long long time;
+		cam.getNbModules(nbModules);
+
+		long before = nbAllocs;
+		for (int i = 0; i < nb_loops; i++) {
+			cam.getNbModules(nbModules);
+			cam.getTime(time);
+			cam.setTime(10000 + i);
+			cam.setKThresh(6.4f);
+			cam.setTriggered(Camera::OFF);
+			cam.start();
+			cam.stop();
+		}
+		long allocs = nbAllocs - before;
+
+		cout << 7 * nb_loops << " commands, " << allocs << " allocations" << endl;
+		if (allocs != 0) {
+			cout << "FAILED: commands allocate on the heap" << endl;
+			return 1;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
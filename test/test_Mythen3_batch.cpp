@@ -0,0 +1,113 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Read and apply the acquisition configuration in batches, with and without
+// command pipelining, against a local mock server which delays every
+// segment it receives as a network round trip would.
+
+#include "Mythen3Camera.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <sys/time.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool checkConfig(const Camera::AcqConfig& config) {
+	return config.nbits == Camera::BPP24 && config.time == 10000000 && config.frames == 1;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+	const int rtt_us = 1000;
+	const int nb_loops = 20;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		server.setDelay(rtt_us);
+		Camera::Switch modes[] = {Camera::OFF, Camera::ON};
+		for (int m = 0; m < 2; m++) {
+			cam.setCmdPipelining(modes[m]);
+			Camera::AcqConfig config;
+			int nb_cmds = server.getNbCommands();
+			double t0 = now();
+			for (int i = 0; i < nb_loops; i++) {
+				cam.getAcqConfig(config);
+				if (!checkConfig(config)) {
+					cout << "FAILED: wrong configuration read back" << endl;
+					return 1;
+				}
+				cam.setAcqConfig(config);
+			}
+			double elapsed = (now() - t0) / nb_loops;
+			nb_cmds = server.getNbCommands() - nb_cmds;
+			cout << "pipelining " << (modes[m] == Camera::ON ? "ON " : "OFF") << ": "
+			     << nb_cmds / nb_loops << " commands, " << elapsed * 1e3 << " ms per get+set" << endl;
+		}
+
+		// A failed command must not consume the replies pipelined behind it
+		server.setDelay(0);
+		server.setFailingCommand("-get delbef");
+		Camera::AcqConfig config;
+		try {
+			cam.getAcqConfig(config);
+			cout << "FAILED: error reply not reported" << endl;
+			return 1;
+		} catch (Exception &e) {
+		}
+		server.setFailingCommand("");
+		cam.getAcqConfig(config);
+		if (!checkConfig(config)) {
+			cout << "FAILED: replies out of step after an error reply" << endl;
+			return 1;
+		}
+
+		// 0 frames is programmed as a continuous acquisition, as setNbFrames()
+		config.frames = 0;
+		cam.setAcqConfig(config);
+		char cmd[32];
+		snprintf(cmd, sizeof(cmd), "-frames %d", ContinuousHwFrames);
+		if (server.countCommand(cmd) != 1) {
+			cout << "FAILED: continuous frames not mapped" << endl;
+			return 1;
+		}
+		cout << "error reply and continuous frames OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
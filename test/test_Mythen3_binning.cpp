@@ -0,0 +1,128 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Binned frames made during the acquisition: groups of channels are summed
+// for every supported factor and saturate at 32 bits, the binned frames read
+// back match the full frames, a factor not dividing a module is refused,
+// and a full system is binned on one core faster than the detector frames
+// can reach the host. The rate is printed as JSON. The local mock server
+// stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3ChannelBinning.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+#include <cstdlib>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static bool binned(const uint32_t* frame, int width, int factor, const uint32_t* result) {
+	for (int b = 0; b < width / factor; b++) {
+		uint32_t sum = 0;
+		for (int i = 0; i < factor; i++)
+			sum += frame[b * factor + i];
+		if (result[b] != sum)
+			return false;
+	}
+	return true;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	vector<uint32_t> counts(PixelsPerModule), result(PixelsPerModule);
+	for (int c = 0; c < PixelsPerModule; c++)
+		counts[c] = rand() & 0xffffff;
+	const int factors[] = {2, 4, 5, 8, 16, 64};
+	for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+		Mythen3ChannelBinning::bin(&counts[0], PixelsPerModule, factors[f], &result[0]);
+		if (!binned(&counts[0], PixelsPerModule, factors[f], &result[0]) && failed("wrong binned channels"))
+			return 1;
+	}
+	counts[0] = counts[1] = 0xf0000000;
+	Mythen3ChannelBinning::bin(&counts[0], PixelsPerModule, 2, &result[0]);
+	if (result[0] != UINT32_MAX && failed("binned channel not saturated"))
+		return 1;
+
+	const int nb_frames = 8;
+	const int factor = 8;
+
+	try {
+		MockCamera mock(2, nb_frames);
+		Camera& cam = mock.cam;
+		cam.setNbFrames(nb_frames);
+		try {
+			cam.setChannelBinning(3);
+			failed("binning factor not dividing a module accepted");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+		cam.setChannelBinning(factor);
+		mock.server.resetReadouts();
+		mock.acquire(nb_frames);
+		Data frames;
+		cam.readBinnedFrames(frames, 0, nb_frames);
+		int width = 2 * PixelsPerModule / factor;
+		if ((frames.dimensions[0] != width || frames.dimensions[1] != nb_frames)
+				&& failed("wrong binned frames size"))
+			return 1;
+		const uint32_t* row = (const uint32_t*) frames.data();
+		for (int f = 0; f < nb_frames; f++, row += width) {
+			Data data;
+			cam.readFrame(data, f);
+			if (!binned((const uint32_t*) data.data(), 2 * PixelsPerModule, factor, row)
+					&& failed("wrong binned frame"))
+				return 1;
+		}
+		cout << nb_frames << " frames binned by " << factor << ", OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	vector<uint32_t> frame(nb_channels), bench(nb_channels / 4);
+	for (int c = 0; c < nb_channels; c++)
+		frame[c] = rand() & 0xffffff;
+	const int bench_frames = 20000;
+	Timestamp t0 = Timestamp::now();
+	for (int f = 0; f < bench_frames; f++) {
+		frame[0] = f;
+		Mythen3ChannelBinning::bin(&frame[0], nb_channels, 4, &bench[0]);
+	}
+	double elapsed = Timestamp::now() - t0;
+	double rate = bench_frames / elapsed;
+	cout << "{\"benchmark\": \"channel_binning\", \"channels\": " << nb_channels << ", \"factor\": 4"
+			<< ", \"frames_per_s\": " << rate << ", \"link_frames_per_s\": " << LinkFrameRate << "}" << endl;
+	if (bench[1] != frame[4] + frame[5] + frame[6] + frame[7] && failed("wrong benchmark sum"))
+		return 1;
+	if (slowerThanLink(rate) && failed("channel binning slower than the detector link"))
+		return 1;
+	return 0;
+}
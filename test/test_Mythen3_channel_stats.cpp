@@ -0,0 +1,176 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Channel statistics kept during the acquisition: the Welford blocks match
+// a direct computation over the acquisition and over a sliding window, the
+// statistics read back match the mock frames, the channels deviating from
+// the bad channel map are flagged, and a full system is updated on one core
+// faster than the detector frames can reach the host. The rate is printed
+// as JSON. The local mock server stamps each frame with its number and
+// flags channel 5 of each module bad.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3ChannelStats.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static bool near(double value, double expected) {
+	return fabs(value - expected) <= 1e-9 * max(1.0, fabs(expected));
+}
+
+// the statistics of stats match those of frames first to last - 1
+static bool matches(const Mythen3ChannelStats& stats, const vector<vector<uint32_t> >& frames,
+		int first, int last) {
+	int width = stats.getWidth();
+	vector<double> mean(width), variance(width), low(width), high(width);
+	stats.get(&mean[0], &variance[0], &low[0], &high[0]);
+	if (stats.getNbFrames() != last - first)
+		return false;
+	for (int c = 0; c < width; c++) {
+		double sum = 0, lowest = 1e30, highest = -1;
+		for (int f = first; f < last; f++) {
+			sum += frames[f][c];
+			lowest = min<double>(lowest, frames[f][c]);
+			highest = max<double>(highest, frames[f][c]);
+		}
+		double average = sum / (last - first), squares = 0;
+		for (int f = first; f < last; f++)
+			squares += (frames[f][c] - average) * (frames[f][c] - average);
+		if (!near(mean[c], average) || !near(variance[c], squares / (last - first - 1))
+				|| low[c] != lowest || high[c] != highest)
+			return false;
+	}
+	return true;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	const int width = 2 * StatsChunk;
+	vector<vector<uint32_t> > frames(100, vector<uint32_t>(width));
+	for (size_t f = 0; f < frames.size(); f++)
+		for (int c = 0; c < width; c++)
+			frames[f][c] = 1000 * c + rand() % 100;
+	Mythen3ChannelStats stats;
+	stats.setEnabled(true);
+	stats.startAcq(width);
+	for (size_t f = 0; f < frames.size(); f++)
+		stats.compute(&frames[f][0]);
+	if (!matches(stats, frames, 0, frames.size()) && failed("wrong acquisition statistics"))
+		return 1;
+	// blocks of 2 frames: the 8 last complete blocks, the last one just filled
+	stats.setWindow(16);
+	stats.startAcq(width);
+	for (size_t f = 0; f < frames.size(); f++)
+		stats.compute(&frames[f][0]);
+	if (!matches(stats, frames, frames.size() - 16, frames.size()) && failed("wrong window statistics"))
+		return 1;
+	stats.compute(&frames[0][0]);
+	frames.push_back(frames[0]);
+	if (!matches(stats, frames, frames.size() - 17, frames.size()) && failed("wrong sliding window"))
+		return 1;
+
+	const int nb_frames = 100;
+
+	try {
+		MockCamera mock(2, 8);
+		Camera& cam = mock.cam;
+		cam.setNbFrames(nb_frames);
+		cam.setChannelStats(Camera::ON);
+		mock.server.resetReadouts();
+		mock.acquire(nb_frames);
+		Data data;
+		int frames_read;
+		cam.readChannelStats(data, frames_read);
+		const int channels = 2 * PixelsPerModule;
+		const double* rows = (const double*) data.data();
+		if ((data.dimensions[0] != channels || frames_read != nb_frames) && failed("wrong statistics size"))
+			return 1;
+		// channel 0 counts the frames, the others their channel in the module
+		if ((!near(rows[0], 49.5) || !near(rows[channels], 100 * 101 / 12.0) || rows[2 * channels] != 0
+				|| rows[3 * channels] != 99) && failed("wrong statistics of channel 0"))
+			return 1;
+		if ((rows[7] != 7 || rows[channels + 7] != 0 || rows[2 * channels + 7] != 7
+				|| rows[3 * channels + 7] != 7) && failed("wrong statistics of channel 7"))
+			return 1;
+
+		vector<int> health;
+		cam.checkChannels(health);
+		for (int c = 0; c < channels; c++) {
+			int expected = Camera::CONSISTENT;
+			if (c == 0)
+				expected = Camera::NOISY;
+			else if (c == PixelsPerModule)
+				expected = Camera::DEAD;
+			else if (c % PixelsPerModule == 5)
+				expected = Camera::RECOVERED;
+			if (health[c] != expected && failed("wrong channel health"))
+				return 1;
+		}
+		cout << "statistics of " << channels << " channels over " << nb_frames << " frames, OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	vector<uint32_t> frame(nb_channels);
+	for (int c = 0; c < nb_channels; c++)
+		frame[c] = rand() & 0xffff;
+	stats.setWindow(0);
+	stats.startAcq(nb_channels);
+	// best of several batches, the update being short enough to be skewed
+	// by the other tasks of the host
+	const int bench_batches = 10;
+	const int batch_frames = 2000;
+	double rate = 0, elapsed = 0;
+	for (int b = 0; b < bench_batches; b++) {
+		Timestamp t0 = Timestamp::now();
+		for (int f = 0; f < batch_frames; f++) {
+			frame[f % nb_channels] = f;
+			stats.compute(&frame[0]);
+		}
+		double batch = Timestamp::now() - t0;
+		if (batch_frames / batch > rate) {
+			rate = batch_frames / batch;
+			elapsed = batch;
+		}
+	}
+	cout << "{\"benchmark\": \"channel_stats\", \"channels\": " << nb_channels << ", \"frames_per_s\": "
+			<< rate << ", \"ns_per_channel\": " << elapsed * 1e9 / batch_frames / nb_channels
+			<< ", \"link_frames_per_s\": " << LinkFrameRate << "}" << endl;
+	if (stats.getNbFrames() != bench_batches * batch_frames && failed("wrong benchmark frames"))
+		return 1;
+	if (slowerThanLink(rate) && failed("channel statistics slower than the detector link"))
+		return 1;
+	return 0;
+}
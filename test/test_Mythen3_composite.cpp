@@ -0,0 +1,124 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Composite camera: three mock systems of 1, 2 and 3 modules are configured
+// in parallel, read out concurrently and stitched frame by frame, and a
+// system that fails its readout is reported.
+// Usage: test_Mythen3_composite
+
+#include "lima/Timestamp.h"
+#include "Mythen3Composite.h"
+#include "Mythen3TestHelper.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static void acquire(Mythen3Composite& composite, int nb_frames) {
+	composite.setNbFrames(nb_frames);
+	composite.prepareAcq();
+	composite.startAcq();
+	while (composite.isAcqRunning() || composite.getNbAcquiredFrames() < nb_frames) {
+		composite.checkFrames();
+		usleep(100);
+	}
+	composite.checkFrames();
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_systems = 3;
+	const int nb_frames = 20;
+	const int delay_us = 20000;
+	Mythen3MockServer server1(1), server2(2), server3(3);
+	Mythen3MockServer* servers[nb_systems] = { &server1, &server2, &server3 };
+	vector<string> hostnames;
+	for (int s = 0; s < nb_systems; s++) {
+		ostringstream os;
+		os << "127.0.0.1:" << servers[s]->start();
+		hostnames.push_back(os.str());
+	}
+
+	try {
+		Mythen3Composite composite(hostnames, 1031);
+		composite.reset();
+		composite.setNbBuffers(nb_frames);
+		acquire(composite, nb_frames);
+		int width;
+		composite.getWidth(width);
+		if (width != 6 * PixelsPerModule && failed("wrong stitched width"))
+			return 1;
+
+		// the mock stamps the first count of its n-th readout with n
+		for (int f = 0; f < nb_frames; f++) {
+			Data frame;
+			composite.readFrame(frame, f);
+			const uint32_t* counts = reinterpret_cast<const uint32_t*>(frame.data());
+			int offset = 0;
+			for (int s = 0; s < nb_systems; s++) {
+				if (counts[offset] != uint32_t(f) && failed("frames of a trigger not aligned"))
+					return 1;
+				offset += (s + 1) * PixelsPerModule;
+			}
+		}
+		cout << "stitched " << nb_frames << " frames of " << width << " channels" << endl;
+
+		// a configuration costs one round trip, not one per system
+		for (int s = 0; s < nb_systems; s++)
+			servers[s]->setDelay(delay_us);
+		Timestamp t0 = Timestamp::now();
+		composite.getCamera(0).setExpTime(0.002);
+		composite.getCamera(0).prepareAcq();
+		double single = Timestamp::now() - t0;
+		t0 = Timestamp::now();
+		composite.setExpTime(0.001);
+		composite.prepareAcq();
+		double all = Timestamp::now() - t0;
+		cout << "configuration: one system " << single * 1e3 << " ms, " << nb_systems
+				<< " systems " << all * 1e3 << " ms" << endl;
+		if (all > 2 * single && failed("systems not configured in parallel"))
+			return 1;
+		for (int s = 0; s < nb_systems; s++)
+			servers[s]->setDelay(0);
+
+		servers[1]->setFailingCommand("-readout");
+		try {
+			acquire(composite, nb_frames);
+			failed("failed readout of a system not reported");
+			return 1;
+		} catch (Exception& e) {
+			cout << "expected error: " << e << endl;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Synthetic frame generator: the counts follow the Poisson statistics of
+// the mean pattern, dead and hot channels are present, frames are
+// reproducible, and a full system is generated on one core faster than the
+// detector frames can reach the host. The rate is printed as JSON.
+// Usage: test_Mythen3_generator [nb_frames]
+
+#include "lima/Timestamp.h"
+#include "Mythen3TestHelper.h"
+#include "Mythen3Generator.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+int main(int argc, char* argv[]) {
+	const int nb_channels = 6 * PixelsPerModule;
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 20000;
+
+	Mythen3Generator generator(nb_channels);
+	vector<float> mean;
+	generator.getMean(mean);
+	vector<uint32_t> counts(nb_channels), again(nb_channels);
+	generator.generate(&counts[0], nb_channels, 7);
+	generator.generate(&again[0], nb_channels, 7);
+	if (counts != again && failed("frames not reproducible"))
+		return 1;
+	generator.generate(&again[0], nb_channels, 8);
+	if (counts == again && failed("successive frames identical"))
+		return 1;
+
+	// mean and variance over the frames of a background channel, a peak
+	// channel and a low count channel, within 5 standard errors
+	generator.setBadChannels(0.0f, 0.0f);
+	generator.clearPeaks();
+	generator.addPeak(1000.0f, 5.0f, 5000.0f);
+	generator.addPeak(3000.0f, 5.0f, -25.0f);
+	generator.getMean(mean);
+	const int channels[] = { 100, 1000, 3000 };
+	const int nb_stat_frames = 4000;
+	double sum[3] = { 0 }, sum2[3] = { 0 };
+	for (int f = 0; f < nb_stat_frames; f++) {
+		generator.generate(&counts[0], nb_channels, f);
+		for (int c = 0; c < 3; c++) {
+			sum[c] += counts[channels[c]];
+			sum2[c] += double(counts[channels[c]]) * counts[channels[c]];
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		double m = sum[c] / nb_stat_frames;
+		double var = sum2[c] / nb_stat_frames - m * m;
+		double lambda = mean[channels[c]];
+		cout << "channel " << channels[c] << ": mean " << lambda << ", measured " << m
+				<< ", variance " << var << endl;
+		if (fabs(m - lambda) > 5 * sqrt(lambda / nb_stat_frames) + 0.5
+				&& failed("counts not centred on the mean"))
+			return 1;
+		if (fabs(var - lambda) > 5 * lambda * sqrt(2.0 / nb_stat_frames) + 1
+				&& failed("variance not Poisson"))
+			return 1;
+	}
+
+	Mythen3Generator bad(nb_channels);
+	bad.setBadChannels(0.01f, 0.01f);
+	bad.getMean(mean);
+	bad.generate(&counts[0], nb_channels, 0);
+	int nb_dead = 0, nb_hot = 0;
+	for (int i = 0; i < nb_channels; i++) {
+		if (mean[i] == 0) {
+			nb_dead++;
+			if (counts[i] != 0 && failed("dead channel counting"))
+				return 1;
+		} else if (mean[i] == HotChannelCounts) {
+			nb_hot++;
+		}
+	}
+	if ((nb_dead < 40 || nb_hot < 40) && failed("dead or hot channels missing"))
+		return 1;
+
+	Mythen3Generator bench(nb_channels);
+	Timestamp t0 = Timestamp::now();
+	for (int f = 0; f < nb_frames; f++)
+		bench.generate(&counts[0], nb_channels, f);
+	double elapsed = Timestamp::now() - t0;
+	double rate = nb_frames / elapsed;
+	cout << "{\"benchmark\": \"generator\", \"channels\": " << nb_channels << ", \"frames\": "
+			<< nb_frames << ", \"frames_per_s\": " << rate << ", \"ns_per_channel\": "
+			<< elapsed * 1e9 / nb_frames / nb_channels << ", \"link_frames_per_s\": "
+			<< LinkFrameRate << "}" << endl;
+	if (slowerThanLink(rate) && failed("generator slower than the detector link"))
+		return 1;
+	return 0;
+}
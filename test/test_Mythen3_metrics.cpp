@@ -0,0 +1,149 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Pipeline metrics of acquisitions from a local mock server, exported to a
+// file and served on a Unix socket. Frames left unread while the buffer ring
+// wraps are counted as overruns once a frame has been read back.
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+// Value of metric in the Prometheus text, -1 if missing
+static double metricValue(const string& text, const string& metric) {
+	istringstream in(text);
+	string line;
+	while (getline(in, line)) {
+		if (line.compare(0, metric.size() + 1, metric + " ") == 0)
+			return atof(line.c_str() + metric.size() + 1);
+	}
+	return -1;
+}
+
+static string scrape(const string& path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		close(sock);
+		return "";
+	}
+	string response;
+	char buf[4096];
+	int n;
+	while ((n = read(sock, buf, sizeof(buf))) > 0)
+		response.append(buf, n);
+	close(sock);
+	return response;
+}
+
+static void acquire(Camera& cam, Interface& hw, int nb_frames) {
+	cam.setNbFrames(nb_frames);
+	hw.prepareAcq();
+	hw.startAcq();
+	while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+		usleep(100);
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+	const int nb_frames = 200;
+	const int nb_buffers = 4;
+	char fileName[] = "/tmp/test_Mythen3_metricsXXXXXX";
+	int fd = mkstemp(fileName);
+	close(fd);
+	string socketPath = string(fileName) + ".sock";
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+
+		cam.startMetricsExport(fileName, 0.05);
+		acquire(cam, hw, nb_frames);
+		usleep(200000);
+		ifstream file(fileName);
+		stringstream exported;
+		exported << file.rdbuf();
+		cout << exported.str();
+		if (metricValue(exported.str(), "mythen3_frames_total") != nb_frames
+				|| metricValue(exported.str(), "mythen3_bytes_total") != nb_frames * PixelsPerModule * 4.0) {
+			cout << "FAILED: frames not exported to the file" << endl;
+			return 1;
+		}
+
+		// frame 0 read back, frames 1 to nb_frames - nb_buffers - 1 overrun
+		cam.startMetricsExport(string(MetricsSocketPrefix) + socketPath);
+		cam.getBufferCtrlObj()->setNbBuffers(nb_buffers);
+		server.setDelay(1000);
+		cam.setNbFrames(nb_frames);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 1)
+			usleep(100);
+		Data frame;
+		cam.readFrame(frame, 0);
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+			usleep(100);
+		server.setDelay(0);
+		string response = scrape(socketPath);
+		cout << "overruns " << metricValue(response, "mythen3_overruns_total")
+				<< ", ring occupancy " << metricValue(response, "mythen3_ring_occupancy") << endl;
+		if (response.compare(0, 15, "HTTP/1.0 200 OK") != 0
+				|| metricValue(response, "mythen3_frames_total") != 2 * nb_frames
+				|| metricValue(response, "mythen3_overruns_total") != nb_frames - nb_buffers - 1
+				|| metricValue(response, "mythen3_ring_occupancy") != nb_buffers) {
+			cout << "FAILED: wrong metrics served on the socket" << endl;
+			return 1;
+		}
+		cam.stopMetricsExport();
+		if (access(socketPath.c_str(), F_OK) == 0) {
+			cout << "FAILED: socket left behind" << endl;
+			return 1;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		unlink(fileName);
+		return 1;
+	}
+	unlink(fileName);
+	return 0;
+}
@@ -0,0 +1,151 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Peak search during the acquisition: runs of channels above the threshold
+// are found with their centroid, height, area and width, narrow runs are
+// dropped, the peaks of every frame are read back as one list, and a full
+// system with twenty peaks per frame is searched on one core faster than
+// the detector frames can reach the host. The rate is printed as JSON. The
+// local mock server stamps each frame with its number. With the bad channel
+// interpolation off, the -2 of the bad channels must not reach the peaks,
+// the ROI sums or the binned channels.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3PeakSearch.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	// a symmetric peak, a single hot channel and a peak at the end
+	vector<uint32_t> frame(100, 5);
+	frame[20] = 50; frame[21] = 150; frame[22] = 50;
+	frame[40] = 1000;
+	frame[98] = 60; frame[99] = 80;
+	Mythen3PeakSearch::Peak peaks[MaxPeaks];
+	int nb_peaks = Mythen3PeakSearch::search(&frame[0], frame.size(), 50, 2, peaks, MaxPeaks);
+	if ((nb_peaks != 2 || peaks[0].position != 21 || peaks[0].height != 150 || peaks[0].area != 250
+			|| peaks[0].width != 3 || peaks[1].width != 2 || fabs(peaks[1].position - 98 - 30.0 / 40) > 1e-9)
+			&& failed("wrong peaks"))
+		return 1;
+	if (Mythen3PeakSearch::search(&frame[0], frame.size(), 50, 1, peaks, 1) != 1 && failed("too many peaks"))
+		return 1;
+
+	const int nb_frames = 8;
+
+	try {
+		MockCamera mock(2, nb_frames);
+		Camera& cam = mock.cam;
+		cam.setNbFrames(nb_frames);
+		// channels 1000 to 1279 of each module count from 1000 to 1279
+		cam.setPeakSearch(1000, 10);
+		mock.server.resetReadouts();
+		mock.acquire(nb_frames);
+		Data list;
+		cam.readPeaks(list, 0, nb_frames);
+		if ((list.dimensions[0] != 5 || list.dimensions[1] != 2 * nb_frames) && failed("wrong peak list size"))
+			return 1;
+		// centroid of 0 to 279 counts above the threshold
+		double centroid = 1000 + (2 * 279 + 1) / 3.0;
+		const double* row = (const double*) list.data();
+		for (int p = 0; p < 2 * nb_frames; p++, row += 5) {
+			double position = centroid + (p % 2) * PixelsPerModule;
+			if ((row[0] != p / 2 || fabs(row[1] - position) > 1e-6 || row[2] != 1279 || row[4] != 280)
+					&& failed("wrong peak"))
+				return 1;
+		}
+		cout << 2 * nb_frames << " peaks in " << nb_frames << " frames, OK" << endl;
+
+		// no channel reaches the threshold: 5 columns, no row
+		cam.setPeakSearch(100000, 1);
+		mock.acquire(nb_frames);
+		cam.readPeaks(list, 0, nb_frames);
+		if ((list.dimensions.size() != 2 || list.dimensions[0] != 5 || list.dimensions[1] != 0
+				|| list.size() != 0 || !list.data()) && failed("wrong empty peak list"))
+			return 1;
+
+		// channels 0 and 5 of each module read -2, masked as the average of
+		// their neighbours: 1 and 5
+		mock.server.setBadChannelReadout(true);
+		cam.setPeakSearch(1000, 1);
+		cam.setRois(vector<int>(1, 0), vector<int>(1, 9));
+		cam.setChannelBinning(2);
+		mock.acquire(nb_frames);
+		mock.server.setBadChannelReadout(false);
+		Data frame, sums, binned;
+		cam.readFrame(frame, 0);
+		cam.readPeaks(list, 0, nb_frames);
+		cam.readRoiSums(sums, 0, 1);
+		cam.readBinnedFrames(binned, 0, 1);
+		if (*(const uint32_t*) frame.data() != BadChannelCount && failed("bad channel not read as -2"))
+			return 1;
+		if (list.dimensions[1] != 2 * nb_frames && failed("bad channels found as peaks"))
+			return 1;
+		const uint32_t* pairs = (const uint32_t*) binned.data();
+		if ((*(const int64_t*) sums.data() != 46 || pairs[0] != 2 || pairs[2] != 9)
+				&& failed("bad channels summed"))
+			return 1;
+		cout << "bad channels masked, OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	const int nb_bench_peaks = 20;
+	vector<uint32_t> counts(nb_channels);
+	for (int c = 0; c < nb_channels; c++)
+		counts[c] = rand() % 100;
+	for (int p = 0; p < nb_bench_peaks; p++) {
+		int centre = (p + 1) * nb_channels / (nb_bench_peaks + 1);
+		for (int c = centre - 10; c <= centre + 10; c++)
+			counts[c] += static_cast<uint32_t>(10000 * exp(-(c - centre) * (c - centre) / 18.0));
+	}
+	const int bench_frames = 20000;
+	int found = 0;
+	Timestamp t0 = Timestamp::now();
+	for (int f = 0; f < bench_frames; f++) {
+		counts[0] = f % 100;
+		found += Mythen3PeakSearch::search(&counts[0], nb_channels, 500, 2, peaks, MaxPeaks);
+	}
+	double elapsed = Timestamp::now() - t0;
+	double rate = bench_frames / elapsed;
+	cout << "{\"benchmark\": \"peak_search\", \"channels\": " << nb_channels << ", \"peaks\": "
+			<< nb_bench_peaks << ", \"frames_per_s\": " << rate << ", \"link_frames_per_s\": "
+			<< LinkFrameRate << "}" << endl;
+	if (found != nb_bench_peaks * bench_frames && failed("wrong benchmark peaks"))
+		return 1;
+	if (slowerThanLink(rate) && failed("peak search slower than the detector link"))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,100 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Benchmark of the acquisition stages with the hardware performance
+// counters: a raw readout acquisition from a local mock server is profiled
+// and the counters per frame of each stage are printed as JSON. Without
+// counters (perf_event_paranoid above 2, no PMU in a virtual machine) the
+// profile is empty and the benchmark is skipped.
+// Usage: test_Mythen3_profile [nb_frames]
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_modules = 6;
+	Mythen3MockServer server(nb_modules);
+	int port = server.start();
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 1000;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.setNbModules(nb_modules);
+		cam.setNbits(Camera::BPP16);
+		cam.setUseRawReadout(Camera::ON);
+		cam.setProfiling(Camera::ON);
+
+		cam.setNbFrames(nb_frames);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+			usleep(100);
+
+		vector<Camera::StageProfile> profile;
+		cam.getProfile(profile);
+		if (profile.empty()) {
+			cout << "hardware performance counters not available, skipped" << endl;
+			return 0;
+		}
+		cout << "{\"benchmark\": \"profile\", \"modules\": " << nb_modules
+				<< ", \"frames\": " << nb_frames << ", \"stages\": [";
+		for (size_t i = 0; i < profile.size(); i++) {
+			const Camera::StageProfile& s = profile[i];
+			cout << (i ? ", " : "") << "{\"stage\": \"" << s.stage << "\", \"frames\": " << s.frames
+					<< ", \"instructions\": " << s.instructions << ", \"cycles\": " << s.cycles
+					<< ", \"cache_misses\": " << s.cacheMisses << ", \"branch_misses\": "
+					<< s.branchMisses << "}";
+		}
+		cout << "]}" << endl;
+		if (profile.size() != NB_PROFILE_STAGES) {
+			cout << "FAILED: expected the readout, decode, reduce and publish stages" << endl;
+			return 1;
+		}
+		for (size_t i = 0; i < profile.size(); i++) {
+			if (profile[i].frames != nb_frames) {
+				cout << "FAILED: " << profile[i].stage << " profiled for " << profile[i].frames
+						<< " frames" << endl;
+				return 1;
+			}
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
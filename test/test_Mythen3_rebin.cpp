@@ -0,0 +1,155 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// 2θ rebinning during the acquisition: the angle of a channel follows the
+// module calibration, a uniform frame is rebinned to a flat pattern where
+// the modules overlap too, the patterns read back match the frames, an
+// incomplete calibration is refused, and a full system is rebinned on one
+// core faster than the detector frames can reach the host. The rate is
+// printed as JSON. The local mock server stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3Rebin.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+#include <cmath>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+// channel pitch over sample distance of a Mythen module at 760 mm
+static const double Conversion = 50e-6 / 0.76;
+
+// modules side by side on the circle, overlapping by 20 channels
+static void calibrate(int nbModules, vector<double>& centre, vector<double>& conversion,
+		vector<double>& offset) {
+	double moduleAngle = (PixelsPerModule - 20) * Conversion * 180 / M_PI;
+	centre.assign(nbModules, PixelsPerModule / 2.0);
+	conversion.assign(nbModules, Conversion);
+	offset.clear();
+	for (int m = 0; m < nbModules; m++)
+		offset.push_back(10 + m * moduleAngle);
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_modules = 2;
+	vector<double> centre, conversion, offset;
+	calibrate(nb_modules, centre, conversion, offset);
+	if ((Mythen3Rebin::twoTheta(640, Conversion, 10, 640) != 10
+			|| Mythen3Rebin::twoTheta(640, Conversion, 10, 641) <= 10) && failed("wrong angle"))
+		return 1;
+
+	// a uniform frame gives a flat pattern wherever channels cover the bins
+	Mythen3Rebin rebin;
+	rebin.setCalibration(centre, conversion, offset);
+	rebin.setBinning(5, 25, 0.01);
+	rebin.build(nb_modules * PixelsPerModule, PixelsPerModule);
+	rebin.startAcq(1);
+	vector<uint32_t> frame(nb_modules * PixelsPerModule, 1000);
+	rebin.compute(0, &frame[0]);
+	vector<double> angles;
+	rebin.getAngles(angles);
+	double lowest = Mythen3Rebin::twoTheta(centre[0], Conversion, offset[0], -0.5);
+	double highest = Mythen3Rebin::twoTheta(centre[1], Conversion, offset[1], PixelsPerModule - 0.5);
+	const float* pattern = rebin.getRow(0);
+	for (int b = 0; b < rebin.getNbBins(); b++) {
+		bool covered = angles[b] > lowest + 0.01 && angles[b] < highest - 0.01;
+		bool outside = angles[b] < lowest - 0.01 || angles[b] > highest + 0.01;
+		if (((covered && fabs(pattern[b] - 1000) > 0.01) || (outside && pattern[b] != 0))
+				&& failed("uniform frame not flat"))
+			return 1;
+	}
+
+	const int nb_frames = 8;
+
+	try {
+		MockCamera mock(nb_modules, nb_frames);
+		Camera& cam = mock.cam;
+		cam.setNbFrames(nb_frames);
+
+		// the calibration must cover every module
+		cam.setAngularCalibration(vector<double>(1, centre[0]), vector<double>(1, conversion[0]),
+				vector<double>(1, offset[0]));
+		cam.setRebinning(5, 25, 0.01);
+		try {
+			mock.hw.prepareAcq();
+			failed("incomplete calibration accepted");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+
+		cam.setAngularCalibration(centre, conversion, offset);
+		mock.server.resetReadouts();
+		mock.acquire(nb_frames);
+		Data patterns;
+		cam.readRebinned(patterns, 0, nb_frames);
+		int nb_bins = rebin.getNbBins();
+		if ((patterns.dimensions[0] != nb_bins || patterns.dimensions[1] != nb_frames)
+				&& failed("wrong pattern table size"))
+			return 1;
+		const float* row = (const float*) patterns.data();
+		for (int f = 0; f < nb_frames; f++, row += nb_bins) {
+			Data data;
+			cam.readFrame(data, f);
+			rebin.compute(0, (const uint32_t*) data.data());
+			for (int b = 0; b < nb_bins; b++)
+				if (row[b] != rebin.getRow(0)[b] && failed("wrong rebinned pattern"))
+					return 1;
+		}
+		cout << "rebinned " << nb_frames << " frames into " << nb_bins << " bins, OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	calibrate(6, centre, conversion, offset);
+	rebin.setCalibration(centre, conversion, offset);
+	rebin.setBinning(5, 40, 0.004);
+	rebin.build(nb_channels, PixelsPerModule);
+	rebin.startAcq(1);
+	vector<uint32_t> counts(nb_channels);
+	for (int c = 0; c < nb_channels; c++)
+		counts[c] = c & 0xfff;
+	const int bench_frames = 20000;
+	Timestamp t0 = Timestamp::now();
+	for (int f = 0; f < bench_frames; f++) {
+		counts[0] = f;
+		rebin.compute(f, &counts[0]);
+	}
+	double elapsed = Timestamp::now() - t0;
+	double rate = bench_frames / elapsed;
+	cout << "{\"benchmark\": \"rebin\", \"channels\": " << nb_channels << ", \"bins\": "
+			<< rebin.getNbBins() << ", \"entries\": " << rebin.getNbEntries()
+			<< ", \"frames_per_s\": " << rate << ", \"link_frames_per_s\": " << LinkFrameRate << "}" << endl;
+	if (slowerThanLink(rate) && failed("rebinning slower than the detector link"))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,161 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Drop the connection of a local mock server, as a detector power cycle
+// would, and check that the camera reconnects, replays its configuration
+// and fails the running acquisition cleanly. A detector that stops
+// answering must fail the acquisition after the readout timeout. The
+// connection state must stay readable during the reconnection backoff.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3Net.h"
+#include "lima/Timestamp.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.setEnergy(8.05f);
+		cam.setNbits(Camera::BPP16);
+
+		// configuration replayed before the interrupted get is repeated
+		server.dropClient();
+		int nbModules;
+		cam.getNbModules(nbModules);
+		int nbReconnects;
+		cam.getNbReconnects(nbReconnects);
+		cout << "reconnections: " << nbReconnects << endl;
+		if (nbReconnects != 1 && failed("no reconnection"))
+			return 1;
+		if ((server.countCommand("-energy 8.05") != 2 || server.countCommand("-nbits 16") != 2)
+				&& failed("configuration not replayed"))
+			return 1;
+
+		// a continuous acquisition fails when the connection drops
+		cam.setNbFrames(0);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 10)
+			usleep(100);
+		server.dropClient();
+		while (cam.isAcqRunning())
+			usleep(100);
+		HwInterface::StatusType status;
+		hw.getStatus(status);
+		cout << "acquisition status after drop: " << status.acq << endl;
+		if (status.acq != AcqFault && failed("acquisition not failed"))
+			return 1;
+
+		// the next acquisition runs normally
+		cam.setNbFrames(5);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < 5)
+			usleep(100);
+		hw.getStatus(status);
+		if (status.acq != AcqReady && failed("acquisition after reconnection"))
+			return 1;
+
+		// a silent detector is given up after the frame period and the margin,
+		// and once more for the configuration replayed on reconnection
+		cam.setTrigMode(IntTrig);
+		cam.setExpTime(0.001);
+		cam.setNbFrames(0);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 10)
+			usleep(100);
+		server.setStalled(true);
+		Timestamp t0 = Timestamp::now();
+		while (cam.isAcqRunning())
+			usleep(1000);
+		double elapsed = Timestamp::now() - t0;
+		server.setStalled(false);
+		hw.getStatus(status);
+		cout << "acquisition status after " << elapsed << " s of silence: " << status.acq << endl;
+		if ((status.acq != AcqFault || elapsed > 2 * ReadoutTimeoutMargin + 1)
+				&& failed("silent detector not detected"))
+			return 1;
+
+		// without auto reconnection the error is reported
+		cam.setAutoReconnect(Camera::OFF);
+		server.dropClient();
+		try {
+			cam.getNbModules(nbModules);
+			failed("no error without auto reconnection");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	// the server comes back on the same port during the third backoff delay
+	Mythen3MockServer restarted;
+	try {
+		Mythen3Net net;
+		net.connectToServer("127.0.0.1", port);
+		server.stop();
+		bool reconnected = false;
+		std::thread reconnecting([&net, &reconnected]() {
+			try {
+				net.reconnect();
+				reconnected = true;
+			} catch (Exception &e) {
+			}
+		});
+		usleep(static_cast<useconds_t>(3.5 * ReconnectDelay * 1e6));
+		Timestamp t0 = Timestamp::now();
+		bool connected = net.isConnected();
+		double blocked = Timestamp::now() - t0;
+		restarted.start(port);
+		reconnecting.join();
+		cout << "connection state read in " << blocked * 1e3 << " ms during the backoff" << endl;
+		if ((connected || blocked > ReconnectDelay) && failed("connection state held up by the backoff"))
+			return 1;
+		if ((!reconnected || !net.isConnected()) && failed("no reconnection after the backoff"))
+			return 1;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
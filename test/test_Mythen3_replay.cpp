@@ -0,0 +1,106 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Record the traffic of an acquisition from a local mock server, then feed
+// a camera from the recording at the original speed and without delays and
+// check that the frames are identical.
+// Usage: test_Mythen3_replay [recording [speed [nb_frames]]]
+// With a recording, it is replayed and the frame rate reported.
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Timestamp.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static double acquire(Camera& cam, int nb_frames) {
+	Interface hw(cam);
+	hw.reset(HwInterface::SoftReset);
+	cam.setNbFrames(nb_frames);
+	Timestamp t0 = Timestamp::now();
+	hw.prepareAcq();
+	hw.startAcq();
+	while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+		usleep(10);
+	return Timestamp::now() - t0;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 3) ? atoi(argv[3]) : 200;
+	try {
+		if (argc > 1) {
+			Camera cam(string(ReplayPrefix) + argv[1], 0);
+			cam.setReplaySpeed((argc > 2) ? atof(argv[2]) : 1.0);
+			double elapsed = acquire(cam, nb_frames);
+			cout << nb_frames << " frames replayed in " << elapsed << " s, "
+			     << nb_frames / elapsed << " frames/s" << endl;
+			return 0;
+		}
+
+		const char* file = "test_Mythen3_replay.m3traf";
+		Mythen3MockServer server;
+		int port = server.start();
+		server.setDelay(200);
+		Data recorded;
+		double t_recorded;
+		{
+			Camera cam("127.0.0.1", port, false);
+			cam.startRecording(file);
+			t_recorded = acquire(cam, nb_frames);
+			cam.readFrame(recorded, nb_frames - 1);
+			cam.stopRecording();
+		}
+		cout << "recorded " << nb_frames << " frames in " << t_recorded << " s" << endl;
+
+		double speeds[] = {1.0, 0.0};
+		for (int i = 0; i < 2; i++) {
+			Camera cam(string(ReplayPrefix) + file, 0);
+			cam.setReplaySpeed(speeds[i]);
+			double elapsed = acquire(cam, nb_frames);
+			Data replayed;
+			cam.readFrame(replayed, nb_frames - 1);
+			cout << "replay speed " << speeds[i] << ": " << elapsed << " s" << endl;
+			if (replayed.size() != recorded.size()
+					|| memcmp(replayed.data(), recorded.data(), recorded.size())) {
+				cout << "FAILED: replayed frame differs from the recorded one" << endl;
+				return 1;
+			}
+		}
+		unlink(file);
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Read frames back from the buffer ring after it wrapped: the frames still
+// held are returned, older ones are reported as overwritten, and readData()
+// during a continuous acquisition never returns the buffer being written.
+// The local mock server stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static bool checkFrames(const Data& data, int width) {
+	int nb_frames = (data.dimensions.size() > 1) ? data.dimensions[1] : 1;
+	const uint32_t* frames = (const uint32_t*) data.data();
+	for (int i = 0; i < nb_frames; i++)
+		if (frames[i * width] != static_cast<uint32_t>(data.frameNumber + i))
+			return false;
+	return true;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+	const int nb_buffers = 4;
+	const int width = PixelsPerModule;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.getBufferCtrlObj()->setNbBuffers(nb_buffers);
+
+		// 10 frames in 4 buffers: frames 6 to 9 are left
+		server.resetReadouts();
+		cam.setNbFrames(10);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < 10)
+			usleep(100);
+		Data frame;
+		cam.readFrame(frame, 6);
+		if (!checkFrames(frame, width) && failed("wrong oldest frame"))
+			return 1;
+		try {
+			Data lost;
+			cam.readFrame(lost, 5);
+			failed("overwritten frame returned");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+		Data all;
+		cam.readData(all);
+		cout << "after wrap: frames " << all.frameNumber << " to "
+		     << all.frameNumber + all.dimensions[1] - 1 << endl;
+		if ((all.frameNumber != 6 || all.dimensions[1] != nb_buffers || !checkFrames(all, width))
+				&& failed("wrong frames after wrap"))
+			return 1;
+
+		// while running, the buffer being written is never returned
+		server.resetReadouts();
+		cam.setNbFrames(0);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 20)
+			usleep(100);
+		for (int i = 0; i < 1000; i++) {
+			Data running;
+			cam.readData(running);
+			if ((running.dimensions[1] >= nb_buffers || !checkFrames(running, width))
+					&& failed("frame being written returned"))
+				return 1;
+		}
+		hw.stopAcq();
+		while (cam.isAcqRunning())
+			usleep(100);
+		cout << "continuous: " << cam.getNbHwAcquiredFrames() << " frames, OK" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// ROI sums computed during the acquisition: the sums of channel ranges,
+// across modules too, are found in the table for every frame, the ROIs are
+// validated, and 16 ROIs covering a full system are summed on one core
+// faster than the detector frames can reach the host. The rate is printed
+// as JSON. The local mock server stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "Mythen3Roi.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+#include "lima/Timestamp.h"
+
+#include <cstdlib>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+// counts of the mock frames: the channel number in the module, the frame
+// number in channel 0
+static long long mockSum(int first, int last, long long frameNb) {
+	long long sum = 0;
+	for (int c = first; c <= last; c++)
+		sum += (c == 0) ? frameNb : c % PixelsPerModule;
+	return sum;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	vector<uint32_t> counts(6 * PixelsPerModule);
+	for (size_t i = 0; i < counts.size(); i++)
+		counts[i] = rand() & 0xffffff;
+	for (int n = 0; n < 40; n++) {
+		long long expected = 0;
+		for (int i = 0; i < n; i++)
+			expected += counts[3 + i];
+		if (Mythen3Roi::sum(&counts[3], n) != expected && failed("wrong sum"))
+			return 1;
+	}
+
+	const int nb_frames = 500;
+
+	try {
+		MockCamera mock(2, 8);
+		Camera& cam = mock.cam;
+
+		vector<int> first, last;
+		first.push_back(0); last.push_back(0);
+		first.push_back(1); last.push_back(10);
+		first.push_back(1270); last.push_back(1289);
+		first.push_back(0); last.push_back(2 * PixelsPerModule - 1);
+		cam.setRois(first, last);
+		mock.server.resetReadouts();
+		cam.setNbFrames(nb_frames);
+		mock.hw.prepareAcq();
+		mock.hw.startAcq();
+		try {
+			cam.setRois(first, last);
+			failed("ROIs changed during the acquisition");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+		mock.wait(nb_frames);
+		Data sums;
+		cam.readRoiSums(sums, 0, nb_frames);
+		if ((sums.dimensions[0] != 4 || sums.dimensions[1] != nb_frames) && failed("wrong table size"))
+			return 1;
+		const int64_t* row = (const int64_t*) sums.data();
+		for (int f = 0; f < nb_frames; f++, row += 4)
+			for (int r = 0; r < 4; r++)
+				if (row[r] != mockSum(first[r], last[r], f) && failed("wrong ROI sum"))
+					return 1;
+		cout << "ROI sums of " << nb_frames << " frames, OK" << endl;
+
+		// a ROI past the last channel is refused when the acquisition is prepared
+		first.push_back(2 * PixelsPerModule - 1);
+		last.push_back(2 * PixelsPerModule);
+		cam.setRois(first, last);
+		try {
+			mock.hw.prepareAcq();
+			failed("ROI past the last channel accepted");
+			return 1;
+		} catch (Exception &e) {
+			cout << "expected error: " << e << endl;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+
+	const int nb_channels = 6 * PixelsPerModule;
+	const int nb_rois = 16;
+	vector<int> first(nb_rois), last(nb_rois);
+	for (int r = 0; r < nb_rois; r++) {
+		first[r] = r * nb_channels / nb_rois;
+		last[r] = (r + 1) * nb_channels / nb_rois - 1;
+	}
+	Mythen3Roi roi;
+	roi.setRois(first, last);
+	roi.startAcq(0);
+	const int bench_frames = 20000;
+	Timestamp t0 = Timestamp::now();
+	for (int f = 0; f < bench_frames; f++)
+		roi.compute(f, &counts[0]);
+	double elapsed = Timestamp::now() - t0;
+	double rate = bench_frames / elapsed;
+	cout << "{\"benchmark\": \"roi\", \"channels\": " << nb_channels << ", \"rois\": " << nb_rois
+			<< ", \"frames_per_s\": " << rate << ", \"ns_per_channel\": "
+			<< elapsed * 1e9 / bench_frames / nb_channels << ", \"link_frames_per_s\": "
+			<< LinkFrameRate << "}" << endl;
+	if (slowerThanLink(rate) && failed("ROI sums slower than the detector link"))
+		return 1;
+	return 0;
+}
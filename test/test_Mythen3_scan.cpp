@@ -0,0 +1,86 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Per-point overhead of a step scan: prepareAcq/startAcq/readout of one
+// short frame per point, with and without scan mode.
+// Usage: test_Mythen3_scan [hostname [port [nb_points]]]
+// Without a hostname the simulator is used.
+
+#include "lima/Timestamp.h"
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static void runScan(Camera& cam, Interface& hw, int nb_points, bool scan_mode) {
+	cam.setScanMode(scan_mode ? Camera::ON : Camera::OFF);
+	cam.setNbFrames(1);
+	cam.setExpTime(1e-6);
+
+	double latency_sum = 0.;
+	Timestamp t0 = Timestamp::now();
+	for (int i = 0; i < nb_points; i++) {
+		cam.setExpTime(1e-6);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 1 || cam.isAcqRunning())
+			usleep(10);
+		double latency;
+		cam.getStartLatency(latency);
+		latency_sum += latency;
+	}
+	double elapsed = Timestamp::now() - t0;
+	cout << "scan mode " << (scan_mode ? "ON " : "OFF") << ": "
+	     << nb_points << " points, "
+	     << elapsed / nb_points * 1e6 << " us/point, start latency "
+	     << latency_sum / nb_points * 1e6 << " us" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	bool simulate = (argc < 2);
+	string hostname = simulate ? "localhost" : argv[1];
+	int port = (argc > 2) ? atoi(argv[2]) : 1031;
+	int nb_points = (argc > 3) ? atoi(argv[3]) : 1000;
+
+	try {
+		Camera cam(hostname, port, simulate);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+
+		runScan(cam, hw, nb_points, false);
+		runScan(cam, hw, nb_points, true);
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
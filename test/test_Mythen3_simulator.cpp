@@ -0,0 +1,130 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Simulated socket server: two simulated cameras keep their own
+// configuration, the frames are paced by the exposure time and the simulation
+// speed, and the raw readout decodes to the simulated counts for each number
+// of bits.
+// Usage: test_Mythen3_simulator
+
+#include "lima/Timestamp.h"
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3Simulator.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+// Returns the time taken to acquire nb_frames frames
+static double acquire(Camera& cam, Interface& hw, int nb_frames) {
+	cam.setNbFrames(nb_frames);
+	hw.prepareAcq();
+	Timestamp t0 = Timestamp::now();
+	hw.startAcq();
+	while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+		usleep(100);
+	return Timestamp::now() - t0;
+}
+
+static bool checkRaw(Camera& cam, Interface& hw, Camera::Nbits nbits, int nb_modules) {
+	cam.setNbits(nbits);
+	acquire(cam, hw, 2);
+	Data frame;
+	cam.readFrame(frame, 1);
+	const uint32_t* counts = reinterpret_cast<const uint32_t*>(frame.data());
+	int nb_channels = nb_modules * PixelsPerModule;
+	vector<uint32_t> simulated(nb_channels);
+	Mythen3Generator generator(SimulatedMaxModules * PixelsPerModule);
+	generator.generate(&simulated[0], nb_channels, 1);
+	uint32_t max = (1u << nbits) - 1;
+	for (int i = 0; i < nb_channels; i++) {
+		uint32_t expected = simulated[i];
+		if (expected > max)
+			expected = max;
+		if (counts[i] != expected) {
+			cout << "FAILED: " << nbits << " bits channel " << i << " is " << counts[i]
+					<< ", expected " << expected << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	try {
+		Camera cam1("localhost", 1031, true);
+		Camera cam2("localhost", 1031, true);
+		Interface hw1(cam1);
+		Interface hw2(cam2);
+		hw1.reset(HwInterface::SoftReset);
+		hw2.reset(HwInterface::SoftReset);
+		cam1.setNbModules(2);
+		cam2.setNbModules(5);
+		int nb_modules;
+		cam1.getNbModules(nb_modules);
+		if (nb_modules != 2) {
+			cout << "FAILED: simulated cameras share their configuration" << endl;
+			return 1;
+		}
+
+		const int nb_frames = 10;
+		const double exp_time = 0.01;
+		cam1.setExpTime(exp_time);
+		double elapsed = acquire(cam1, hw1, nb_frames);
+		cout << "real time: " << nb_frames << " frames of " << exp_time << " s in "
+				<< elapsed << " s" << endl;
+		if (elapsed < nb_frames * exp_time * 0.9) {
+			cout << "FAILED: the frames are not paced by the exposure time" << endl;
+			return 1;
+		}
+		cam1.setSimulationSpeed(0);
+		elapsed = acquire(cam1, hw1, nb_frames);
+		cout << "no delay: " << nb_frames << " frames in " << elapsed << " s" << endl;
+		if (elapsed > nb_frames * exp_time * 0.5) {
+			cout << "FAILED: the frames are paced at simulation speed 0" << endl;
+			return 1;
+		}
+
+		Size size;
+		cam2.getDetectorImageSize(size);
+		cam2.getBufferCtrlObj()->setFrameDim(FrameDim(size, Bpp32));
+		cam2.setSimulationSpeed(0);
+		cam2.setUseRawReadout(Camera::ON);
+		if (!checkRaw(cam2, hw2, Camera::BPP16, 5) || !checkRaw(cam2, hw2, Camera::BPP8, 5)
+				|| !checkRaw(cam2, hw2, Camera::BPP4, 5))
+			return 1;
+		cout << "raw readout decoded for 16, 8 and 4 bits" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
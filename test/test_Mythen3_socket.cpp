@@ -0,0 +1,124 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Number of recv() calls per 6 module frame from a local mock server with
+// the default socket options and with a larger receive buffer and quick ack.
+// A refused busy poll time must neither be kept nor break the connection,
+// and a frame starting with a bad channel (-2) must be read in full.
+// Usage: test_Mythen3_socket [hostname [port [nb_frames]]]
+// With a hostname the detector is used instead of the mock server.
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Timestamp.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static double acquire(Camera& cam, Interface& hw, int nb_frames) {
+	cam.setNbFrames(nb_frames);
+	hw.prepareAcq();
+	hw.startAcq();
+	while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+		usleep(10);
+	double reads;
+	cam.getReadsPerFrame(reads);
+	return reads;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_modules = 6;
+	Mythen3MockServer server(nb_modules);
+	string hostname = (argc > 1) ? argv[1] : "127.0.0.1";
+	int port = (argc > 1) ? ((argc > 2) ? atoi(argv[2]) : 1031) : server.start();
+	int nb_frames = (argc > 3) ? atoi(argv[3]) : 500;
+
+	try {
+		Camera cam(hostname, port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.setNbModules(nb_modules);
+
+		double reads = acquire(cam, hw, nb_frames);
+		cout << "default options: " << reads << " reads/frame" << endl;
+
+		// the status polls of the wait loop must not be counted
+		cam.setRecvBufferSize(4 * 1024 * 1024);
+		cam.setQuickAck(Camera::ON);
+		reads = acquire(cam, hw, nb_frames);
+		cout << "receive buffer 4 MB, quick ack: " << reads << " reads/frame" << endl;
+		if (reads < 1 || (argc < 2 && reads != 1)) {
+			cout << "FAILED: expected a single read per frame" << endl;
+			return 1;
+		}
+
+		int busy_poll;
+		try {
+			cam.setBusyPoll(INT_MAX);
+		} catch (Exception &e) {
+			cam.getBusyPoll(busy_poll);
+			cout << "busy poll refused, kept " << busy_poll << " us" << endl;
+			if (busy_poll != 0) {
+				cout << "FAILED: refused busy poll time stored" << endl;
+				return 1;
+			}
+		}
+		cam.setBusyPoll(0);
+		cam.setRecvBufferSize(0);
+		acquire(cam, hw, 10);
+
+		// the -2 of a bad channel is a count, not an error code
+		if (argc < 2) {
+			server.setBadChannelReadout(true);
+			acquire(cam, hw, 10);
+			server.setBadChannelReadout(false);
+			Data frame;
+			cam.readFrame(frame, 9);
+			const uint32_t* counts = (const uint32_t*) frame.data();
+			int nbModules;
+			cam.getNbModules(nbModules);
+			if (cam.getNbHwAcquiredFrames() != 10 || counts[0] != BadChannelCount
+					|| counts[1] != 1 || counts[PixelsPerModule * nb_modules - 1] != PixelsPerModule - 1
+					|| nbModules != nb_modules) {
+				cout << "FAILED: frame starting with a bad channel not read in full" << endl;
+				return 1;
+			}
+			cout << "frames starting with a bad channel OK" << endl;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Per command statistics of an acquisition from a local mock server: the
+// readouts are all counted with their bytes, an error reply is counted
+// under its status code and the counters are cleared by resetStatistics().
+// Usage: test_Mythen3_stats [nb_frames]
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static bool findStats(Camera& cam, const string& name, Camera::CmdStatistics& cmdStats) {
+	vector<Camera::CmdStatistics> stats;
+	cam.getStatistics(stats);
+	for (size_t i = 0; i < stats.size(); i++) {
+		if (stats[i].name == name) {
+			cmdStats = stats[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_modules = 6;
+	Mythen3MockServer server(nb_modules);
+	int port = server.start();
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 500;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.setNbModules(nb_modules);
+		cam.resetStatistics();
+
+		cam.setNbFrames(nb_frames);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+			usleep(10);
+
+		Camera::CmdStatistics readout;
+		if (!findStats(cam, "readout", readout)) {
+			cout << "FAILED: no readout statistics" << endl;
+			return 1;
+		}
+		cout << "readout: " << readout.count << " replies, " << readout.bytes << " bytes, p50 "
+				<< readout.p50 * 1e6 << " us, p99 " << readout.p99 * 1e6 << " us, max "
+				<< readout.max * 1e6 << " us" << endl;
+		long long frame_size = nb_modules * 1280 * sizeof(uint32_t);
+		if (readout.count != nb_frames || readout.bytes != nb_frames * frame_size
+				|| readout.errors != 0 || readout.failures != 0) {
+			cout << "FAILED: readouts miscounted" << endl;
+			return 1;
+		}
+		if (readout.p50 <= 0 || readout.p50 > readout.p99 || readout.p99 > readout.max) {
+			cout << "FAILED: inconsistent latency percentiles" << endl;
+			return 1;
+		}
+
+		string version;
+		server.setFailingCommand("-get version");
+		try {
+			cam.getVersion(version);
+		} catch (Exception &e) {
+		}
+		server.setFailingCommand("");
+		Camera::CmdStatistics versionStats;
+		if (!findStats(cam, "version", versionStats) || versionStats.errors != 1
+				|| versionStats.errorCodes.size() != 1 || versionStats.errorCodes[0] != -1
+				|| versionStats.errorCounts[0] != 1) {
+			cout << "FAILED: error reply not counted under its status code" << endl;
+			return 1;
+		}
+
+		cam.resetStatistics();
+		vector<Camera::CmdStatistics> stats;
+		cam.getStatistics(stats);
+		if (!stats.empty()) {
+			cout << "FAILED: statistics not cleared" << endl;
+			return 1;
+		}
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
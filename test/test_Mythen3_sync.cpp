@@ -0,0 +1,91 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Check that prepareAcq() only sends the synchronisation parameters which
+// changed since the previous acquisition, using a local mock server that
+// counts the commands it receives.
+
+#include "Mythen3Camera.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static int prepare(Camera& cam, Mythen3MockServer& server, TrigMode mode, double exp_time, int nb_frames) {
+	int before = server.getNbCommands();
+	cam.setTrigMode(mode);
+	cam.setExpTime(exp_time);
+	cam.setNbFrames(nb_frames);
+	cam.prepareAcq();
+	return server.getNbCommands() - before;
+}
+
+static bool check(const char* step, int nb_cmds, int expected) {
+	cout << step << ": " << nb_cmds << " commands" << endl;
+	if (nb_cmds != expected) {
+		cout << "FAILED: expected " << expected << " commands" << endl;
+		return false;
+	}
+	return true;
+}
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		cam.setScanMode(Camera::ON);
+		// trigger, continuous trigger, gate, time, frames and nbits, plus the
+		// frame delays read once for the readout timeout
+		if (!check("first point", prepare(cam, server, IntTrig, 0.001, 1), 8))
+			return 1;
+		if (!check("same point", prepare(cam, server, IntTrig, 0.001, 1), 0))
+			return 1;
+		if (!check("new exposure", prepare(cam, server, IntTrig, 0.002, 1), 1))
+			return 1;
+		// gate on, the exposure time set after the trigger mode is kept
+		if (!check("gate mode", prepare(cam, server, ExtGate, 0.002, 1), 1))
+			return 1;
+		double exp_time;
+		cam.getExpTime(exp_time);
+		if (exp_time != 0.002) {
+			cout << "FAILED: exposure time " << exp_time << endl;
+			return 1;
+		}
+		cam.resetMythen();
+		// after a reset the requested parameters and nbits are sent again
+		if (!check("after reset", prepare(cam, server, ExtGate, 0.002, 1), 4))
+			return 1;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,146 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// The readout path traces (DEB_HOT_*) must compile out unless the plugin is
+// built with -DMYTHEN3_HOT_PATH_TRACE=ON: no debug object is declared and
+// the trace arguments are not evaluated, even with all the debug flags on.
+// Then the per-frame cost of the acquisition loop, reading frames from a
+// local mock server, with the debug flags enabled and disabled at run time.
+// In the default build the two figures only differ by the traces outside
+// the readout path; redirect the trace output to /dev/null to measure the
+// formatting cost only.
+// Usage: test_Mythen3_trace [nb_frames]
+
+#include "lima/Timestamp.h"
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "Mythen3Trace.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+// The trace macros as used by the readout path
+class HotPath {
+	DEB_CLASS_NAMESPC(DebModCamera, "HotPath", "Mythen3");
+
+public:
+	// Returns the number of trace arguments evaluated
+	int trace() {
+		DEB_HOT_FUNCT();
+#ifndef MYTHEN3_HOT_PATH_TRACE
+		// does not compile if DEB_HOT_FUNCT() declared a debug object
+		int deb = 0;
+		(void) deb;
+#endif
+		int evaluated = 0;
+		DEB_HOT_TRACE() << "hot path trace " << ++evaluated;
+		return evaluated;
+	}
+
+	// The error block declares the single debug object of the function
+	void fail() {
+		DEB_HOT_FUNCT();
+		{
+			DEB_HOT_ERROR_FUNCT();
+			THROW_HW_ERROR(Error) << "hot path error";
+		}
+	}
+};
+
+static double runAcq(Camera& cam, Interface& hw, int nb_frames) {
+	cam.setNbFrames(nb_frames);
+	hw.prepareAcq();
+	Timestamp t0 = Timestamp::now();
+	hw.startAcq();
+	while (cam.getNbHwAcquiredFrames() < nb_frames || cam.isAcqRunning())
+		usleep(100);
+	return (Timestamp::now() - t0) / nb_frames;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	int nb_frames = (argc > 1) ? atoi(argv[1]) : 20000;
+	Mythen3MockServer server;
+	int port = server.start();
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+
+		DebParams::Flags type_flags = DebParams::getTypeFlags();
+		DebParams::Flags module_flags = DebParams::getModuleFlags();
+
+		DebParams::setTypeFlags(DebParams::AllFlags);
+		DebParams::setModuleFlags(DebParams::AllFlags);
+		HotPath hot;
+		int evaluated = hot.trace();
+		bool thrown = false;
+		try {
+			hot.fail();
+		} catch (Exception &e) {
+			thrown = true;
+		}
+		DebParams::setTypeFlags(type_flags);
+		DebParams::setModuleFlags(module_flags);
+#ifdef MYTHEN3_HOT_PATH_TRACE
+		int expected = 1;
+#else
+		int expected = 0;
+#endif
+		if (evaluated != expected) {
+			cout << "FAILED: hot path traces " << (expected ? "not compiled in" : "not compiled out") << endl;
+			return 1;
+		}
+		if (!thrown) {
+			cout << "FAILED: hot path error not thrown" << endl;
+			return 1;
+		}
+
+		DebParams::setTypeFlags(0);
+		DebParams::setModuleFlags(0);
+		double off = runAcq(cam, hw, nb_frames);
+
+		DebParams::setTypeFlags(DebParams::AllFlags);
+		DebParams::setModuleFlags(DebParams::AllFlags);
+		double on = runAcq(cam, hw, nb_frames);
+
+		DebParams::setTypeFlags(type_flags);
+		DebParams::setModuleFlags(module_flags);
+
+		cout << "debug flags off: " << off * 1e9 << " ns/frame" << endl;
+		cout << "debug flags on : " << on * 1e9 << " ns/frame" << endl;
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,140 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Receive system calls and CPU time per 6 module frame from a local mock
+// server, with the socket calls and with io_uring. The frames must be the
+// same with both transports. Without io_uring support in the kernel only the
+// socket calls are measured.
+// Usage: test_Mythen3_uring [hostname [port [nb_frames]]]
+// With a hostname the detector is used instead of the mock server.
+
+#include "Mythen3Camera.h"
+#include "Mythen3Interface.h"
+#include "Mythen3MockServer.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+static double cpuTime() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+			+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+// Returns the reads per frame, the CPU time per frame in us and the last frame
+static double acquire(Camera& cam, Interface& hw, int nb_frames, double& cpu, Data& frame) {
+	cam.setNbFrames(nb_frames);
+	hw.prepareAcq();
+	double start = cpuTime();
+	hw.startAcq();
+	while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < nb_frames)
+		usleep(10);
+	cpu = (cpuTime() - start) * 1e6 / nb_frames;
+	double reads;
+	cam.getReadsPerFrame(reads);
+	cam.readFrame(frame, nb_frames - 1);
+	return reads;
+}
+
+int main(int argc, char* argv[]) {
+	DEB_GLOBAL_FUNCT();
+
+	const int nb_modules = 6;
+	Mythen3MockServer server(nb_modules);
+	string hostname = (argc > 1) ? argv[1] : "127.0.0.1";
+	int port = (argc > 1) ? ((argc > 2) ? atoi(argv[2]) : 1031) : server.start();
+	int nb_frames = (argc > 3) ? atoi(argv[3]) : 2000;
+
+	try {
+		Camera cam(hostname, port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.setNbModules(nb_modules);
+
+		double cpu;
+		Data classic, uring;
+		double reads = acquire(cam, hw, nb_frames, cpu, classic);
+		cout << "socket calls: " << reads << " reads/frame, " << cpu << " us CPU/frame" << endl;
+
+		cam.setIoUring(Camera::ON);
+		Camera::Switch enabled;
+		cam.getIoUring(enabled);
+		if (enabled != Camera::ON) {
+			cout << "io_uring not available, skipped" << endl;
+			return 0;
+		}
+		server.resetReadouts();
+		reads = acquire(cam, hw, nb_frames, cpu, uring);
+		cout << "io_uring: " << reads << " reads/frame, " << cpu << " us CPU/frame" << endl;
+		if (argc < 2 && reads != 1) {
+			cout << "FAILED: expected a single system call per frame" << endl;
+			return 1;
+		}
+		if (argc < 2 && (uring.size() != classic.size()
+				|| memcmp(classic.data(), uring.data(), classic.size()) != 0)) {
+			cout << "FAILED: frames differ between the transports" << endl;
+			return 1;
+		}
+
+		// an error reply must not consume the reply of the next command
+		if (argc < 2) {
+			string version;
+			server.setFailingCommand("-get version");
+			try {
+				cam.getVersion(version);
+				cout << "FAILED: error reply not detected" << endl;
+				return 1;
+			} catch (Exception &e) {
+			}
+			server.setFailingCommand("");
+			cam.getVersion(version);
+			cout << "after an error reply: version " << version << endl;
+
+			// nor must a frame starting with the -2 of a bad channel
+			server.setBadChannelReadout(true);
+			acquire(cam, hw, 10, cpu, uring);
+			server.setBadChannelReadout(false);
+			cam.getVersion(version);
+			if (*(const uint32_t*) uring.data() != BadChannelCount || version != "M3.0.1") {
+				cout << "FAILED: frame starting with a bad channel not read in full" << endl;
+				return 1;
+			}
+		}
+		cam.setIoUring(Camera::OFF);
+		acquire(cam, hw, 10, cpu, classic);
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	return 0;
+}
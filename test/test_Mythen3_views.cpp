@@ -0,0 +1,112 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2015
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+
+// Views of the buffer ring: readFrame() returns the frame in place, a view
+// still held when the ring wraps over it is copied out first, and a
+// FrameReader walks a long acquisition chunk by chunk without a gap. A view
+// held past the camera keeps its frame.
+// The local mock server stamps each frame with its number.
+
+#include "Mythen3TestHelper.h"
+#include "lima/Exceptions.h"
+#include "lima/Debug.h"
+
+#include <unistd.h>
+
+using namespace std;
+using namespace lima;
+using namespace lima::Mythen3;
+
+DEB_GLOBAL(DebModTest);
+
+int main() {
+	DEB_GLOBAL_FUNCT();
+
+	Mythen3MockServer server;
+	int port = server.start();
+	const int nb_buffers = 8;
+	const int width = PixelsPerModule;
+	Data kept;
+
+	try {
+		Camera cam("127.0.0.1", port, false);
+		Interface hw(cam);
+		hw.reset(HwInterface::SoftReset);
+		cam.getBufferCtrlObj()->setNbBuffers(nb_buffers);
+
+		// a view points into the ring until the ring wraps over frame 2
+		server.resetReadouts();
+		server.setDelay(1000);
+		cam.setNbFrames(20);
+		hw.prepareAcq();
+		hw.startAcq();
+		while (cam.getNbHwAcquiredFrames() < 3)
+			usleep(100);
+		Data frame;
+		cam.readFrame(frame, 2);
+		Data again;
+		cam.readFrame(again, 2);
+		if (frame.data() != again.data() && failed("frame copied"))
+			return 1;
+		void* ring = again.data();
+		again.releaseBuffer();
+		while (cam.isAcqRunning() || cam.getNbHwAcquiredFrames() < 20)
+			usleep(100);
+		if (frame.data() == ring && failed("held view not copied when the ring wrapped"))
+			return 1;
+		if (((uint32_t*) frame.data())[0] != 2 && failed("held view overwritten"))
+			return 1;
+		frame.releaseBuffer();
+
+		// chunks cover every frame while the acquisition wraps the ring
+		server.resetReadouts();
+		server.setDelay(100);
+		cam.getBufferCtrlObj()->setNbBuffers(4 * FrameChunkSize);
+		cam.setNbFrames(1000);
+		hw.prepareAcq();
+		hw.startAcq();
+		Camera::FrameReader reader(cam, 0, 3);
+		Data chunk;
+		int nb_chunks = 0;
+		while (reader.getNextFrameNb() < 1000) {
+			if (!reader.next(chunk)) {
+				usleep(10);
+				continue;
+			}
+			const uint32_t* frames = (const uint32_t*) chunk.data();
+			for (int i = 0; i < chunk.dimensions[1]; i++)
+				if (frames[i * width] != static_cast<uint32_t>(chunk.frameNumber + i)
+						&& failed("wrong frame in chunk"))
+					return 1;
+			nb_chunks++;
+		}
+		chunk.releaseBuffer();
+		cout << "1000 frames in " << nb_chunks << " chunks, OK" << endl;
+		cam.readFrame(kept, 999);
+	} catch (Exception &e) {
+		cout << "Exception: " << e << endl;
+		return 1;
+	}
+	if (((uint32_t*) kept.data())[0] != 999 && failed("view lost with the camera"))
+		return 1;
+	return 0;
+}